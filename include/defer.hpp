@@ -5,7 +5,10 @@
 #pragma once
 #endif /* __GNUC__ >= 3.4 || _MSC_VER */
 
+#include <exception>
 #include <functional>
+#include <type_traits>
+#include <utility>
 
 class DeferGuard
 {
@@ -35,12 +38,96 @@ private:
     std::function<void()> routine_;
 };
 
+namespace _defer_detail {
+
+struct ExitPolicy {
+    bool ShouldRun() const noexcept { return true; }
+};
+
+// 比较构造时和析构时未捕获的异常数，判断是否因异常离开作用域
+struct FailPolicy {
+    int uncaught_ = std::uncaught_exceptions();
+    bool ShouldRun() const noexcept { return std::uncaught_exceptions() > uncaught_; }
+};
+
+struct SuccessPolicy {
+    int uncaught_ = std::uncaught_exceptions();
+    bool ShouldRun() const noexcept { return std::uncaught_exceptions() <= uncaught_; }
+};
+
+/**
+ * 按值保存函数对象，不做类型擦除也不分配内存，优化后和手写的清理代码一样
+ */
+template<typename _Callable, typename _Policy>
+class ScopeGuard
+{
+public:
+    template<typename _Fn>
+    explicit ScopeGuard(_Fn&& callOnExit) noexcept(std::is_nothrow_constructible<_Callable, _Fn>::value)
+    : routine_(std::forward<_Fn>(callOnExit)) {
+
+    }
+
+    ScopeGuard(ScopeGuard&& rr) noexcept(std::is_nothrow_move_constructible<_Callable>::value)
+    : routine_(std::move(rr.routine_)), policy_(rr.policy_), active_(rr.active_) {
+        rr.Cancel();
+    }
+
+    ~ScopeGuard() {
+        if (active_ && policy_.ShouldRun())
+            routine_();
+    }
+
+    void Cancel() noexcept {
+        active_ = false;
+    }
+
+private:
+    ScopeGuard(const ScopeGuard&) = delete;
+    void operator =(const ScopeGuard&) = delete;
+    void operator =(ScopeGuard&&) = delete;
+
+    _Callable routine_;
+    _Policy policy_;
+    bool active_ = true;
+};
+
+}
+
+// 离开作用域时总是执行
+template<typename _Callable>
+class ScopeExit : public _defer_detail::ScopeGuard<_Callable, _defer_detail::ExitPolicy> {
+    using _defer_detail::ScopeGuard<_Callable, _defer_detail::ExitPolicy>::ScopeGuard;
+};
+
+// 只在因异常离开作用域时执行
+template<typename _Callable>
+class ScopeFail : public _defer_detail::ScopeGuard<_Callable, _defer_detail::FailPolicy> {
+    using _defer_detail::ScopeGuard<_Callable, _defer_detail::FailPolicy>::ScopeGuard;
+};
+
+// 只在正常离开作用域时执行
+template<typename _Callable>
+class ScopeSuccess : public _defer_detail::ScopeGuard<_Callable, _defer_detail::SuccessPolicy> {
+    using _defer_detail::ScopeGuard<_Callable, _defer_detail::SuccessPolicy>::ScopeGuard;
+};
+
+template<typename _Callable> ScopeExit(_Callable) -> ScopeExit<_Callable>;
+template<typename _Callable> ScopeFail(_Callable) -> ScopeFail<_Callable>;
+template<typename _Callable> ScopeSuccess(_Callable) -> ScopeSuccess<_Callable>;
+
 #define _DEFERGUARD_CATFOUNR(a, b, c, s) a##s##b##s##c
 #define _DEFERGUARD_MAKENAME(prefix,infix,suffix) _DEFERGUARD_CATFOUNR(prefix,infix,suffix,_)
 
 #define DEFER(routine) \
-DeferGuard _DEFERGUARD_MAKENAME(__DeferGuard,__LINE__,__COUNTER__)(routine)
+ScopeExit _DEFERGUARD_MAKENAME(__DeferGuard,__LINE__,__COUNTER__)(routine)
 
 #define ON_SCOPE_EXIT(routine)  DEFER(routine)
 
+#define ON_SCOPE_FAIL(routine) \
+ScopeFail _DEFERGUARD_MAKENAME(__ScopeFail,__LINE__,__COUNTER__)(routine)
+
+#define ON_SCOPE_SUCCESS(routine) \
+ScopeSuccess _DEFERGUARD_MAKENAME(__ScopeSuccess,__LINE__,__COUNTER__)(routine)
+
 #endif /* _JULIET_DEFER_HPP_ */
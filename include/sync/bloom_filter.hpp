@@ -0,0 +1,137 @@
+/**
+ * @file bloom_filter.hpp
+ * @brief Growable Bloom filter whose lookups are lock-free.
+ * Register-blocked: a key sets four bits of a single 64-bit word, so a lookup
+ * is one hash and one atomic load per block. When a block reaches its
+ * capacity a block four times larger is prepended; lookups test every block,
+ * which is O(log n) words. Keys cannot be removed.
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_BLOOM_FILTER_HPP_
+#define _JULIET_SYNC_BLOOM_FILTER_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+
+namespace juliet::sync {
+
+/**
+ * @tparam Key
+ * @tparam Hash
+ * Add must be serialized by the caller. MayContain may run concurrently with
+ * Add and never reports a false negative for a key whose Add happened before.
+ */
+template <typename Key, typename Hash = std::hash<Key>>
+class BloomFilter {
+ public:
+  BloomFilter() = default;
+  BloomFilter(const BloomFilter &) = delete;
+  BloomFilter &operator=(const BloomFilter &) = delete;
+
+  ~BloomFilter() {
+    for (auto *block = head_.load(std::memory_order_relaxed);
+         block != nullptr;) {
+      auto *next = block->next;
+      delete block;
+      block = next;
+    }
+  }
+
+  void Add(const Key &key) {
+    auto *block = head_.load(std::memory_order_relaxed);
+    if (block == nullptr || block->count == block->capacity) {
+      auto capacity = block == nullptr ? kMinCapacity : block->capacity * 4;
+      block = new Block(capacity, block);
+      head_.store(block, std::memory_order_release);
+    }
+    block->Set(Mix(hash_(key)));
+    ++block->count;
+  }
+
+  // key may be any type Hash takes, such as a K of a transparent Hash.
+  template <typename K>
+  bool MayContain(const K &key) const {
+    auto *block = head_.load(std::memory_order_acquire);
+    if (block == nullptr) {
+      return false;
+    }
+    auto h = Mix(hash_(key));
+    for (; block != nullptr; block = block->next) {
+      if (block->Test(h)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool Empty() const {
+    return head_.load(std::memory_order_relaxed) == nullptr;
+  }
+
+ private:
+  // 16 bits per key: about 0.5% false positives per full block.
+  static constexpr size_t kBitsPerKey = 16;
+  static constexpr size_t kMinCapacity = 256;
+
+  struct Block {
+    Block(size_t _capacity, Block *_next)
+        : capacity(_capacity),
+          mask(_capacity * kBitsPerKey / 64 - 1),
+          words(new std::atomic<uint64_t>[mask + 1]),
+          next(_next) {
+      for (size_t i = 0; i <= mask; ++i) {
+        words[i].store(0, std::memory_order_relaxed);
+      }
+    }
+
+    static uint64_t Pattern(uint64_t h) {
+      return (uint64_t{1} << ((h >> 40) & 63)) |
+             (uint64_t{1} << ((h >> 46) & 63)) |
+             (uint64_t{1} << ((h >> 52) & 63)) |
+             (uint64_t{1} << ((h >> 58) & 63));
+    }
+
+    void Set(uint64_t h) {
+      words[h & mask].fetch_or(Pattern(h), std::memory_order_release);
+    }
+
+    bool Test(uint64_t h) const {
+      auto pattern = Pattern(h);
+      return (words[h & mask].load(std::memory_order_acquire) & pattern) ==
+             pattern;
+    }
+
+    const size_t capacity;
+    const size_t mask;
+    size_t count = 0;
+    std::unique_ptr<std::atomic<uint64_t>[]> words;
+    Block *const next;
+  };
+
+  // std::hash of an integer is the identity; spread it over all 64 bits.
+  static uint64_t Mix(uint64_t h) {
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    h *= 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 33;
+    return h;
+  }
+
+  std::atomic<Block *> head_{nullptr};
+  Hash hash_;
+};
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_BLOOM_FILTER_HPP_
@@ -0,0 +1,94 @@
+/**
+ * @file bulk_load.hpp
+ * @brief Building a container's table from a whole input at once.
+ * Constructing nodes (allocation plus copying keys and values) dominates a
+ * bulk load, so large inputs are split into chunks built on threads of
+ * their own; the nodes are then indexed into a table sized for all of them
+ * up front, without a lock, ready to be published in one step.
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_BULK_LOAD_HPP_
+#define _JULIET_SYNC_BULK_LOAD_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <algorithm>
+#include <cstddef>
+#include <iterator>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace juliet::sync::bulk {
+
+// Each thread builds at least this many elements.
+constexpr size_t kMinChunk = 1 << 16;
+
+inline size_t Threads(size_t n) {
+  size_t cores = std::max(1u, std::thread::hardware_concurrency());
+  return std::max<size_t>(1, std::min(cores, n / kMinChunk));
+}
+
+/**
+ * Split the n elements from first into Threads(n) chunks and call
+ * fn(chunk, begin, end) for each; the calling thread takes chunk 0 and
+ * returns once all are done.
+ */
+template <typename ForwardIt, typename Fn>
+void ForEachChunk(ForwardIt first, size_t n, Fn &&fn) {
+  auto chunks = Threads(n);
+  std::vector<ForwardIt> bounds;
+  bounds.reserve(chunks + 1);
+  bounds.push_back(first);
+  for (size_t c = 0; c < chunks; ++c) {
+    auto size = n / chunks + (c < n % chunks ? 1 : 0);
+    bounds.push_back(std::next(bounds.back(), static_cast<std::ptrdiff_t>(size)));
+  }
+
+  std::vector<std::thread> threads;
+  threads.reserve(chunks - 1);
+  for (size_t c = 1; c < chunks; ++c) {
+    threads.emplace_back([&fn, &bounds, c]() { fn(c, bounds[c], bounds[c + 1]); });
+  }
+  fn(size_t{0}, bounds[0], bounds[1]);
+  for (auto &t : threads) {
+    t.join();
+  }
+}
+
+/**
+ * Index a node made by make_node(*it) for every element of [first, last)
+ * into table (a NodeTable), sizing it once. Of equal keys the last wins, as
+ * with successive stores.
+ */
+template <typename Table, typename ForwardIt, typename MakeNode>
+void Fill(Table *table, ForwardIt first, ForwardIt last, MakeNode make_node) {
+  auto n = static_cast<size_t>(std::distance(first, last));
+  std::vector<std::vector<typename Table::NodePtr>> nodes(Threads(n));
+  ForEachChunk(first, n, [&](size_t chunk, ForwardIt begin, ForwardIt end) {
+    auto &out = nodes[chunk];
+    out.reserve(static_cast<size_t>(std::distance(begin, end)));
+    for (; begin != end; ++begin) {
+      out.push_back(make_node(*begin));
+    }
+  });
+
+  table->Reserve(n);
+  for (const auto &chunk : nodes) {
+    for (const auto &node : chunk) {
+      if (!table->Insert(node).second) {
+        table->Erase(node->key());
+        table->Insert(node);
+      }
+    }
+  }
+}
+
+}  // namespace juliet::sync::bulk
+
+#endif  // !_JULIET_SYNC_BULK_LOAD_HPP_
@@ -14,98 +14,164 @@
 #pragma once
 #endif /* __GNUC__ >= 3.4 || _MSC_VER */
 
+#include <iterator>
 #include <memory>
+#include <mutex>
 #include <shared_mutex>
+#include <type_traits>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 
+#include "bulk_load.hpp"
+#include "drain.hpp"
 #include "hash_table.hpp"
+#include "hot_keys.hpp"
+#include "intrusive.hpp"
+#include "lock_policy.hpp"
+#include "node_table.hpp"
+#include "stats_policy.hpp"
+#include "striped_counter.hpp"
+#include "transparent_hash.hpp"
 
 namespace juliet::sync {
 
 namespace cached {
 
-template <typename Value>
-struct Entry {
-  mutable std::shared_timed_mutex mu_;
+/**
+ * One key's node, shared by the write table and the read cache. Nodes that
+ * are only in the read cache and hold no value cache a miss.
+ * The first value is constructed inside the node; later ones are boxed.
+ * Values are replaced only under the write table's exclusive lock; the
+ * per-node lock only guards swapping val_ against readers.
+ */
+template <typename Key, typename Value, typename Mutex = std::mutex>
+class Node final : public RefCounted {
+ public:
+  using KeyType = Key;
+  using Ptr = ValueRef<Value>;
+
+  explicit Node(const Key& key) : key_(key) {}
+
+  template <typename Factory>
+  Node(const Key& key, std::in_place_t, Factory&& factory) : key_(key) {
+    val_ = Ptr::Borrowed(embedded_.Construct(factory));
+  }
+
+  const Key& key() const { return key_; }
+
   // Null means not exists. Maybe been deleted or never stored.
-  Value val_;
+  Ptr Load() const;
+
+  template <typename Factory>
+  void Store(Factory&& factory);
+
+  // Clear the value and return it.
+  Ptr Take();
 
-  void Store(const Value& v);
+  // Take without sharing: a pointer borrowed from the embedded value is
+  // only valid while the node is. For Drained.
+  Ptr Detach();
 
-  Value Load() const;
+ private:
+  // Call with mu_ held.
+  Ptr SharePtr() const {
+    return val_.owner() != nullptr || val_ == nullptr ? val_
+                                                      : Ptr(val_.get(), this);
+  }
+
+  // First, so a one-byte lock fits next to the reference count.
+  mutable Mutex mu_;
+  const Key key_;
+  Ptr val_;
+  EmbeddedValue<Value> embedded_;
 };
 
-template <typename Key, typename Value>
+template <typename Key, typename Value, typename LockPolicy = StdLockPolicy,
+          typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
 class Read {
  public:
-  using EntryPtr = std::shared_ptr<Entry<Value>>;
+  using SharedMutex = typename LockPolicy::SharedMutex;
+  using NodeType = Node<Key, Value, typename LockPolicy::EntryMutex>;
+  using NodePtr = IntrusivePtr<NodeType>;
+  using Table = NodeTable<NodeType, Hash, KeyEqual>;
 
-  std::pair<EntryPtr, bool> Get(const Key& key) const;
+  // key is a Key, or a K equal to one with a transparent Hash and KeyEqual.
+  template <typename K>
+  NodePtr Get(const K& key) const;
 
-  void TryStore(const Key& key, const Value& val);
-
-  void Update(const Key& key, const Value& val);
+  // Insert node unless key is cached already. Returns the cached node.
+  NodePtr Insert(NodePtr node);
 
   void Clear();
 
  private:
-  mutable std::shared_timed_mutex mu_;
-  std::unordered_map<Key, EntryPtr> map_;
+  mutable SharedMutex mu_;
+  Table map_;
 };
 
-template <typename Value>
-inline void Entry<Value>::Store(const Value& v) {
-  std::lock_guard<std::shared_timed_mutex> guard(mu_);
-  val_ = v;
+template <typename Key, typename Value, typename Mutex>
+inline typename Node<Key, Value, Mutex>::Ptr Node<Key, Value, Mutex>::Load()
+    const {
+  std::lock_guard<Mutex> guard(mu_);
+  return SharePtr();
 }
 
-template <typename Value>
-inline Value Entry<Value>::Load() const {
-  std::shared_lock<std::shared_timed_mutex> lock(mu_);
-  return val_;
+template <typename Key, typename Value, typename Mutex>
+template <typename Factory>
+inline void Node<Key, Value, Mutex>::Store(Factory&& factory) {
+  // No reader can see embedded_ before it is published through val_.
+  Ptr val = embedded_.constructed()
+                ? HeapValue<Value>::Make(std::forward<Factory>(factory))
+                : Ptr::Borrowed(embedded_.Construct(factory));
+  {
+    std::lock_guard<Mutex> guard(mu_);
+    val_.swap(val);
+  }
+  // The old value is released outside the lock.
 }
 
-template <typename Key, typename Value>
-inline std::pair<typename Read<Key, Value>::EntryPtr, bool>
-Read<Key, Value>::Get(const Key& key) const {
-  std::shared_lock<std::shared_timed_mutex> lock(mu_);
-  auto it = map_.find(key);
-  if (it == map_.end()) return {nullptr, false};
-  assert(it->second);
-  return {it->second, true};
+template <typename Key, typename Value, typename Mutex>
+inline typename Node<Key, Value, Mutex>::Ptr Node<Key, Value, Mutex>::Take() {
+  std::lock_guard<Mutex> guard(mu_);
+  auto val = SharePtr();
+  val_.reset();
+  return val;
 }
 
-template <typename Key, typename Value>
-inline void Read<Key, Value>::TryStore(const Key& key, const Value& val) {
-  auto get = Get(key);
-  if (!get.second) return;
-  const auto& entry = get.first;
-  assert(entry);
-  entry->Store(val);
+template <typename Key, typename Value, typename Mutex>
+inline typename Node<Key, Value, Mutex>::Ptr
+Node<Key, Value, Mutex>::Detach() {
+  Ptr val;
+  std::lock_guard<Mutex> guard(mu_);
+  val.swap(val_);
+  return val;
 }
 
-template <typename Key, typename Value>
-inline void Read<Key, Value>::Update(const Key& key, const Value& val) {
-  auto entry = std::make_shared<Entry<Value>>();
-  entry->val_ = val;
-
-  {
-    std::lock_guard<std::shared_timed_mutex> lock(mu_);
-    auto emplace = map_.emplace(key, entry);
-    if (emplace.second) return;
-
-    auto it = emplace.first;
-    assert(it != map_.end());
-    entry = it->second;
-  }
+template <typename Key, typename Value, typename LockPolicy, typename Hash,
+          typename KeyEqual>
+template <typename K>
+inline typename Read<Key, Value, LockPolicy, Hash, KeyEqual>::NodePtr
+Read<Key, Value, LockPolicy, Hash, KeyEqual>::Get(const K& key) const {
+  std::shared_lock<SharedMutex> lock(mu_);
+  return NodePtr(map_.Find(key));
+}
 
-  entry->Store(val);
+template <typename Key, typename Value, typename LockPolicy, typename Hash,
+          typename KeyEqual>
+inline typename Read<Key, Value, LockPolicy, Hash, KeyEqual>::NodePtr
+Read<Key, Value, LockPolicy, Hash, KeyEqual>::Insert(NodePtr node) {
+  std::lock_guard<SharedMutex> lock(mu_);
+  return NodePtr(map_.Insert(std::move(node)).first);
 }
 
-template <typename Key, typename Value>
-void Read<Key, Value>::Clear() {
+template <typename Key, typename Value, typename LockPolicy, typename Hash,
+          typename KeyEqual>
+void Read<Key, Value, LockPolicy, Hash, KeyEqual>::Clear() {
+  Table m;
   mu_.lock();
-  auto m = std::move(map_);
+  m.Swap(map_);
   mu_.unlock();
 }
 
@@ -117,114 +183,364 @@ void Read<Key, Value>::Clear() {
  * 其他时候都只读（使用共享锁），提升并发读性能
  * @tparam Key
  * @tparam Value
+ * @tparam LockPolicy 见lock_policy.hpp，读缓存和写表都使用它
+ * @tparam StatsPolicy 见stats_policy.hpp
+ * @tparam Hash
+ * @tparam KeyEqual 两者都是transparent时，Get也接受其他键类型，
+ * 见transparent_hash.hpp
  */
-template <typename Key, typename Value>
+template <typename Key, typename Value, typename LockPolicy = StdLockPolicy,
+          typename StatsPolicy = NoStats, typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
 class CachedMap {
  public:
-  using ValuePtr = std::shared_ptr<Value>;
+  using ValuePtr = ValueRef<Value>;
 
-  using EPutStatus = typename HashTable<Key, ValuePtr>::EPutStatus;
+  using EPutStatus =
+      typename HashTable<Key, ValuePtr, LockPolicy>::EPutStatus;
 
-  using Map = std::unordered_map<Key, Value>;
+  using Map = std::unordered_map<Key, Value, Hash, KeyEqual>;
 
   CachedMap();
 
+  // 批量载入，见BulkLoad
+  template <typename ForwardIt>
+  CachedMap(ForwardIt first, ForwardIt last);
+
+  explicit CachedMap(Map&& m);
+
   ~CachedMap() = default;
 
   // Put
   EPutStatus Put(const Key& key, const Value& value);
 
+  EPutStatus Put(const Key& key, Value&& value);
+
   EPutStatus TryPut(const Key& key, const Value& value);
 
+  EPutStatus TryPut(const Key& key, Value&& value);
+
+  // Construct the value in place and overwrite any existing one.
+  template <typename... Args>
+  EPutStatus Emplace(const Key& key, Args&&... args);
+
+  // Construct the value in place only if key does not exist.
+  template <typename... Args>
+  EPutStatus TryEmplace(const Key& key, Args&&... args);
+
   Value Get(const Key& key) const {
     Value result{};
     Get(key, result);
     return result;
   }
 
-  bool Get(const Key& key, Value& value) const;
+  bool Get(const Key& key, Value& value) const { return GetAs(key, value); }
+
+  // 用与Key相等的K查找，命中读缓存时不构造Key
+  template <typename K, typename = EnableHeterogeneous<K, Key, Hash, KeyEqual>>
+  Value Get(const K& key) const {
+    Value result{};
+    GetAs(key, result);
+    return result;
+  }
+
+  template <typename K, typename = EnableHeterogeneous<K, Key, Hash, KeyEqual>>
+  bool Get(const K& key, Value& value) const {
+    return GetAs(key, value);
+  }
 
   void Remove(const Key& key) {
-    Value v;
-    Remove(key, v);
+    auto hot = Tracker::Write(hot_.get(), key);
+    auto guard = StatsLock<std::lock_guard<SharedMutex>>(stats_, write_mu_);
+    auto node = write_.Erase(key);
+    if (!node) return;
+    node->Take();
+    size_.Decrement();
   }
 
   bool Remove(const Key& key, Value& value);
 
-  void Clear() {
-    std::unordered_map<Key, Value> m;
-    Clear(m);
-  }
+  void Clear() { Drain(); }
 
+  // 清空，并把原内容移入m，见Drain
   void Clear(Map& m);
 
- private:
-  std::unique_ptr<cached::Read<Key, ValuePtr>> read_;
+  using Contents = Drained<
+      Value, typename cached::Read<Key, Value, LockPolicy, Hash, KeyEqual>::Table>;
+
+  // 清空并返回原内容：加锁时只换出写表，值在遍历返回的句柄时才逐个移出，
+  // 节点随之释放
+  Contents Drain();
+
+  // 用[first, last)替换全部内容，键相同时后者覆盖前者
+  // 大输入时多线程构造节点，写表一次预留到位，加锁后只做一次swap
+  template <typename ForwardIt>
+  void BulkLoad(ForwardIt first, ForwardIt last);
+
+  // 从m中移出值，m被清空
+  void BulkLoad(Map&& m) {
+    BulkLoad(std::make_move_iterator(m.begin()),
+             std::make_move_iterator(m.end()));
+    m.clear();
+  }
 
-  HashTable<Key, ValuePtr> write_;
+  // 预留n个元素，之后的写入不再rehash
+  void Reserve(size_t n) {
+    auto guard = StatsLock<std::lock_guard<SharedMutex>>(stats_, write_mu_);
+    write_.Reserve(n);
+  }
+
+  // 元素个数，不加锁，O(核数)；与并发写入同时调用时是近似值
+  size_t Size() const {
+    auto size = size_.Sum();
+    return size > 0 ? static_cast<size_t>(size) : 0;
+  }
+
+  // Get命中读缓存(kFastPath)或未命中(kSlowPath)的次数，以及write_mu_的
+  // 等锁、持锁耗时分布。StatsPolicy未启用时为空
+  StatsSnapshot Stats() const { return stats_.Stats(); }
+
+  // 抽样统计读最多的key，最热的几个由副本直接服务，不经过读缓存的锁和
+  // 节点的锁，见hot_keys.hpp。须在多线程共享之前调用
+  void TrackHotKeys(const HotKeyOptions& options = HotKeyOptions()) {
+    hot_ = std::make_unique<Tracker>(options);
+  }
+
+  // TrackHotKeys发现的热点key，最热的在前
+  std::vector<HotKey<Key>> HotKeys() const {
+    return hot_ != nullptr ? hot_->Top() : std::vector<HotKey<Key>>();
+  }
+
+ private:
+  using SharedMutex = typename LockPolicy::SharedMutex;
+  using ReadCache = cached::Read<Key, Value, LockPolicy, Hash, KeyEqual>;
+  using NodeType = typename ReadCache::NodeType;
+  using NodePtr = typename ReadCache::NodePtr;
+  using Table = typename ReadCache::Table;
+  using Tracker = HotKeyTracker<Key, Value, Hash, KeyEqual,
+                                typename LockPolicy::Mutex>;
+
+  // Shared body of Put and Emplace.
+  template <typename Factory>
+  EPutStatus PutWith(const Key& key, Factory&& factory, bool overwrite);
+
+  // Get的实现，key为Key或与之相等的K
+  template <typename K>
+  bool GetAs(const K& key, Value& value) const;
+
+  // 不经过热点副本的Get
+  template <typename K>
+  bool GetFromCache(const K& key, Value& value) const;
+
+  // 锁顺序：先write_mu_，后读缓存
+  std::unique_ptr<ReadCache> read_;
+
+  mutable SharedMutex write_mu_;
+  Table write_;
+  StripedCounter size_;
+  mutable StatsPolicy stats_;
+  // 未调用TrackHotKeys时为空
+  std::unique_ptr<Tracker> hot_;
 };
 
-template <typename Key, typename Value>
-inline CachedMap<Key, Value>::CachedMap()
-    : read_(std::make_unique<cached::Read<Key, ValuePtr>>()) {}
+template <typename Key, typename Value, typename LockPolicy, typename StatsPolicy,
+          typename Hash, typename KeyEqual>
+inline CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::CachedMap()
+    : read_(std::make_unique<ReadCache>()) {}
+
+template <typename Key, typename Value, typename LockPolicy, typename StatsPolicy,
+          typename Hash, typename KeyEqual>
+template <typename ForwardIt>
+inline CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::CachedMap(ForwardIt first,
+                                                    ForwardIt last)
+    : CachedMap() {
+  BulkLoad(first, last);
+}
+
+template <typename Key, typename Value, typename LockPolicy, typename StatsPolicy,
+          typename Hash, typename KeyEqual>
+inline CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::CachedMap(Map&& m)
+    : CachedMap() {
+  BulkLoad(std::move(m));
+}
 
-template <typename Key, typename Value>
-inline typename CachedMap<Key, Value>::EPutStatus CachedMap<Key, Value>::Put(
+template <typename Key, typename Value, typename LockPolicy, typename StatsPolicy,
+          typename Hash, typename KeyEqual>
+inline typename CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::EPutStatus CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::Put(
     const Key& key, const Value& value) {
-  // 插入新的Value指针，永不改写Value
-  // 查询得到的Value指针可安全地只读访问
-  auto val = std::make_shared<Value>(value);
-  auto status = write_.Put(key, val);
-  read_->TryStore(key, val);
-  return status;
+  return PutWith(key, [&value]() -> Value { return value; }, true);
+}
+
+template <typename Key, typename Value, typename LockPolicy, typename StatsPolicy,
+          typename Hash, typename KeyEqual>
+inline typename CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::EPutStatus CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::Put(
+    const Key& key, Value&& value) {
+  return PutWith(key, [&value]() -> Value { return std::move(value); }, true);
 }
 
-template <typename Key, typename Value>
-inline typename CachedMap<Key, Value>::EPutStatus CachedMap<Key, Value>::TryPut(
+template <typename Key, typename Value, typename LockPolicy, typename StatsPolicy,
+          typename Hash, typename KeyEqual>
+inline typename CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::EPutStatus CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::TryPut(
     const Key& key, const Value& value) {
-  auto val = std::make_shared<Value>(value);
-  auto status = write_.TryPut(key, val);
-  // 只在改写成功后更新缓存
-  if (status == EPutStatus::PUT_NEW) read_->TryStore(key, val);
-  return status;
+  return PutWith(key, [&value]() -> Value { return value; }, false);
 }
 
-template <typename Key, typename Value>
-inline bool CachedMap<Key, Value>::Get(const Key& key, Value& value) const {
-  auto get = read_->Get(key);
-  ValuePtr val;
-  if (get.second) {
-    const auto& entry = get.first;
-    assert(entry);
-    val = entry->Load();
+template <typename Key, typename Value, typename LockPolicy, typename StatsPolicy,
+          typename Hash, typename KeyEqual>
+inline typename CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::EPutStatus CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::TryPut(
+    const Key& key, Value&& value) {
+  return PutWith(key, [&value]() -> Value { return std::move(value); }, false);
+}
+
+template <typename Key, typename Value, typename LockPolicy, typename StatsPolicy,
+          typename Hash, typename KeyEqual>
+template <typename... Args>
+inline typename CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::EPutStatus CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::Emplace(
+    const Key& key, Args&&... args) {
+  return PutWith(
+      key, [&]() -> Value { return Value(std::forward<Args>(args)...); }, true);
+}
+
+template <typename Key, typename Value, typename LockPolicy, typename StatsPolicy,
+          typename Hash, typename KeyEqual>
+template <typename... Args>
+inline typename CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::EPutStatus
+CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::TryEmplace(const Key& key, Args&&... args) {
+  return PutWith(
+      key, [&]() -> Value { return Value(std::forward<Args>(args)...); },
+      false);
+}
+
+template <typename Key, typename Value, typename LockPolicy, typename StatsPolicy,
+          typename Hash, typename KeyEqual>
+template <typename Factory>
+inline typename CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::EPutStatus
+CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::PutWith(const Key& key, Factory&& factory,
+                                           bool overwrite) {
+  // 热点副本的锁在write_mu_之前获取，与补副本时的顺序一致
+  auto hot = Tracker::Write(hot_.get(), key);
+  // 写表和读缓存共享同一个节点，改写节点即同时更新缓存
+  auto guard = StatsLock<std::lock_guard<SharedMutex>>(stats_, write_mu_);
+  if (auto* node = write_.Find(key)) {
+    if (!overwrite) return EPutStatus::PUT_SKIPPED;
+    node->Store(factory);
+    return EPutStatus::PUT_OVERWRITE;
+  }
+
+  // 读缓存里不在写表中的节点只可能是缓存的miss，复用它
+  auto node = read_->Get(key);
+  if (node) {
+    node->Store(factory);
   } else {
-    val = write_.Get(key);
-    read_->Update(key, val);
+    node = NodePtr(new NodeType(key, std::in_place, factory));
+  }
+  write_.Insert(std::move(node));
+  size_.Increment();
+  return EPutStatus::PUT_NEW;
+}
+
+template <typename Key, typename Value, typename LockPolicy, typename StatsPolicy,
+          typename Hash, typename KeyEqual>
+template <typename K>
+inline bool CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::GetAs(const K& key, Value& value) const {
+  if (hot_ != nullptr) {
+    return hot_->Load(key, &value, [this](const K& k, Value* v) {
+      return GetFromCache(k, *v);
+    });
   }
+  return GetFromCache(key, value);
+}
 
+template <typename Key, typename Value, typename LockPolicy, typename StatsPolicy,
+          typename Hash, typename KeyEqual>
+template <typename K>
+inline bool CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::GetFromCache(const K& key, Value& value) const {
+  auto node = read_->Get(key);
+  if (!node) {
+    stats_.Count(kSlowPath);
+    // 持有写表共享锁时填充缓存，避免与Put交错留下过期的miss
+    auto lock = StatsSharedLock<std::shared_lock<SharedMutex>>(stats_, write_mu_);
+    auto* found = write_.Find(key);
+    if (found) {
+      node = read_->Insert(NodePtr(found));
+    } else if constexpr (std::is_same_v<K, Key>) {
+      node = read_->Insert(NodePtr(new NodeType(key)));
+    } else {
+      // 只有缓存miss时才构造Key
+      node = read_->Insert(NodePtr(new NodeType(Key(key))));
+    }
+  } else {
+    stats_.Count(kFastPath);
+  }
+
+  auto val = node->Load();
   if (val) value = *val;
   return val != nullptr;
 }
 
-template <typename Key, typename Value>
-inline bool CachedMap<Key, Value>::Remove(const Key& key, Value& value) {
+template <typename Key, typename Value, typename LockPolicy, typename StatsPolicy,
+          typename Hash, typename KeyEqual>
+inline bool CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::Remove(const Key& key, Value& value) {
   ValuePtr val;
-  if (!write_.Remove(key, val)) return false;
+  {
+    auto hot = Tracker::Write(hot_.get(), key);
+    auto guard = StatsLock<std::lock_guard<SharedMutex>>(stats_, write_mu_);
+    auto node = write_.Erase(key);
+    if (!node) return false;
+    // 节点留在读缓存中，此后缓存的即是miss
+    val = node->Take();
+    size_.Decrement();
+  }
 
   value = *val;
-  read_->Update(key, nullptr);
   return true;
 }
 
-template <typename Key, typename Value>
-inline void CachedMap<Key, Value>::Clear(Map& m) {
-  std::unordered_map<Key, ValuePtr> w;
-  write_.Clear(w);
-  read_->Clear();
+template <typename Key, typename Value, typename LockPolicy, typename StatsPolicy,
+          typename Hash, typename KeyEqual>
+inline void CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::Clear(Map& m) {
+  auto drained = Drain();
+  m.reserve(m.size() + drained.Size());
+  drained.ForEach([&m](const Key& key, Value&& value) {
+    m.emplace(key, std::move(value));
+  });
+}
 
-  for (const auto& kv : w) {
-    m.emplace(kv.first, *kv.second);
+template <typename Key, typename Value, typename LockPolicy, typename StatsPolicy,
+          typename Hash, typename KeyEqual>
+inline typename CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::Contents
+CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::Drain() {
+  auto w = std::make_shared<Table>();
+  {
+    auto hot = Tracker::WriteAll(hot_.get());
+    auto guard = StatsLock<std::lock_guard<SharedMutex>>(stats_, write_mu_);
+    w->Swap(write_);
+    size_.Add(-static_cast<int64_t>(w->Size()));
+    // 读缓存持有的节点引用一并放掉，值大多可以直接移出
+    read_->Clear();
   }
+  return Contents(std::move(w));
+}
+
+template <typename Key, typename Value, typename LockPolicy, typename StatsPolicy,
+          typename Hash, typename KeyEqual>
+template <typename ForwardIt>
+inline void CachedMap<Key, Value, LockPolicy, StatsPolicy, Hash, KeyEqual>::BulkLoad(ForwardIt first,
+                                                        ForwardIt last) {
+  Table w;
+  bulk::Fill(&w, first, last, [](auto&& kv) {
+    return NodePtr(new NodeType(kv.first, std::in_place, [&kv]() -> Value {
+      return std::forward<decltype(kv)>(kv).second;
+    }));
+  });
+
+  auto size = static_cast<int64_t>(w.Size());
+  auto hot = Tracker::WriteAll(hot_.get());
+  auto guard = StatsLock<std::lock_guard<SharedMutex>>(stats_, write_mu_);
+  w.Swap(write_);
+  size_.Add(size - static_cast<int64_t>(w.Size()));
+  // 读缓存里可能有新内容中已存在的键的miss
+  read_->Clear();
 }
 
 }  // namespace juliet::sync
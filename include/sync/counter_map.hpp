@@ -0,0 +1,340 @@
+/**
+ * @file counter_map.hpp
+ * @brief Per-key counters updated in place.
+ * Every key owns a node with an inline atomic count. Adding to a key that is
+ * already published is an epoch-pinned, lock-free lookup followed by a single
+ * fetch_add; only a new key, or one added since the last publish, takes the
+ * lock. Those are kept in a small pending table that is merged into a new
+ * read table once the lookups it served pay for the copy, as Map promotes
+ * its dirty map.
+ * A key whose count keeps colliding between threads switches to per-core
+ * cells, as StripedCounter does, so ultra-hot keys do not serialize on one
+ * cache line. Keys are never removed; ResetAndGet zeroes counts.
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_COUNTER_MAP_HPP_
+#define _JULIET_SYNC_COUNTER_MAP_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "epoch.hpp"
+#include "intrusive.hpp"
+#include "lock_policy.hpp"
+#include "node_table.hpp"
+#include "striped_counter.hpp"
+#include "transparent_hash.hpp"
+
+namespace juliet::sync {
+
+namespace counter {
+
+// One key's count: a base word, plus per-core cells once it runs hot.
+template <typename Key, typename Integral>
+class Node : public RefCounted {
+ public:
+  using KeyType = Key;
+
+  explicit Node(Key key) : key_(std::move(key)) {}
+
+  ~Node() override { delete[] cells_.load(std::memory_order_relaxed); }
+
+  const Key &key() const { return key_; }
+
+  void Add(Integral delta) {
+    if (Cell *cells = cells_.load(std::memory_order_acquire)) {
+      cells[stripe::Probe() & (stripe::CellCount() - 1)].value.fetch_add(
+          delta, std::memory_order_relaxed);
+      return;
+    }
+    // Contention is sampled: a plain fetch_add cannot tell whether another
+    // thread got in first, comparing with a prior load can.
+    thread_local uint32_t tick = 0;
+    if (++tick % kSampleInterval != 0) {
+      base_.fetch_add(delta, std::memory_order_relaxed);
+      return;
+    }
+    auto seen = base_.load(std::memory_order_relaxed);
+    if (base_.fetch_add(delta, std::memory_order_relaxed) != seen &&
+        collisions_.fetch_add(1, std::memory_order_relaxed) + 1 ==
+            kStripeAfter) {
+      InitCells();
+    }
+  }
+
+  // Approximate while adds are in flight.
+  Integral Get() const {
+    auto sum = base_.load(std::memory_order_relaxed);
+    if (const Cell *cells = cells_.load(std::memory_order_acquire)) {
+      for (size_t i = 0; i < stripe::CellCount(); ++i) {
+        sum += cells[i].value.load(std::memory_order_relaxed);
+      }
+    }
+    return sum;
+  }
+
+  // Zero the count. Every add lands in exactly one word and each word is
+  // exchanged once, so an add counts toward this reset or the next one.
+  Integral Exchange() {
+    auto sum = base_.exchange(0, std::memory_order_relaxed);
+    if (Cell *cells = cells_.load(std::memory_order_acquire)) {
+      for (size_t i = 0; i < stripe::CellCount(); ++i) {
+        sum += cells[i].value.exchange(0, std::memory_order_relaxed);
+      }
+    }
+    return sum;
+  }
+
+ private:
+  struct alignas(64) Cell {
+    std::atomic<Integral> value{0};
+  };
+
+  static constexpr uint32_t kSampleInterval = 16;
+  // Sampled collisions before the node allocates its cells.
+  static constexpr uint32_t kStripeAfter = 32;
+
+  void InitCells() {
+    auto *cells = new Cell[stripe::CellCount()];
+    Cell *expected = nullptr;
+    if (!cells_.compare_exchange_strong(expected, cells,
+                                        std::memory_order_acq_rel,
+                                        std::memory_order_acquire)) {
+      delete[] cells;
+    }
+  }
+
+  std::atomic<Integral> base_{0};
+  std::atomic<uint32_t> collisions_{0};
+  std::atomic<Cell *> cells_{nullptr};
+  const Key key_;
+};
+
+}  // namespace counter
+
+/**
+ * @tparam Integral the count type; signed counts may go negative.
+ * @tparam LockPolicy see lock_policy.hpp; Mutex guards new keys.
+ * @tparam Hash, KeyEqual as for std::unordered_map. When both are
+ * transparent, Add and Get also take any K equal to a Key; see
+ * transparent_hash.hpp.
+ */
+template <typename Key, typename Integral = int64_t,
+          typename LockPolicy = StdLockPolicy, typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class CounterMap {
+  static_assert(std::is_integral_v<Integral> &&
+                    !std::is_same_v<Integral, bool>,
+                "CounterMap counts must be an integral type");
+
+ public:
+  using Mutex = typename LockPolicy::Mutex;
+  using Entry = std::pair<Key, Integral>;
+
+  CounterMap() : read_(new Table()) {}
+
+  CounterMap(const CounterMap &) = delete;
+  CounterMap &operator=(const CounterMap &) = delete;
+
+  // Not safe against concurrent access.
+  ~CounterMap() { delete read_.load(std::memory_order_relaxed); }
+
+  // Add delta to key's count, creating it at zero first if needed.
+  void Add(const Key &key, Integral delta = 1) { AddAs(key, delta); }
+
+  template <typename K, typename = EnableHeterogeneous<K, Key, Hash, KeyEqual>>
+  void Add(const K &key, Integral delta = 1) {
+    AddAs(key, delta);
+  }
+
+  void Increment(const Key &key) { Add(key, 1); }
+
+  // key's count, 0 if it was never added to.
+  Integral Get(const Key &key) const { return GetAs(key); }
+
+  template <typename K, typename = EnableHeterogeneous<K, Key, Hash, KeyEqual>>
+  Integral Get(const K &key) const {
+    return GetAs(key);
+  }
+
+  /**
+   * Zero key's count and return what it was, for exporters that ship deltas.
+   * No add racing with the reset is lost.
+   */
+  Integral ResetAndGet(const Key &key) {
+    auto *node = Find(key, false);
+    return node != nullptr ? node->Exchange() : 0;
+  }
+
+  // ResetAndGet every key. Keys whose count was already 0 are left out.
+  std::vector<Entry> ResetAndGet() {
+    std::vector<Entry> entries;
+    ForEachNode([&entries](Node *node) {
+      if (auto count = node->Exchange()) {
+        entries.emplace_back(node->key(), count);
+      }
+    });
+    return entries;
+  }
+
+  // Every key and its count. Not atomic across keys.
+  std::vector<Entry> Snapshot() const {
+    std::vector<Entry> entries;
+    entries.reserve(Size());
+    ForEachNode([&entries](Node *node) {
+      entries.emplace_back(node->key(), node->Get());
+    });
+    return entries;
+  }
+
+  /**
+   * The k keys with the largest counts, largest first; ties in no particular
+   * order. Copies only the k keys kept.
+   */
+  std::vector<Entry> TopK(size_t k) const {
+    if (k == 0) {
+      return {};
+    }
+    // Min-heap on count of the best k nodes so far.
+    std::vector<std::pair<Integral, Node *>> best;
+    best.reserve(std::min(k, Size()));
+    auto greater = [](const auto &a, const auto &b) {
+      return a.first > b.first;
+    };
+    ForEachNode([&](Node *node) {
+      auto count = node->Get();
+      if (best.size() < k) {
+        best.emplace_back(count, node);
+        std::push_heap(best.begin(), best.end(), greater);
+      } else if (count > best.front().first) {
+        std::pop_heap(best.begin(), best.end(), greater);
+        best.back() = {count, node};
+        std::push_heap(best.begin(), best.end(), greater);
+      }
+    });
+    std::sort_heap(best.begin(), best.end(), greater);
+    std::vector<Entry> entries;
+    entries.reserve(best.size());
+    for (const auto &[count, node] : best) {
+      entries.emplace_back(node->key(), count);
+    }
+    return entries;
+  }
+
+  // Keys ever added to.
+  size_t Size() const {
+    std::lock_guard<Mutex> guard(mu_);
+    return read_.load(std::memory_order_relaxed)->Size() + pending_.Size();
+  }
+
+ private:
+  using Node = counter::Node<Key, Integral>;
+  using NodePtr = IntrusivePtr<Node>;
+  using Table = NodeTable<Node, Hash, KeyEqual>;
+
+  template <typename K>
+  void AddAs(const K &key, Integral delta) {
+    Find(key, true)->Add(delta);
+  }
+
+  template <typename K>
+  Integral GetAs(const K &key) const {
+    auto *node = Find(key, false);
+    return node != nullptr ? node->Get() : 0;
+  }
+
+  /**
+   * key's node, inserted into the pending table if absent and create is
+   * set. Nodes live as long as the map, so the pointer stays valid once the
+   * epoch guard is gone.
+   */
+  template <typename K>
+  Node *Find(const K &key, bool create) const {
+    {
+      Epoch::Guard guard;
+      if (auto *node = read_.load(std::memory_order_acquire)->Find(key)) {
+        return node;
+      }
+    }
+
+    std::lock_guard<Mutex> guard(mu_);
+    // Publishing holds mu_: the read table cannot change under us now.
+    auto *read = read_.load(std::memory_order_relaxed);
+    if (auto *node = read->Find(key)) {
+      return node;
+    }
+    auto *node = pending_.Find(key);
+    if (node == nullptr) {
+      if (!create) {
+        return nullptr;
+      }
+      node = pending_.Insert(MakeIntrusive<Node>(Key(key))).first;
+    }
+    MissLocked(*read);
+    return node;
+  }
+
+  // Publish read plus pending once the locked lookups cost about as much as
+  // copying read did.
+  void MissLocked(const Table &read) const {
+    if (++misses_ < read.Size() + pending_.Size()) {
+      return;
+    }
+    auto *next = new Table(read);
+    next->Reserve(read.Size() + pending_.Size());
+    for (auto *node : pending_) {
+      next->Insert(NodePtr(node));
+    }
+    pending_.Clear();
+    misses_ = 0;
+    Epoch::Guard guard;
+    Epoch::Retire(read_.exchange(next, std::memory_order_acq_rel));
+  }
+
+  // Call fn(Node *) with every node.
+  template <typename Fn>
+  void ForEachNode(Fn &&fn) const {
+    std::vector<Node *> pending;
+    Epoch::Guard epoch;
+    const Table *read;
+    {
+      std::lock_guard<Mutex> guard(mu_);
+      read = read_.load(std::memory_order_relaxed);
+      pending.reserve(pending_.Size());
+      for (auto *node : pending_) {
+        pending.push_back(node);
+      }
+    }
+    for (auto *node : *read) {
+      fn(node);
+    }
+    for (auto *node : pending) {
+      fn(node);
+    }
+  }
+
+  // Immutable once published; replaced under mu_, reclaimed through Epoch.
+  mutable std::atomic<Table *> read_;
+  mutable Mutex mu_;
+  // Keys not yet in read_. Guarded by mu_, as is misses_.
+  mutable Table pending_;
+  mutable size_t misses_ = 0;
+};
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_COUNTER_MAP_HPP_
@@ -0,0 +1,127 @@
+/**
+ * @file drain.hpp
+ * @brief The contents a container detached in one step, consumed lazily.
+ * Drain() swaps a container's node table out under its lock and hands it
+ * over whole; values are moved out one entry at a time afterwards, on the
+ * consumer's thread, with no intermediate copy of the table.
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_DRAIN_HPP_
+#define _JULIET_SYNC_DRAIN_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <atomic>
+#include <cstddef>
+#include <memory>
+#include <type_traits>
+#include <utility>
+
+#include "intrusive.hpp"
+
+namespace juliet::sync {
+
+/**
+ * Entries detached from a container, each handed out once by Next or
+ * ForEach. A value is moved out unless a reader that raced with the drain
+ * still holds it, in which case it is copied (move-only values are always
+ * moved). Once nobody else shares the table, each node is freed as soon as
+ * it is consumed. Dropping the handle frees whatever was not consumed.
+ * Move-only; not thread-safe.
+ * @tparam Table a NodeTable whose nodes provide key() and Detach(), which
+ * clears the node's value and returns the pointer it held.
+ */
+template <typename Value, typename Table>
+class Drained {
+ public:
+  using Node = typename Table::NodeType;
+  using NodePtr = typename Table::NodePtr;
+  using Key = typename Table::Key;
+
+  Drained() = default;
+
+  explicit Drained(std::shared_ptr<Table> table)
+      : table_(std::move(table)),
+        size_(table_ != nullptr ? table_->Size() : 0),
+        slots_(table_ != nullptr ? table_->SlotCount() : 0) {}
+
+  Drained(Drained &&) noexcept = default;
+  Drained &operator=(Drained &&) noexcept = default;
+
+  /**
+   * Call fn(key, value) with the next entry, value an rvalue.
+   * @return false once every entry was handed out.
+   */
+  template <typename Fn>
+  bool Next(Fn &&fn) {
+    while (next_ < slots_) {
+      NodePtr extracted;
+      auto *node = Take(next_++, &extracted);
+      if (node == nullptr) {
+        continue;
+      }
+      auto ptr = node->Detach();
+      if (ptr == nullptr) {
+        continue;
+      }
+      fn(node->key(), Steal(ptr, *node));
+      return true;
+    }
+    table_.reset();
+    return false;
+  }
+
+  // Keys detached, an upper bound on the entries: some may hold no value.
+  size_t Size() const { return size_; }
+
+  // Call fn(key, value) with every entry not yet handed out.
+  template <typename Fn>
+  void ForEach(Fn &&fn) {
+    while (Next(fn)) {
+    }
+  }
+
+ private:
+  // The node in slot, if any. Once no reader can reach the table, it is
+  // consumed slot by slot: the node is moved into *extracted.
+  Node *Take(size_t slot, NodePtr *extracted) {
+    if (table_.use_count() == 1) {
+      std::atomic_thread_fence(std::memory_order_acquire);
+      *extracted = table_->Extract(slot);
+      return extracted->get();
+    }
+    return table_->At(slot);
+  }
+
+  template <typename Ptr>
+  static Value Steal(Ptr &ptr, const Node &node) {
+    if constexpr (!std::is_same_v<Ptr, ValueRef<Value>>) {
+      return Value(*ptr);
+    } else if constexpr (!std::is_copy_constructible_v<Value>) {
+      return std::move(*ptr);
+    } else {
+      // A borrowed pointer refers to the value embedded in node. Readers
+      // holding a value keep its owner referenced, and node is referenced
+      // once here, by the table or by the extracted pointer.
+      const auto *owner = ptr.owner() != nullptr ? ptr.owner() : &node;
+      if (owner->RefCount() == 1) {
+        return std::move(*ptr);
+      }
+      return *ptr;
+    }
+  }
+
+  std::shared_ptr<Table> table_;
+  size_t size_ = 0;
+  size_t slots_ = 0;
+  size_t next_ = 0;
+};
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_DRAIN_HPP_
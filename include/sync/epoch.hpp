@@ -0,0 +1,229 @@
+/**
+ * @file epoch.hpp
+ * @brief Epoch-based memory reclamation for lock-free containers.
+ * A thread pins the current global epoch while it may hold pointers to
+ * shared nodes (Epoch::Guard). Unlinked nodes are retired rather than
+ * deleted; a retired node is freed once the global epoch has advanced twice
+ * past the epoch it was retired in, which can only happen after every thread
+ * that was pinned when it was unlinked has unpinned.
+ * One process-wide domain; each thread owns a record, reused after it exits.
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_EPOCH_HPP_
+#define _JULIET_SYNC_EPOCH_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace juliet::sync {
+
+class Epoch {
+  struct Record;
+
+ public:
+  /**
+   * Pins the calling thread. Nests; only the outermost guard unpins.
+   * Must be destroyed on the thread that created it.
+   */
+  class Guard {
+   public:
+    Guard() : record_(&Local()) {
+      if (record_->nesting++ == 0) {
+        auto epoch = Global().epoch.load(std::memory_order_relaxed);
+        record_->state.store((epoch << 1) | kPinned,
+                             std::memory_order_relaxed);
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+      }
+    }
+
+    Guard(Guard &&rr) noexcept : record_(std::exchange(rr.record_, nullptr)) {}
+
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+    Guard &operator=(Guard &&) = delete;
+
+    ~Guard() {
+      if (record_ == nullptr || --record_->nesting != 0) {
+        return;
+      }
+      record_->state.store(0, std::memory_order_release);
+      if (++record_->unpins % kCollectInterval == 0) {
+        Collect();
+      }
+    }
+
+   private:
+    Record *record_;
+  };
+
+  /**
+   * Free ptr with deleter once no pinned thread can still reach it.
+   * Call while pinned, after ptr has been unlinked.
+   */
+  static void Retire(void *ptr, void (*deleter)(void *)) {
+    auto &record = Local();
+    auto epoch = Global().epoch.load(std::memory_order_seq_cst);
+    record.limbo.push_back({ptr, deleter, epoch});
+    if (record.limbo.size() >= kLimboLimit) {
+      Collect();
+    }
+  }
+
+  template <typename T>
+  static void Retire(T *ptr) {
+    Retire(ptr, [](void *p) { delete static_cast<T *>(p); });
+  }
+
+  // Try to advance the global epoch, then free what has become safe.
+  static void Collect() {
+    auto &global = Global();
+    TryAdvance(global);
+    auto epoch = global.epoch.load(std::memory_order_acquire);
+    FreeExpired(Local().limbo, epoch);
+    std::unique_lock<std::mutex> lock(global.orphan_mu, std::try_to_lock);
+    if (lock.owns_lock()) {
+      FreeExpired(global.orphans, epoch);
+    }
+  }
+
+ private:
+  static constexpr uint64_t kPinned = 1;
+  static constexpr size_t kLimboLimit = 64;
+  static constexpr uint32_t kCollectInterval = 128;
+
+  struct Retired {
+    void *ptr;
+    void (*deleter)(void *);
+    uint64_t epoch;
+  };
+
+  struct alignas(64) Record {
+    // (pinned epoch << 1) | kPinned, or 0 when not pinned.
+    std::atomic<uint64_t> state{0};
+    std::atomic<bool> in_use{true};
+    Record *next = nullptr;
+    // Owner thread only.
+    uint32_t nesting = 0;
+    uint32_t unpins = 0;
+    std::vector<Retired> limbo;
+  };
+
+  struct Domain {
+    std::atomic<uint64_t> epoch{0};
+    std::atomic<Record *> records{nullptr};
+    std::mutex orphan_mu;
+    // Left behind by threads that exited.
+    std::vector<Retired> orphans;
+
+    ~Domain() {
+      // Thread-local holders are destroyed before statics; nothing is pinned.
+      for (auto &retired : orphans) {
+        retired.deleter(retired.ptr);
+      }
+      for (auto *record = records.load(); record != nullptr;) {
+        auto *next = record->next;
+        for (auto &retired : record->limbo) {
+          retired.deleter(retired.ptr);
+        }
+        delete record;
+        record = next;
+      }
+    }
+  };
+
+  struct Holder {
+    Record *record = Acquire();
+
+    ~Holder() {
+      auto &global = Global();
+      if (!record->limbo.empty()) {
+        std::lock_guard<std::mutex> guard(global.orphan_mu);
+        global.orphans.insert(global.orphans.end(), record->limbo.begin(),
+                              record->limbo.end());
+        record->limbo.clear();
+      }
+      record->state.store(0, std::memory_order_release);
+      record->in_use.store(false, std::memory_order_release);
+    }
+  };
+
+  static Domain &Global() {
+    static Domain domain;
+    return domain;
+  }
+
+  static Record &Local() {
+    thread_local Holder holder;
+    return *holder.record;
+  }
+
+  static Record *Acquire() {
+    auto &global = Global();
+    for (auto *record = global.records.load(std::memory_order_acquire);
+         record != nullptr; record = record->next) {
+      bool in_use = false;
+      if (!record->in_use.load(std::memory_order_relaxed) &&
+          record->in_use.compare_exchange_strong(in_use, true,
+                                                 std::memory_order_acquire)) {
+        record->nesting = 0;
+        record->unpins = 0;
+        return record;
+      }
+    }
+    auto *record = new Record;
+    auto *head = global.records.load(std::memory_order_relaxed);
+    do {
+      record->next = head;
+    } while (!global.records.compare_exchange_weak(
+        head, record, std::memory_order_release, std::memory_order_relaxed));
+    return record;
+  }
+
+  static void TryAdvance(Domain &global) {
+    auto epoch = global.epoch.load(std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    for (auto *record = global.records.load(std::memory_order_acquire);
+         record != nullptr; record = record->next) {
+      auto state = record->state.load(std::memory_order_relaxed);
+      if ((state & kPinned) != 0 && (state >> 1) != epoch) {
+        return;
+      }
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    global.epoch.compare_exchange_strong(epoch, epoch + 1,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed);
+  }
+
+  static void FreeExpired(std::vector<Retired> &limbo, uint64_t epoch) {
+    std::vector<Retired> expired;
+    size_t kept = 0;
+    for (auto &retired : limbo) {
+      if (retired.epoch + 2 <= epoch) {
+        expired.push_back(retired);
+      } else {
+        limbo[kept++] = retired;
+      }
+    }
+    limbo.resize(kept);
+    // Deleters may retire more nodes, so run them after limbo is settled.
+    for (auto &retired : expired) {
+      retired.deleter(retired.ptr);
+    }
+  }
+};
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_EPOCH_HPP_
@@ -0,0 +1,282 @@
+/**
+ * @file executor.hpp
+ * @brief A small work-stealing thread pool for fork-join loops.
+ * Every worker owns a deque: it pushes and pops its own tasks at the back
+ * and, when idle, steals from the front of the others', where the largest
+ * pieces of a recursively split range sit. ParallelFor splits a range in
+ * halves down to a grain, so idle workers take half of what remains.
+ * A thread waiting for its ParallelFor runs pieces of that same loop rather
+ * than sleeping, so the caller always contributes and nested loops cannot
+ * deadlock. The deques are mutex-guarded; tasks are chunks of work, not
+ * single elements, so the locks are not on any hot path.
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_EXECUTOR_HPP_
+#define _JULIET_SYNC_EXECUTOR_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <utility>
+#include <vector>
+
+namespace juliet::sync {
+
+class Executor {
+ public:
+  // One worker per core besides the calling thread.
+  static size_t DefaultWorkers() {
+    auto cores = std::thread::hardware_concurrency();
+    return cores > 1 ? cores - 1 : 0;
+  }
+
+  /**
+   * @param workers threads to start; with 0 every loop runs on its caller.
+   */
+  explicit Executor(size_t workers = DefaultWorkers())
+      : queues_(std::max<size_t>(workers, 1)) {
+    threads_.reserve(workers);
+    for (size_t i = 0; i < workers; ++i) {
+      threads_.emplace_back([this, i]() { Work(i); });
+    }
+  }
+
+  Executor(const Executor &) = delete;
+  Executor &operator=(const Executor &) = delete;
+
+  // Runs every queued task, then stops the workers.
+  ~Executor() {
+    {
+      std::lock_guard<std::mutex> guard(sleep_mu_);
+      stop_ = true;
+    }
+    sleep_cv_.notify_all();
+    for (auto &t : threads_) {
+      t.join();
+    }
+  }
+
+  size_t Workers() const { return threads_.size(); }
+
+  /**
+   * Distinct values of CurrentSlot(): one per worker plus one shared by all
+   * other threads. Size per-thread state (such as partial results) by it.
+   */
+  size_t Slots() const { return threads_.size() + 1; }
+
+  // The calling worker's index, or Workers() for any other thread.
+  size_t CurrentSlot() const {
+    const auto &current = Current();
+    return current.executor == this ? current.index : Workers();
+  }
+
+  // Run task on some worker; without workers, run it now.
+  void Submit(std::function<void()> task) {
+    if (threads_.empty()) {
+      task();
+      return;
+    }
+    Push(Task{nullptr, std::move(task)});
+  }
+
+  /**
+   * Call fn(first, last, slot) over disjoint pieces of [begin, end) no
+   * longer than grain (0 picks one), on the workers and the caller, and
+   * return once all are done. slot is CurrentSlot() of the running thread;
+   * no two pieces run at once with the same slot. fn must not throw.
+   */
+  template <typename Fn>
+  void ParallelFor(size_t begin, size_t end, size_t grain, Fn &&fn) {
+    if (begin >= end) {
+      return;
+    }
+    if (grain == 0) {
+      grain = std::max<size_t>(1, (end - begin) / (Slots() * kPiecesPerSlot));
+    }
+    Job job;
+    job.remaining.store(end - begin, std::memory_order_relaxed);
+    Split(&job, begin, end, grain, fn);
+    while (job.remaining.load(std::memory_order_acquire) != 0) {
+      Task task;
+      if (Take(&job, &task)) {
+        task.fn();
+      } else {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  /**
+   * ParallelFor with a partial result per slot: fn(partial, first, last)
+   * folds a piece into partial, and the partials are then folded into the
+   * result with combine(result, std::move(partial)), in slot order.
+   * @param identity starting value of every partial and of the result, e.g.
+   * 0 for a sum.
+   */
+  template <typename T, typename Fn, typename Combine>
+  T ParallelReduce(size_t begin, size_t end, size_t grain, T identity,
+                   Fn &&fn, Combine &&combine) {
+    std::vector<Partial<T>> partials(Slots(), Partial<T>{identity});
+    ParallelFor(begin, end, grain,
+                [&partials, &fn](size_t first, size_t last, size_t slot) {
+                  fn(partials[slot].value, first, last);
+                });
+    for (auto &partial : partials) {
+      combine(identity, std::move(partial.value));
+    }
+    return identity;
+  }
+
+ private:
+  // A loop is split into about this many pieces per slot.
+  static constexpr size_t kPiecesPerSlot = 8;
+
+  struct Job {
+    std::atomic<size_t> remaining{0};
+  };
+
+  struct Task {
+    // The ParallelFor this piece belongs to; null for Submit.
+    const Job *job = nullptr;
+    std::function<void()> fn;
+  };
+
+  struct alignas(64) Queue {
+    std::mutex mu;
+    std::deque<Task> tasks;
+  };
+
+  template <typename T>
+  struct alignas(64) Partial {
+    T value;
+  };
+
+  struct CurrentWorker {
+    const Executor *executor = nullptr;
+    size_t index = 0;
+  };
+
+  static CurrentWorker &Current() {
+    thread_local CurrentWorker current;
+    return current;
+  }
+
+  // Hand the upper halves of [begin, end) to thieves, run the rest here.
+  template <typename Fn>
+  void Split(Job *job, size_t begin, size_t end, size_t grain, Fn &fn) {
+    while (end - begin > grain && !threads_.empty()) {
+      auto mid = begin + (end - begin) / 2;
+      Push(Task{job, [this, job, mid, end, grain, &fn]() {
+                  Split(job, mid, end, grain, fn);
+                }});
+      end = mid;
+    }
+    if (threads_.empty()) {
+      // Still bounded pieces, so per-piece work stays cache-sized.
+      for (auto first = begin; first < end; first += grain) {
+        fn(first, std::min(first + grain, end), CurrentSlot());
+      }
+    } else {
+      fn(begin, end, CurrentSlot());
+    }
+    job->remaining.fetch_sub(end - begin, std::memory_order_acq_rel);
+  }
+
+  void Push(Task task) {
+    auto slot = CurrentSlot();
+    auto &queue = slot < Workers()
+                      ? queues_[slot]
+                      : queues_[next_queue_.fetch_add(
+                                    1, std::memory_order_relaxed) %
+                                queues_.size()];
+    {
+      std::lock_guard<std::mutex> guard(queue.mu);
+      queue.tasks.push_back(std::move(task));
+    }
+    queued_.fetch_add(1, std::memory_order_release);
+    // Taking the lock orders this with a worker about to sleep.
+    { std::lock_guard<std::mutex> guard(sleep_mu_); }
+    sleep_cv_.notify_one();
+  }
+
+  /**
+   * Pop a task of job (any task if job is null): the newest of the calling
+   * worker's own, else the oldest of another queue.
+   */
+  bool Take(const Job *job, Task *task) {
+    if (queued_.load(std::memory_order_acquire) == 0) {
+      return false;
+    }
+    auto slot = CurrentSlot();
+    auto own = slot < Workers() ? slot : 0;
+    {
+      auto &queue = queues_[own];
+      std::lock_guard<std::mutex> guard(queue.mu);
+      for (auto it = queue.tasks.rbegin(); it != queue.tasks.rend(); ++it) {
+        if (job == nullptr || it->job == job) {
+          *task = std::move(*it);
+          queue.tasks.erase(std::next(it).base());
+          queued_.fetch_sub(1, std::memory_order_relaxed);
+          return true;
+        }
+      }
+    }
+    for (size_t i = 1; i < queues_.size(); ++i) {
+      auto &queue = queues_[(own + i) % queues_.size()];
+      std::lock_guard<std::mutex> guard(queue.mu);
+      for (auto it = queue.tasks.begin(); it != queue.tasks.end(); ++it) {
+        if (job == nullptr || it->job == job) {
+          *task = std::move(*it);
+          queue.tasks.erase(it);
+          queued_.fetch_sub(1, std::memory_order_relaxed);
+          return true;
+        }
+      }
+    }
+    return false;
+  }
+
+  void Work(size_t index) {
+    Current() = CurrentWorker{this, index};
+    for (;;) {
+      Task task;
+      if (Take(nullptr, &task)) {
+        task.fn();
+        continue;
+      }
+      std::unique_lock<std::mutex> lock(sleep_mu_);
+      sleep_cv_.wait(lock, [this]() {
+        return stop_ || queued_.load(std::memory_order_acquire) != 0;
+      });
+      if (stop_ && queued_.load(std::memory_order_acquire) == 0) {
+        return;
+      }
+    }
+  }
+
+  std::vector<Queue> queues_;
+  std::vector<std::thread> threads_;
+  // Tasks pushed and not yet taken.
+  std::atomic<size_t> queued_{0};
+  std::atomic<size_t> next_queue_{0};
+  std::mutex sleep_mu_;
+  std::condition_variable sleep_cv_;
+  bool stop_ = false;
+};
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_EXECUTOR_HPP_
@@ -0,0 +1,604 @@
+/**
+ * @file frozen_map.hpp
+ * @brief Immutable map for static data, queried in place from memory or from
+ * a read-only mmap of its file.
+ * A minimal perfect hash (PTHash-style hash-and-displace) sends each of the n
+ * keys to its own slot in [0, n): a key hashes to a bucket, and the bucket's
+ * pilot, chosen at build time, to the slot. A lookup reads one pilot and one
+ * slot and compares the key: no locks, refcounts or probing.
+ * Layout, identical in memory and on disk:
+ *   Header | uint32_t pilots[buckets] | Slot slots[count] | blob
+ * A slot holds the key and value themselves if they are trivially copyable,
+ * or an offset and length into the blob for std::string. Hashing uses the
+ * key's bytes, not std::hash, so a file means the same in every process.
+ * Files are native-endian.
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_FROZEN_MAP_HPP_
+#define _JULIET_SYNC_FROZEN_MAP_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <algorithm>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include "hash_table.hpp"
+#include "map.hpp"
+#include "snapshot.hpp"
+
+namespace juliet::sync {
+
+/**
+ * How a key or value is laid out in a FrozenMap slot:
+ *   Stored  what the slot holds;
+ *   View    what a lookup returns, pointing into the map where it can;
+ *   Arg     what a lookup takes as the key.
+ */
+template <typename T, typename Enable = void>
+struct FrozenField;
+
+template <typename T>
+struct FrozenField<T, std::enable_if_t<std::is_trivially_copyable<T>::value>> {
+  using Stored = T;
+  using View = T;
+  using Arg = const T &;
+  static constexpr size_t kFixedSize = sizeof(T);
+  // Keys are hashed and compared by their bytes.
+  static constexpr bool kByteComparable =
+      std::has_unique_object_representations<T>::value;
+
+  static std::string_view Bytes(const T &value) {
+    return {reinterpret_cast<const char *>(&value), sizeof(T)};
+  }
+
+  static Stored Store(const T &value, std::string * /* blob */) {
+    return value;
+  }
+
+  static const T &Get(const Stored &stored, const char * /* blob */) {
+    return stored;
+  }
+
+  static bool Equal(const Stored &stored, const char * /* blob */,
+                    const T &key) {
+    return std::memcmp(&stored, &key, sizeof(T)) == 0;
+  }
+};
+
+template <>
+struct FrozenField<std::string> {
+  struct Stored {
+    uint64_t offset;
+    uint64_t size;
+  };
+  using View = std::string_view;
+  using Arg = std::string_view;
+  static constexpr size_t kFixedSize = 0;
+  static constexpr bool kByteComparable = true;
+
+  static std::string_view Bytes(std::string_view value) { return value; }
+
+  static Stored Store(std::string_view value, std::string *blob) {
+    Stored stored{blob->size(), value.size()};
+    blob->append(value);
+    return stored;
+  }
+
+  static View Get(const Stored &stored, const char *blob) {
+    return {blob + stored.offset, static_cast<size_t>(stored.size)};
+  }
+
+  static bool Equal(const Stored &stored, const char *blob,
+                    std::string_view key) {
+    return Get(stored, blob) == key;
+  }
+};
+
+namespace frozen {
+
+constexpr char kMagic[8] = {'J', 'L', 'T', 'F', 'R', 'O', 'Z', '\0'};
+constexpr uint32_t kVersion = 1;
+// Average keys per bucket; each bucket costs a 4-byte pilot.
+constexpr size_t kBucketSize = 4;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t count;
+  uint64_t buckets;
+  uint64_t seed;
+  // FrozenField<Key>::kFixedSize, FrozenField<Value>::kFixedSize and
+  // sizeof(Slot), as a type check.
+  uint64_t key_size;
+  uint64_t value_size;
+  uint64_t slot_size;
+  uint64_t slots_offset;
+  uint64_t blob_offset;
+  uint64_t blob_size;
+};
+
+inline uint64_t Mix(uint64_t h) {
+  h ^= h >> 33;
+  h *= 0xFF51AFD7ED558CCDULL;
+  h ^= h >> 33;
+  h *= 0xC4CEB9FE1A85EC53ULL;
+  h ^= h >> 33;
+  return h;
+}
+
+// MurmurHash64A.
+inline uint64_t Hash(std::string_view bytes, uint64_t seed) {
+  constexpr uint64_t m = 0xC6A4A7935BD1E995ULL;
+  constexpr int r = 47;
+  uint64_t h = seed ^ (bytes.size() * m);
+  const char *p = bytes.data();
+  const char *end = p + bytes.size() / 8 * 8;
+  for (; p != end; p += 8) {
+    uint64_t k;
+    std::memcpy(&k, p, 8);
+    k *= m;
+    k ^= k >> r;
+    k *= m;
+    h ^= k;
+    h *= m;
+  }
+  auto tail = bytes.size() & 7;
+  if (tail != 0) {
+    uint64_t k = 0;
+    std::memcpy(&k, p, tail);
+    h ^= k;
+    h *= m;
+  }
+  h ^= h >> r;
+  h *= m;
+  h ^= h >> r;
+  return h;
+}
+
+// Map h onto [0, n) by its high bits, without a division.
+inline size_t Reduce(uint64_t h, size_t n) {
+#if defined __SIZEOF_INT128__
+  return static_cast<size_t>((static_cast<unsigned __int128>(h) * n) >> 64);
+#else
+  return static_cast<size_t>(h % n);
+#endif
+}
+
+inline size_t Position(uint64_t h, uint32_t pilot, size_t n) {
+  return Reduce(Mix(h ^ Mix(pilot + 1)), n);
+}
+
+inline size_t BucketCount(size_t n) {
+  return (n + kBucketSize - 1) / kBucketSize;
+}
+
+inline size_t AlignUp(size_t n, size_t alignment) {
+  return (n + alignment - 1) / alignment * alignment;
+}
+
+}  // namespace frozen
+
+/**
+ * @tparam Key trivially copyable without padding, or std::string.
+ * @tparam Value trivially copyable, or std::string.
+ * Build one from a Map, HashTable or unordered_map, or add pairs to a
+ * Builder; Save writes it out and Open maps it back. All lookups are
+ * const and safe from any number of threads.
+ */
+template <typename Key, typename Value>
+class FrozenMap {
+  using KeyField = FrozenField<Key>;
+  using ValueField = FrozenField<Value>;
+
+  static_assert(KeyField::kByteComparable,
+                "FrozenMap keys are compared by their bytes and must not "
+                "have padding or several representations of one value");
+
+  struct Slot {
+    typename KeyField::Stored key;
+    typename ValueField::Stored value;
+  };
+
+  static_assert(alignof(Slot) <= alignof(std::max_align_t),
+                "over-aligned keys or values");
+
+ public:
+  using KeyArg = typename KeyField::Arg;
+  using KeyView = typename KeyField::View;
+  // Value for fixed-size values, std::string_view into the map for strings.
+  using ValueView = typename ValueField::View;
+  using ValueArg = typename ValueField::Arg;
+
+  class Builder {
+   public:
+    void Reserve(size_t n) { entries_.reserve(n); }
+
+    // Of pairs added with the same key, the last one wins.
+    void Add(KeyArg key, ValueArg value) {
+      entries_.push_back(Entry{KeyField::Store(key, &blob_),
+                               ValueField::Store(value, &blob_)});
+    }
+
+    size_t Size() const { return entries_.size(); }
+
+    FrozenMap Build() const {
+      std::vector<uint64_t> hashes(entries_.size());
+      std::vector<size_t> order(entries_.size());
+      std::vector<size_t> slots;
+      std::vector<uint32_t> pilots;
+      for (uint64_t attempt = 0;; ++attempt) {
+        auto seed = frozen::Mix(attempt + 0x9E3779B97F4A7C15ULL);
+        if (Place(seed, &hashes, &order, &slots, &pilots)) {
+          return Assemble(seed, order, slots, pilots);
+        }
+      }
+    }
+
+   private:
+    struct Entry {
+      typename KeyField::Stored key;
+      typename ValueField::Stored value;
+    };
+
+    // Give up on a seed after this many pilots for one bucket.
+    static constexpr uint32_t kMaxPilot = 1u << 24;
+
+    std::string_view KeyBytes(size_t i) const {
+      return KeyField::Bytes(KeyField::Get(entries_[i].key, blob_.data()));
+    }
+
+    /**
+     * Find a pilot for every bucket under seed. On success order holds the
+     * distinct entries sorted by hash, and slots[i] is the slot of order[i].
+     * @return false if two distinct keys share a 64-bit hash or a bucket ran
+     * out of pilots; the caller retries with another seed.
+     */
+    bool Place(uint64_t seed, std::vector<uint64_t> *hashes,
+               std::vector<size_t> *order, std::vector<size_t> *slots,
+               std::vector<uint32_t> *pilots) const {
+      auto &h = *hashes;
+      for (size_t i = 0; i < entries_.size(); ++i) {
+        h[i] = frozen::Hash(KeyBytes(i), seed);
+      }
+      order->resize(entries_.size());
+      for (size_t i = 0; i < order->size(); ++i) {
+        (*order)[i] = i;
+      }
+      std::sort(order->begin(), order->end(), [&h](size_t a, size_t b) {
+        return h[a] < h[b] || (h[a] == h[b] && a < b);
+      });
+
+      // Drop all but the last of equal keys; equal hashes are adjacent.
+      size_t n = 0;
+      for (size_t i = 0; i < order->size(); ++i) {
+        auto e = (*order)[i];
+        if (n != 0 && h[(*order)[n - 1]] == h[e]) {
+          if (KeyBytes((*order)[n - 1]) != KeyBytes(e)) {
+            return false;
+          }
+          (*order)[n - 1] = e;
+          continue;
+        }
+        (*order)[n++] = e;
+      }
+      order->resize(n);
+
+      // Buckets are ranges of order, since Reduce keeps hashes sorted.
+      auto buckets = frozen::BucketCount(n);
+      std::vector<size_t> starts(buckets + 1, n);
+      for (size_t i = n; i-- > 0;) {
+        starts[frozen::Reduce(h[(*order)[i]], buckets)] = i;
+      }
+      for (size_t b = buckets; b-- > 0;) {
+        starts[b] = std::min(starts[b], starts[b + 1]);
+      }
+
+      // Largest buckets first, while most slots are free.
+      std::vector<size_t> by_size(buckets);
+      for (size_t b = 0; b < buckets; ++b) {
+        by_size[b] = b;
+      }
+      std::stable_sort(by_size.begin(), by_size.end(),
+                       [&starts](size_t a, size_t b) {
+                         return starts[a + 1] - starts[a] >
+                                starts[b + 1] - starts[b];
+                       });
+
+      std::vector<bool> taken(n);
+      std::vector<size_t> positions;
+      slots->assign(n, 0);
+      pilots->assign(buckets, 0);
+      for (auto b : by_size) {
+        if (starts[b] == starts[b + 1]) {
+          break;
+        }
+        for (uint32_t pilot = 0;; ++pilot) {
+          if (pilot == kMaxPilot) {
+            return false;
+          }
+          positions.clear();
+          for (auto i = starts[b]; i < starts[b + 1]; ++i) {
+            auto p = frozen::Position(h[(*order)[i]], pilot, n);
+            if (taken[p] || std::find(positions.begin(), positions.end(),
+                                      p) != positions.end()) {
+              break;
+            }
+            positions.push_back(p);
+          }
+          if (positions.size() == starts[b + 1] - starts[b]) {
+            for (size_t k = 0; k < positions.size(); ++k) {
+              taken[positions[k]] = true;
+              (*slots)[starts[b] + k] = positions[k];
+            }
+            (*pilots)[b] = pilot;
+            break;
+          }
+        }
+      }
+      return true;
+    }
+
+    FrozenMap Assemble(uint64_t seed, const std::vector<size_t> &order,
+                       const std::vector<size_t> &slots,
+                       const std::vector<uint32_t> &pilots) const {
+      auto n = order.size();
+      frozen::Header header{};
+      std::memcpy(header.magic, frozen::kMagic, sizeof(header.magic));
+      header.version = frozen::kVersion;
+      header.count = n;
+      header.buckets = pilots.size();
+      header.seed = seed;
+      header.key_size = KeyField::kFixedSize;
+      header.value_size = ValueField::kFixedSize;
+      header.slot_size = sizeof(Slot);
+      header.slots_offset = frozen::AlignUp(
+          sizeof(header) + pilots.size() * sizeof(uint32_t), alignof(Slot));
+      header.blob_offset = header.slots_offset + n * sizeof(Slot);
+
+      // Copy only the live strings, so duplicates leave no garbage behind.
+      std::string blob;
+      std::vector<Slot> table(n);
+      for (size_t i = 0; i < n; ++i) {
+        const auto &entry = entries_[order[i]];
+        table[slots[i]] =
+            Slot{KeyField::Store(KeyField::Get(entry.key, blob_.data()), &blob),
+                 ValueField::Store(ValueField::Get(entry.value, blob_.data()),
+                                   &blob)};
+      }
+      header.blob_size = blob.size();
+
+      auto size = static_cast<size_t>(header.blob_offset + blob.size());
+      auto storage = std::unique_ptr<std::max_align_t[]>(
+          new std::max_align_t[size / sizeof(std::max_align_t) + 1]());
+      auto *base = reinterpret_cast<char *>(storage.get());
+      std::memcpy(base, &header, sizeof(header));
+      if (!pilots.empty()) {
+        std::memcpy(base + sizeof(header), pilots.data(),
+                    pilots.size() * sizeof(uint32_t));
+      }
+      if (n != 0) {
+        std::memcpy(base + header.slots_offset, table.data(),
+                    n * sizeof(Slot));
+      }
+      std::memcpy(base + header.blob_offset, blob.data(), blob.size());
+      return FrozenMap(std::move(storage), size);
+    }
+
+    std::vector<Entry> entries_;
+    std::string blob_;
+  };
+
+  FrozenMap() : FrozenMap(Builder().Build()) {}
+
+  template <typename... Policies>
+  explicit FrozenMap(Map<Key, Value, Policies...> &map) {
+    Builder builder;
+    builder.Reserve(map.Size());
+    map.Range([&builder](const Key &key, const Value &value) {
+      builder.Add(key, value);
+      return true;
+    });
+    *this = builder.Build();
+  }
+
+  template <typename... Policies>
+  explicit FrozenMap(HashTable<Key, Value, Policies...> &table) {
+    Builder builder;
+    builder.Reserve(table.Size());
+    table.ForEach([&builder](const Key &key, const Value &value) {
+      builder.Add(key, value);
+    });
+    *this = builder.Build();
+  }
+
+  template <typename Hash, typename KeyEqual, typename Allocator>
+  explicit FrozenMap(
+      const std::unordered_map<Key, Value, Hash, KeyEqual, Allocator> &raw) {
+    Builder builder;
+    builder.Reserve(raw.size());
+    for (const auto &kv : raw) {
+      builder.Add(kv.first, kv.second);
+    }
+    *this = builder.Build();
+  }
+
+  FrozenMap(const FrozenMap &) = delete;
+  FrozenMap &operator=(const FrozenMap &) = delete;
+
+  // The moved-from map is empty.
+  FrozenMap(FrozenMap &&other) noexcept { *this = std::move(other); }
+
+  FrozenMap &operator=(FrozenMap &&other) noexcept {
+    if (this != &other) {
+      storage_ = std::move(other.storage_);
+      file_ = std::move(other.file_);
+      base_ = std::exchange(other.base_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+      count_ = std::exchange(other.count_, 0);
+      buckets_ = std::exchange(other.buckets_, 0);
+      seed_ = other.seed_;
+      pilots_ = std::exchange(other.pilots_, nullptr);
+      slots_ = std::exchange(other.slots_, nullptr);
+      blob_ = std::exchange(other.blob_, nullptr);
+    }
+    return *this;
+  }
+
+  /**
+   * Map a file written by Save and query it in place: only the header is
+   * read now, everything else is paged in by the lookups that touch it.
+   * The header and section bounds are checked; the records are trusted.
+   * @return false, leaving the map untouched, if the file is missing,
+   * truncated or of other types.
+   */
+  bool Open(const std::string &path) {
+    auto file = std::make_unique<snapshot::MappedFile>();
+    if (!file->Open(path, snapshot::Access::kRandom)) {
+      return false;
+    }
+    FrozenMap mapped;
+    if (!mapped.Attach(file->data(), file->size())) {
+      return false;
+    }
+    mapped.storage_ = nullptr;
+    mapped.file_ = std::move(file);
+    *this = std::move(mapped);
+    return true;
+  }
+
+  // Write the map to path, replacing the file only once it is complete.
+  bool Save(const std::string &path) const {
+    auto tmp_path = path + ".tmp";
+    auto *file = std::fopen(tmp_path.c_str(), "wb");
+    if (file == nullptr) {
+      return false;
+    }
+    auto ok = std::fwrite(base_, 1, size_, file) == size_;
+    ok = std::fclose(file) == 0 && ok;
+    if (!ok || std::rename(tmp_path.c_str(), path.c_str()) != 0) {
+      std::remove(tmp_path.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  std::optional<ValueView> Find(KeyArg key) const {
+    auto *slot = FindSlot(key);
+    if (slot == nullptr) {
+      return std::nullopt;
+    }
+    return ValueField::Get(slot->value, blob_);
+  }
+
+  bool Load(KeyArg key, Value *value) const {
+    auto *slot = FindSlot(key);
+    if (slot == nullptr) {
+      return false;
+    }
+    *value = Value(ValueField::Get(slot->value, blob_));
+    return true;
+  }
+
+  bool Contains(KeyArg key) const { return FindSlot(key) != nullptr; }
+
+  size_t Size() const { return count_; }
+
+  // Call fn(KeyView, ValueView) for every entry, in slot order.
+  template <typename Fn>
+  void ForEach(Fn &&fn) const {
+    for (size_t i = 0; i < count_; ++i) {
+      fn(KeyField::Get(slots_[i].key, blob_),
+         ValueField::Get(slots_[i].value, blob_));
+    }
+  }
+
+  // Bytes of the in-memory or mapped image, as Save would write them.
+  size_t ByteSize() const { return size_; }
+
+ private:
+  FrozenMap(std::unique_ptr<std::max_align_t[]> storage, size_t size)
+      : storage_(std::move(storage)) {
+    auto attached = Attach(reinterpret_cast<const char *>(storage_.get()), size);
+    assert(attached);
+    (void)attached;
+  }
+
+  // Point the lookup fields into an image; false if it is not a valid one.
+  bool Attach(const char *base, size_t size) {
+    frozen::Header header;
+    if (size < sizeof(header)) {
+      return false;
+    }
+    std::memcpy(&header, base, sizeof(header));
+    if (std::memcmp(header.magic, frozen::kMagic, sizeof(header.magic)) != 0 ||
+        header.version != frozen::kVersion ||
+        header.key_size != KeyField::kFixedSize ||
+        header.value_size != ValueField::kFixedSize ||
+        header.slot_size != sizeof(Slot) ||
+        header.buckets != frozen::BucketCount(header.count) ||
+        header.buckets > size / sizeof(uint32_t) ||
+        header.slots_offset % alignof(Slot) != 0 ||
+        header.slots_offset <
+            sizeof(header) + header.buckets * sizeof(uint32_t) ||
+        header.slots_offset > size ||
+        header.count > (size - header.slots_offset) / sizeof(Slot) ||
+        header.blob_offset !=
+            header.slots_offset + header.count * sizeof(Slot) ||
+        header.blob_size > size - header.blob_offset) {
+      return false;
+    }
+    base_ = base;
+    size_ = static_cast<size_t>(header.blob_offset + header.blob_size);
+    count_ = static_cast<size_t>(header.count);
+    buckets_ = static_cast<size_t>(header.buckets);
+    seed_ = header.seed;
+    pilots_ = reinterpret_cast<const uint32_t *>(base + sizeof(header));
+    slots_ = reinterpret_cast<const Slot *>(base + header.slots_offset);
+    blob_ = base + header.blob_offset;
+    return true;
+  }
+
+  const Slot *FindSlot(KeyArg key) const {
+    if (count_ == 0) {
+      return nullptr;
+    }
+    auto h = frozen::Hash(KeyField::Bytes(key), seed_);
+    auto pilot = pilots_[frozen::Reduce(h, buckets_)];
+    auto *slot = &slots_[frozen::Position(h, pilot, count_)];
+    return KeyField::Equal(slot->key, blob_, key) ? slot : nullptr;
+  }
+
+  // Owns the image when built in memory; file_ when it was opened.
+  std::unique_ptr<std::max_align_t[]> storage_;
+  std::unique_ptr<snapshot::MappedFile> file_;
+  const char *base_ = nullptr;
+  size_t size_ = 0;
+  size_t count_ = 0;
+  size_t buckets_ = 0;
+  uint64_t seed_ = 0;
+  const uint32_t *pilots_ = nullptr;
+  const Slot *slots_ = nullptr;
+  const char *blob_ = nullptr;
+};
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_FROZEN_MAP_HPP_
@@ -16,17 +16,49 @@
 #include <cassert>
 #include <shared_mutex>
 #include <functional>
+#include <iterator>
+#include <memory>
+#include <string>
+#include <tuple>
 #include <unordered_map>
+#include <utility>
+
+#include "executor.hpp"
+#include "flat_combining.hpp"
+#include "lock_policy.hpp"
+#include "snapshot.hpp"
+#include "stats_policy.hpp"
+#include "striped_counter.hpp"
+#include "transparent_hash.hpp"
 
 namespace juliet::sync {
 
-template<typename Key, typename Value>
+/**
+ * @tparam LockPolicy 见lock_policy.hpp，整表使用LockPolicy::SharedMutex
+ * @tparam StatsPolicy 见stats_policy.hpp
+ * @tparam Hash
+ * @tparam KeyEqual 两者都是transparent时，Get也接受其他键类型（见transparent_hash.hpp），
+ * 如std::string键配StringHash和std::equal_to<>，可以直接用std::string_view查找
+ */
+template<typename Key, typename Value, typename LockPolicy = StdLockPolicy, typename StatsPolicy = NoStats,
+         typename Hash = std::hash<Key>, typename KeyEqual = std::equal_to<Key>>
 class HashTable {
 public:
-    using Map = std::unordered_map<Key, Value>;
+    using Map = std::unordered_map<Key, Value, Hash, KeyEqual>;
+    using SharedMutex = typename LockPolicy::SharedMutex;
 
     HashTable() = default;
 
+    // 批量载入，见BulkLoad
+    template<typename ForwardIt>
+    HashTable(ForwardIt first, ForwardIt last) {
+        BulkLoad(first, last);
+    }
+
+    explicit HashTable(Map&& m) {
+        BulkLoad(std::move(m));
+    }
+
     ~HashTable() = default;
 
     enum EPutStatus {
@@ -44,17 +76,63 @@ public:
      * @retval false 改写已有值
      */
     EPutStatus Put(const Key& key, const Value& value) {
-        std::lock_guard<std::shared_timed_mutex> guard(mu_);
-        auto status = map_.emplace(key, value);
-        if (status.second)
-            return PUT_NEW;
-        status.first->second = value;
-        return PUT_OVERWRITE;
+        return Write([&] {
+            auto status = map_.try_emplace(key, value);
+            if (status.second) {
+                size_.Increment();
+                return PUT_NEW;
+            }
+            status.first->second = value;
+            return PUT_OVERWRITE;
+        });
+    }
+
+    EPutStatus Put(const Key& key, Value&& value) {
+        return Write([&] {
+            auto status = map_.try_emplace(key, std::move(value));
+            if (status.second) {
+                size_.Increment();
+                return PUT_NEW;
+            }
+            status.first->second = std::move(value);
+            return PUT_OVERWRITE;
+        });
     }
 
     EPutStatus TryPut(const Key& key, const Value& value) {
-        std::lock_guard<std::shared_timed_mutex> guard(mu_);
-        return map_.emplace(key, value).second ? PUT_NEW : PUT_SKIPPED;
+        return Write([&] { return Inserted(map_.try_emplace(key, value).second); });
+    }
+
+    EPutStatus TryPut(const Key& key, Value&& value) {
+        return Write([&] { return Inserted(map_.try_emplace(key, std::move(value)).second); });
+    }
+
+    /**
+     * 用args原地构造value并写入，已有值时改写（要求Value可移动赋值）
+     * @return PUT_NEW 或 PUT_OVERWRITE
+     */
+    template<typename... Args>
+    EPutStatus Emplace(const Key& key, Args&&... args) {
+        return Write([&] {
+            auto it = map_.find(key);
+            if (it == map_.end()) {
+                map_.emplace(std::piecewise_construct, std::forward_as_tuple(key),
+                             std::forward_as_tuple(std::forward<Args>(args)...));
+                size_.Increment();
+                return PUT_NEW;
+            }
+            it->second = Value(std::forward<Args>(args)...);
+            return PUT_OVERWRITE;
+        });
+    }
+
+    /**
+     * 只在key不存在时用args原地构造value，已存在时不构造、不改写
+     * @return PUT_NEW 或 PUT_SKIPPED
+     */
+    template<typename... Args>
+    EPutStatus TryEmplace(const Key& key, Args&&... args) {
+        return Write([&] { return Inserted(map_.try_emplace(key, std::forward<Args>(args)...).second); });
     }
 
     Value Get(const Key& key) const {
@@ -64,18 +142,27 @@ public:
     }
 
     bool Get(const Key& key, Value& value) const {
-        std::shared_lock<std::shared_timed_mutex> lock(mu_);
-        auto it = map_.find(key);
-        if (it != map_.end()) {
-            value = it->second;
-            return true;
-        }
-        return false;
+        return GetAs(key, value);
+    }
+
+    // 用与Key相等的K查找，不构造临时的Key；只在Hash和KeyEqual都是transparent时可用
+    template<typename K, typename = EnableHeterogeneous<K, Key, Hash, KeyEqual>>
+    Value Get(const K& key) const {
+        Value result{};
+        GetAs(key, result);
+        return result;
+    }
+
+    template<typename K, typename = EnableHeterogeneous<K, Key, Hash, KeyEqual>>
+    bool Get(const K& key, Value& value) const {
+        return GetAs(key, value);
     }
 
     void Remove(const Key& key) {
-        Value v;
-        Remove(key, v);
+        Write([&] {
+            if (map_.erase(key) != 0)
+                size_.Decrement();
+        });
     }
 
     /**
@@ -85,14 +172,16 @@ public:
      * @return 是否返回value
      */
     bool Remove(const Key& key, Value& value) {
-        std::lock_guard<std::shared_timed_mutex> guard(mu_);
-        auto it = map_.find(key);
-        if (it != map_.end()) {
-            value = std::move(it->second);
-            map_.erase(it);
-            return true;
-        }
-        return false;
+        return Write([&] {
+            auto it = map_.find(key);
+            if (it != map_.end()) {
+                value = std::move(it->second);
+                map_.erase(it);
+                size_.Decrement();
+                return true;
+            }
+            return false;
+        });
     }
 
     void Clear() {
@@ -102,8 +191,99 @@ public:
 
     void Clear(Map& m) {
         m.clear();
-        std::lock_guard<std::shared_timed_mutex> guard(mu_);
+        auto guard = StatsLock<std::lock_guard<SharedMutex>>(stats_, mu_);
         map_.swap(m);
+        size_.Add(-static_cast<int64_t>(m.size()));
+    }
+
+    /**
+     * 把整表写入快照文件（格式见snapshot.hpp），写完后才替换path
+     * 全程持有共享锁，得到的是一致的快照：读者不受影响，写者要等写完
+     * @return I/O出错时返回false
+     */
+    bool SaveSnapshot(const std::string& path) const {
+        SnapshotWriter<Key, Value> writer;
+        if (!writer.Open(path))
+            return false;
+        {
+            auto lock = StatsSharedLock<std::shared_lock<SharedMutex>>(stats_, mu_);
+            for (const auto& kv : map_) {
+                writer.Write(kv.first, kv.second);
+            }
+        }
+        return writer.Commit();
+    }
+
+    /**
+     * 用SaveSnapshot写出的快照替换全部内容
+     * 在锁外按记录数预留桶并一次遍历建好新表，加锁后只做一次swap
+     * @return 文件不存在、被截断或类型不符时返回false，原内容不变
+     */
+    bool LoadSnapshot(const std::string& path) {
+        SnapshotReader<Key, Value> reader;
+        if (!reader.Open(path))
+            return false;
+        Map m;
+        m.reserve(reader.Count());
+        if (!reader.ForEach([&m](Key&& key, Value&& value) { m.emplace(std::move(key), std::move(value)); }))
+            return false;
+
+        Replace(m);
+        return true;
+    }
+
+    /**
+     * 用[first, last)替换全部内容，键相同时后者覆盖前者
+     * 在锁外按元素个数预留桶并建好新表，加锁后只做一次swap
+     */
+    template<typename ForwardIt>
+    void BulkLoad(ForwardIt first, ForwardIt last) {
+        Map m;
+        m.reserve(static_cast<size_t>(std::distance(first, last)));
+        for (; first != last; ++first) {
+            auto&& kv = *first;
+            m.insert_or_assign(kv.first, std::forward<decltype(kv)>(kv).second);
+        }
+        Replace(m);
+    }
+
+    // 直接接管m的内容，m被清空
+    void BulkLoad(Map&& m) {
+        Replace(m);
+        m.clear();
+    }
+
+    // 预留n个元素的桶，之后的写入不再rehash
+    void Reserve(size_t n) {
+        auto guard = StatsLock<std::lock_guard<SharedMutex>>(stats_, mu_);
+        map_.reserve(n);
+    }
+
+    /**
+     * 元素个数，不加锁，O(核数)
+     * 与并发写入同时调用时是近似值
+     */
+    size_t Size() const {
+        auto size = size_.Sum();
+        return size > 0 ? static_cast<size_t>(size) : 0;
+    }
+
+    /**
+     * 开启flat combining：写线程把Put/TryPut/Emplace/TryEmplace/Remove发布到各自的槽位，
+     * 拿到写锁的线程一次执行所有待执行的写操作，其他写线程在自己的槽位上自旋等待，
+     * 写竞争激烈时写锁只在批次之间交接（见flat_combining.hpp）
+     * 被合并的写操作不计入StatsPolicy的锁等待和持有时间；须在表被多个线程共享之前调用
+     */
+    void EnableFlatCombining() {
+        combiner_ = std::make_unique<FlatCombiner>();
+    }
+
+    /**
+     * 写者（独占锁）和读者（共享锁）等锁、持锁的耗时分布
+     * StatsPolicy未启用时为空
+     */
+    StatsSnapshot Stats() const {
+        return stats_.Stats();
     }
 
     // 枚举器
@@ -113,12 +293,43 @@ public:
         if (!enumerator)
             return;
 
-        std::shared_lock<std::shared_timed_mutex> lock(mu_);
+        auto lock = StatsSharedLock<std::shared_lock<SharedMutex>>(stats_, mu_);
         for (const auto& kv : map_) {
             enumerator(kv.first, kv.second);
         }
     }
 
+    /**
+     * 把桶分给executor的工作线程和调用线程并行遍历，全程持有共享锁
+     * enumerator会被并发调用
+     */
+    template<typename Visitor>
+    void ParallelForEach(Executor& executor, Visitor&& visitor) {
+        auto lock = StatsSharedLock<std::shared_lock<SharedMutex>>(stats_, mu_);
+        executor.ParallelFor(0, map_.bucket_count(), 0, [&](size_t first, size_t last, size_t) {
+            for (auto b = first; b < last; ++b) {
+                for (auto it = map_.begin(b); it != map_.end(b); ++it)
+                    visitor(it->first, it->second);
+            }
+        });
+    }
+
+    /**
+     * 并行遍历并归约：visit(partial, key, value)累加到所在线程的部分结果，
+     * combine(result, partial)合并各部分结果，见Executor::ParallelReduce
+     */
+    template<typename T, typename Visit, typename Combine>
+    T ParallelForEach(Executor& executor, T identity, Visit&& visit, Combine&& combine) {
+        auto lock = StatsSharedLock<std::shared_lock<SharedMutex>>(stats_, mu_);
+        return executor.ParallelReduce(0, map_.bucket_count(), 0, std::move(identity),
+            [&](T& partial, size_t first, size_t last) {
+                for (auto b = first; b < last; ++b) {
+                    for (auto it = map_.begin(b); it != map_.end(b); ++it)
+                        visit(partial, it->first, it->second);
+                }
+            }, combine);
+    }
+
     // 移除谓词
     using RemovePredicator = std::function<bool (const Key& key, const Value& value)>;
 
@@ -127,7 +338,7 @@ public:
         if (!predicator)
             return count;
 
-        std::lock_guard<std::shared_timed_mutex> guard(mu_);
+        auto guard = StatsLock<std::lock_guard<SharedMutex>>(stats_, mu_);
         for (auto it = map_.begin(); it != map_.end(); ++it) {
             if (predicator(it->first, it->second))
                 ++it;
@@ -136,12 +347,70 @@ public:
                 map_.erase(it);
             }
         }
+        size_.Add(-count);
         return count;
     }
 
 private:
-    mutable std::shared_timed_mutex mu_;
+    template<typename K>
+    bool GetAs(const K& key, Value& value) const {
+        auto lock = StatsSharedLock<std::shared_lock<SharedMutex>>(stats_, mu_);
+        auto it = Find(key);
+        if (it != map_.end()) {
+            value = it->second;
+            return true;
+        }
+        return false;
+    }
+
+    typename Map::const_iterator Find(const Key& key) const {
+        return map_.find(key);
+    }
+
+    template<typename K>
+    typename Map::const_iterator Find(const K& key) const {
+#if defined(__cpp_lib_generic_unordered_lookup)
+        return map_.find(key);
+#else
+        // C++17的unordered_map没有异构find：每个线程借一个Key，赋值时复用它的缓冲区
+        // （如std::string），缓冲区够大后查找就不再分配
+        thread_local Key scratch{};
+        scratch = key;
+        return map_.find(scratch);
+#endif
+    }
+
+    // 用m替换map_，原内容换入m
+    void Replace(Map& m) {
+        auto size = static_cast<int64_t>(m.size());
+        auto guard = StatsLock<std::lock_guard<SharedMutex>>(stats_, mu_);
+        map_.swap(m);
+        size_.Add(size - static_cast<int64_t>(m.size()));
+    }
+
+    // 在mu_下执行fn；开启flat combining后交给combiner_，可能由另一个写线程代为执行
+    template<typename Fn>
+    auto Write(Fn&& fn) {
+        if (combiner_)
+            return combiner_->Run(mu_, fn);
+        auto guard = StatsLock<std::lock_guard<SharedMutex>>(stats_, mu_);
+        return fn();
+    }
+
+    EPutStatus Inserted(bool inserted) {
+        if (!inserted)
+            return PUT_SKIPPED;
+        size_.Increment();
+        return PUT_NEW;
+    }
+
+    mutable SharedMutex mu_;
     Map map_;
+    // 读Size()时不用拿mu_
+    StripedCounter size_;
+    mutable StatsPolicy stats_;
+    // 调用EnableFlatCombining之前为空
+    std::unique_ptr<FlatCombiner> combiner_;
 };
 
 }
@@ -0,0 +1,495 @@
+/**
+ * @file hot_keys.hpp
+ * @brief Heavy-hitter detection and replicas of the hottest keys.
+ * One read in sample_interval (per thread) is counted in a count-min sketch.
+ * Keys whose estimate passes a threshold compete for a few hot slots. Counts
+ * are halved periodically, so slots follow current traffic.
+ * Once a hot slot is armed, a sampled read copies the key's value into it.
+ * From then on a read of that key is served from the copy. The reader pins
+ * an epoch and compares a few hashes; it takes no container lock and
+ * touches no shared reference count, so it writes nothing that another
+ * core reads.
+ * Writers lock the slot of the key they write, write through, and drop the
+ * copy before unlocking. Refills happen under the same lock, so a reader
+ * never sees a value older than the last completed write. A new slot is
+ * armed only after every writer that may have missed it has finished; Epoch
+ * provides that grace period.
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_HOT_KEYS_HPP_
+#define _JULIET_SYNC_HOT_KEYS_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "epoch.hpp"
+#include "intrusive.hpp"
+
+namespace juliet::sync {
+
+struct HotKeyOptions {
+  // Hot slots, i.e. replicated keys, at most.
+  size_t capacity = 16;
+  // Count one read in this many per thread; rounded up to a power of two.
+  uint32_t sample_interval = 32;
+  // Sampled reads a key needs, as estimated, to take a hot slot.
+  uint32_t threshold = 64;
+  // Halve every count after this many samples.
+  uint32_t decay_interval = 1 << 16;
+  // Counters per sketch row; rounded up to a power of two.
+  size_t sketch_width = 4096;
+};
+
+template <typename Key>
+struct HotKey {
+  Key key;
+  // Reads since the last few decays, estimated from the samples.
+  uint64_t reads;
+  // Whether a replica serves the key's reads right now.
+  bool replicated;
+};
+
+/**
+ * Count-min sketch of 32-bit counters with conservative update: an add
+ * raises only the rows at the minimum. Estimates never undercount, except
+ * for adds racing with each other or with Halve.
+ */
+class CountMinSketch {
+ public:
+  explicit CountMinSketch(size_t width) {
+    while ((size_t{1} << bits_) < width) {
+      ++bits_;
+    }
+    counters_ = std::make_unique<std::atomic<uint32_t>[]>(kDepth << bits_);
+    for (size_t i = 0; i < (kDepth << bits_); ++i) {
+      counters_[i].store(0, std::memory_order_relaxed);
+    }
+  }
+
+  // Count hash once. @return its new estimate.
+  uint32_t Add(size_t hash) {
+    size_t index[kDepth];
+    uint32_t count[kDepth];
+    uint32_t min = UINT32_MAX;
+    for (size_t row = 0; row < kDepth; ++row) {
+      index[row] = Index(row, hash);
+      count[row] = counters_[index[row]].load(std::memory_order_relaxed);
+      min = std::min(min, count[row]);
+    }
+    if (min == UINT32_MAX) {
+      return min;
+    }
+    for (size_t row = 0; row < kDepth; ++row) {
+      if (count[row] == min) {
+        counters_[index[row]].fetch_add(1, std::memory_order_relaxed);
+      }
+    }
+    return min + 1;
+  }
+
+  uint32_t Estimate(size_t hash) const {
+    uint32_t min = UINT32_MAX;
+    for (size_t row = 0; row < kDepth; ++row) {
+      min = std::min(
+          min, counters_[Index(row, hash)].load(std::memory_order_relaxed));
+    }
+    return min;
+  }
+
+  void Halve() {
+    for (size_t i = 0; i < (kDepth << bits_); ++i) {
+      auto &counter = counters_[i];
+      counter.store(counter.load(std::memory_order_relaxed) / 2,
+                    std::memory_order_relaxed);
+    }
+  }
+
+ private:
+  static constexpr size_t kDepth = 4;
+
+  // Multiplicative hashing with one odd constant per row, on top of a
+  // finalizer, since std::hash of an integer is the identity.
+  size_t Index(size_t row, size_t hash) const {
+    static constexpr uint64_t kSeeds[kDepth] = {
+        0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL,
+        0xD6E8FEB86659FD93ULL};
+    uint64_t h = hash;
+    h ^= h >> 33;
+    h *= 0xFF51AFD7ED558CCDULL;
+    h ^= h >> 33;
+    auto column = bits_ == 0 ? 0 : (h * kSeeds[row]) >> (64 - bits_);
+    return (row << bits_) | static_cast<size_t>(column);
+  }
+
+  size_t bits_ = 0;
+  std::unique_ptr<std::atomic<uint32_t>[]> counters_;
+};
+
+/**
+ * The hot-key detector and replica set of one container.
+ * The container routes its reads through Load and brackets its writes with
+ * Write, or with WriteAll for writes that replace the whole contents.
+ * @tparam Mutex serializes writers and refills of one hot key.
+ */
+template <typename Key, typename Value, typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>,
+          typename Mutex = std::mutex>
+class HotKeyTracker {
+  struct Slot;
+
+ public:
+  /**
+   * Keeps the calling thread pinned, and if key is hot keeps its slot
+   * locked. When destroyed it drops the key's replica, or every replica for
+   * WriteAll, and then unlocks.
+   */
+  class WriteGuard {
+   public:
+    WriteGuard(WriteGuard &&rr) noexcept
+        : pin_(std::move(rr.pin_)),
+          tracker_(rr.tracker_),
+          slot_(std::exchange(rr.slot_, nullptr)),
+          all_(std::exchange(rr.all_, false)),
+          lock_(std::move(rr.lock_)) {}
+    WriteGuard(const WriteGuard &) = delete;
+    WriteGuard &operator=(const WriteGuard &) = delete;
+    WriteGuard &operator=(WriteGuard &&) = delete;
+
+    ~WriteGuard() {
+      if (slot_ != nullptr) {
+        Invalidate(*slot_);
+      } else if (all_) {
+        tracker_->InvalidateAll();
+      }
+    }
+
+   private:
+    friend class HotKeyTracker;
+
+    WriteGuard() = default;
+
+    // Declared first: unpinned only after the slot is unlocked.
+    std::optional<Epoch::Guard> pin_;
+    HotKeyTracker *tracker_ = nullptr;
+    Slot *slot_ = nullptr;
+    bool all_ = false;
+    std::unique_lock<Mutex> lock_;
+  };
+
+  explicit HotKeyTracker(const HotKeyOptions &options = HotKeyOptions())
+      : options_(options), sketch_(options.sketch_width) {
+    uint32_t interval = 1;
+    while (interval < options_.sample_interval) {
+      interval <<= 1;
+    }
+    options_.sample_interval = interval;
+    options_.capacity = std::max<size_t>(options_.capacity, 1);
+  }
+
+  HotKeyTracker(const HotKeyTracker &) = delete;
+  HotKeyTracker &operator=(const HotKeyTracker &) = delete;
+
+  // Not safe against concurrent access.
+  ~HotKeyTracker() { delete set_.load(std::memory_order_relaxed); }
+
+  /**
+   * Read key from its replica, or else through load(key, value), which
+   * reads the container itself and returns whether key was found.
+   */
+  template <typename K, typename LoadFn>
+  bool Load(const K &key, Value *value, LoadFn &&load) {
+    auto sampled = (++Tick() & (options_.sample_interval - 1)) == 0;
+    if (!sampled && set_.load(std::memory_order_relaxed) == nullptr) {
+      return load(key, value);
+    }
+    Epoch::Guard guard;
+    auto hash = hash_(key);
+    if (auto *slot = Find(set_.load(std::memory_order_acquire), hash, key)) {
+      if (auto *replica = slot->value.load(std::memory_order_acquire)) {
+        *value = *replica;
+        if (sampled) {
+          Record(hash, key);
+        }
+        return true;
+      }
+    }
+    auto found = load(key, value);
+    if (sampled) {
+      auto *slot = Record(hash, key);
+      if (found && slot != nullptr) {
+        Refill(*slot, key, *value, load);
+      }
+    }
+    return found;
+  }
+
+  // Hold the result while writing key. tracker may be null.
+  static WriteGuard Write(HotKeyTracker *tracker, const Key &key) {
+    WriteGuard guard;
+    if (tracker != nullptr) {
+      guard.pin_.emplace();
+      guard.tracker_ = tracker;
+      auto hash = tracker->hash_(key);
+      guard.slot_ = tracker->Find(
+          tracker->set_.load(std::memory_order_acquire), hash, key);
+      if (guard.slot_ != nullptr) {
+        guard.lock_ = std::unique_lock<Mutex>(guard.slot_->mu);
+      }
+    }
+    return guard;
+  }
+
+  // Hold the result while replacing the whole contents. tracker may be null.
+  static WriteGuard WriteAll(HotKeyTracker *tracker) {
+    WriteGuard guard;
+    if (tracker != nullptr) {
+      guard.pin_.emplace();
+      guard.tracker_ = tracker;
+      guard.all_ = true;
+    }
+    return guard;
+  }
+
+  // Keys holding a hot slot, hottest first.
+  std::vector<HotKey<Key>> Top() const {
+    std::vector<HotKey<Key>> top;
+    {
+      std::lock_guard<std::mutex> guard(mu_);
+      if (const auto *set = set_.load(std::memory_order_relaxed)) {
+        top.reserve(set->slots.size());
+        for (const auto &slot : set->slots) {
+          top.push_back(HotKey<Key>{
+              slot->key, uint64_t{slot->count} * options_.sample_interval,
+              slot->value.load(std::memory_order_relaxed) != nullptr});
+        }
+      }
+    }
+    std::sort(top.begin(), top.end(), [](const auto &a, const auto &b) {
+      return a.reads > b.reads;
+    });
+    return top;
+  }
+
+ private:
+  struct Slot : public RefCounted {
+    Slot(Key k, size_t h, uint32_t c) : key(std::move(k)), hash(h), count(c) {}
+
+    ~Slot() override { delete value.load(std::memory_order_relaxed); }
+
+    const Key key;
+    const size_t hash;
+    // Estimated sampled reads. Guarded by the tracker's mu_.
+    uint32_t count;
+    // Set once writers that may have missed this slot are done.
+    std::atomic<bool> armed{false};
+    Mutex mu;
+    // The replica, or null. Replaced under mu; reclaimed through Epoch.
+    std::atomic<Value *> value{nullptr};
+  };
+
+  using SlotPtr = IntrusivePtr<Slot>;
+
+  // Immutable once published.
+  struct Set {
+    std::vector<size_t> hashes;
+    std::vector<SlotPtr> slots;
+  };
+
+  static uint32_t &Tick() {
+    thread_local uint32_t tick = 0;
+    return tick;
+  }
+
+  // Call pinned.
+  template <typename K>
+  Slot *Find(const Set *set, size_t hash, const K &key) const {
+    if (set == nullptr) {
+      return nullptr;
+    }
+    for (size_t i = 0; i < set->hashes.size(); ++i) {
+      if (set->hashes[i] == hash && equal_(set->slots[i]->key, key)) {
+        return set->slots[i].get();
+      }
+    }
+    return nullptr;
+  }
+
+  static void Invalidate(Slot &slot) {
+    if (auto *old = slot.value.exchange(nullptr, std::memory_order_acq_rel)) {
+      Epoch::Retire(old);
+    }
+  }
+
+  // Call pinned.
+  void InvalidateAll() {
+    if (auto *set = set_.load(std::memory_order_acquire)) {
+      for (const auto &slot : set->slots) {
+        std::lock_guard<Mutex> guard(slot->mu);
+        Invalidate(*slot);
+      }
+    }
+  }
+
+  // Copy value into slot, re-reading it under the slot's lock so no write
+  // can complete in between.
+  template <typename K, typename LoadFn>
+  void Refill(Slot &slot, const K &key, const Value &seen, LoadFn &load) {
+    if (!slot.armed.load(std::memory_order_acquire) ||
+        slot.value.load(std::memory_order_relaxed) != nullptr) {
+      return;
+    }
+    std::lock_guard<Mutex> guard(slot.mu);
+    if (slot.value.load(std::memory_order_relaxed) != nullptr) {
+      return;
+    }
+    auto replica = std::make_unique<Value>(seen);
+    if (load(key, replica.get())) {
+      slot.value.store(replica.release(), std::memory_order_release);
+    }
+  }
+
+  /**
+   * Count a sampled read of key, which may give it a hot slot. Call pinned.
+   * @return key's slot, if it has one.
+   */
+  template <typename K>
+  Slot *Record(size_t hash, const K &key) {
+    auto estimate = sketch_.Add(hash);
+    if (samples_.fetch_add(1, std::memory_order_relaxed) + 1 ==
+        options_.decay_interval) {
+      Decay();
+    }
+    // A K that cannot make a Key is counted, but cannot take a slot.
+    if (estimate < options_.threshold ||
+        !std::is_constructible_v<Key, const K &>) {
+      return Find(set_.load(std::memory_order_acquire), hash, key);
+    }
+    std::unique_lock<std::mutex> lock(mu_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      return Find(set_.load(std::memory_order_acquire), hash, key);
+    }
+    const auto *set = set_.load(std::memory_order_relaxed);
+    if (auto *slot = Find(set, hash, key)) {
+      slot->count = estimate;
+      return slot;
+    }
+
+    auto size = set != nullptr ? set->slots.size() : 0;
+    auto victim = size;
+    if (size == options_.capacity) {
+      victim = 0;
+      for (size_t i = 1; i < size; ++i) {
+        if (set->slots[i]->count < set->slots[victim]->count) {
+          victim = i;
+        }
+      }
+      if (set->slots[victim]->count >= estimate) {
+        return nullptr;
+      }
+    }
+    SlotPtr slot;
+    if constexpr (std::is_constructible_v<Key, const K &>) {
+      slot = SlotPtr(new Slot(Key(key), hash, estimate));
+    }
+    std::vector<SlotPtr> evicted;
+    auto *next = new Set;
+    for (size_t i = 0; i < size; ++i) {
+      (i == victim ? evicted : next->slots).push_back(set->slots[i]);
+    }
+    next->slots.push_back(slot);
+    Publish(next, slot);
+    lock.unlock();
+    DropReplicas(evicted);
+    return slot.get();
+  }
+
+  // Halve the sketch and the slot counts; slots that were not read enough
+  // since the last decay lose their place.
+  void Decay() {
+    sketch_.Halve();
+    std::vector<SlotPtr> evicted;
+    {
+      std::lock_guard<std::mutex> guard(mu_);
+      samples_.fetch_sub(options_.decay_interval, std::memory_order_relaxed);
+      const auto *set = set_.load(std::memory_order_relaxed);
+      if (set == nullptr) {
+        return;
+      }
+      auto *next = new Set;
+      for (const auto &slot : set->slots) {
+        slot->count /= 2;
+        (slot->count < options_.threshold / 2 ? evicted : next->slots)
+            .push_back(slot);
+      }
+      if (evicted.empty()) {
+        delete next;
+        return;
+      }
+      Publish(next, nullptr);
+    }
+    DropReplicas(evicted);
+  }
+
+  // Call with mu_ held and pinned. added is the new slot, if any.
+  void Publish(Set *next, const SlotPtr &added) {
+    next->hashes.reserve(next->slots.size());
+    for (const auto &slot : next->slots) {
+      next->hashes.push_back(slot->hash);
+    }
+    if (next->slots.empty()) {
+      delete next;
+      next = nullptr;
+    }
+    auto *old = set_.exchange(next, std::memory_order_acq_rel);
+    if (added != nullptr) {
+      // Writers that looked the key up in old may still be writing without
+      // the slot's lock; arm the slot once they are all done.
+      Epoch::Retire(new SlotPtr(added), [](void *p) {
+        auto *slot = static_cast<SlotPtr *>(p);
+        (*slot)->armed.store(true, std::memory_order_release);
+        delete slot;
+      });
+    }
+    if (old != nullptr) {
+      Epoch::Retire(old);
+    }
+  }
+
+  // Readers pinned on an older set may still find these slots.
+  static void DropReplicas(const std::vector<SlotPtr> &slots) {
+    for (const auto &slot : slots) {
+      std::lock_guard<Mutex> guard(slot->mu);
+      Invalidate(*slot);
+    }
+  }
+
+  HotKeyOptions options_;
+  CountMinSketch sketch_;
+  std::atomic<uint32_t> samples_{0};
+  // Null while no key is hot.
+  std::atomic<Set *> set_{nullptr};
+  // Serializes changes to the set and guards slot counts.
+  mutable std::mutex mu_;
+  Hash hash_;
+  KeyEqual equal_;
+};
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_HOT_KEYS_HPP_
@@ -0,0 +1,249 @@
+/**
+ * @file intrusive.hpp
+ * @brief Intrusive reference counting for container nodes.
+ *   - RefCounted: base class carrying the count; deletes itself at zero.
+ *   - IntrusivePtr<T>: owning pointer to a RefCounted object.
+ *   - ValueRef<T>: pointer to a value plus the RefCounted object that owns
+ *     it, like shared_ptr's aliasing constructor. Lets a value embedded in a
+ *     node be handed out without a separate allocation.
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_INTRUSIVE_HPP_
+#define _JULIET_SYNC_INTRUSIVE_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace juliet::sync {
+
+class RefCounted {
+ public:
+  RefCounted(const RefCounted &) = delete;
+  RefCounted &operator=(const RefCounted &) = delete;
+
+  void AddRef() const { refs_.fetch_add(1, std::memory_order_relaxed); }
+
+  void Release() const {
+    if (refs_.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+      delete this;
+    }
+  }
+
+  uint32_t RefCount() const { return refs_.load(std::memory_order_relaxed); }
+
+ protected:
+  RefCounted() = default;
+  virtual ~RefCounted() = default;
+
+ private:
+  mutable std::atomic<uint32_t> refs_{0};
+};
+
+template <typename T>
+class IntrusivePtr {
+ public:
+  IntrusivePtr() = default;
+
+  IntrusivePtr(std::nullptr_t) {}
+
+  explicit IntrusivePtr(T *ptr) : ptr_(ptr) {
+    if (ptr_ != nullptr) {
+      ptr_->AddRef();
+    }
+  }
+
+  IntrusivePtr(const IntrusivePtr &rr) : IntrusivePtr(rr.ptr_) {}
+
+  IntrusivePtr(IntrusivePtr &&rr) noexcept : ptr_(rr.ptr_) { rr.ptr_ = nullptr; }
+
+  ~IntrusivePtr() {
+    if (ptr_ != nullptr) {
+      ptr_->Release();
+    }
+  }
+
+  IntrusivePtr &operator=(IntrusivePtr rr) noexcept {
+    swap(rr);
+    return *this;
+  }
+
+  T *get() const { return ptr_; }
+
+  T &operator*() const { return *ptr_; }
+
+  T *operator->() const { return ptr_; }
+
+  explicit operator bool() const { return ptr_ != nullptr; }
+
+  void reset() { IntrusivePtr().swap(*this); }
+
+  void swap(IntrusivePtr &rr) noexcept { std::swap(ptr_, rr.ptr_); }
+
+  friend bool operator==(const IntrusivePtr &a, const IntrusivePtr &b) {
+    return a.ptr_ == b.ptr_;
+  }
+
+  friend bool operator!=(const IntrusivePtr &a, const IntrusivePtr &b) {
+    return a.ptr_ != b.ptr_;
+  }
+
+  friend bool operator==(const IntrusivePtr &a, std::nullptr_t) {
+    return a.ptr_ == nullptr;
+  }
+
+  friend bool operator!=(const IntrusivePtr &a, std::nullptr_t) {
+    return a.ptr_ != nullptr;
+  }
+
+ private:
+  T *ptr_ = nullptr;
+};
+
+template <typename T, typename... Args>
+IntrusivePtr<T> MakeIntrusive(Args &&...args) {
+  return IntrusivePtr<T>(new T(std::forward<Args>(args)...));
+}
+
+/**
+ * A value pointer that keeps its owner alive. A null owner means the
+ * reference is borrowed: the holder (a node that embeds the value) already
+ * guarantees the lifetime. Borrowed refs never leave the node; the node
+ * hands out owned copies with itself as owner.
+ */
+template <typename T>
+class ValueRef {
+ public:
+  ValueRef() = default;
+
+  ValueRef(std::nullptr_t) {}
+
+  ValueRef(T *value, const RefCounted *owner) : value_(value), owner_(owner) {
+    if (owner_ != nullptr) {
+      owner_->AddRef();
+    }
+  }
+
+  template <typename U,
+            typename = std::enable_if_t<std::is_convertible_v<U *, T *>>>
+  ValueRef(const ValueRef<U> &rr) : ValueRef(rr.get(), rr.owner()) {}
+
+  ValueRef(const ValueRef &rr) : ValueRef(rr.value_, rr.owner_) {}
+
+  ValueRef(ValueRef &&rr) noexcept : value_(rr.value_), owner_(rr.owner_) {
+    rr.value_ = nullptr;
+    rr.owner_ = nullptr;
+  }
+
+  ~ValueRef() {
+    if (owner_ != nullptr) {
+      owner_->Release();
+    }
+  }
+
+  ValueRef &operator=(ValueRef rr) noexcept {
+    swap(rr);
+    return *this;
+  }
+
+  static ValueRef Borrowed(T *value) {
+    ValueRef ref;
+    ref.value_ = value;
+    return ref;
+  }
+
+  T *get() const { return value_; }
+
+  const RefCounted *owner() const { return owner_; }
+
+  T &operator*() const { return *value_; }
+
+  T *operator->() const { return value_; }
+
+  explicit operator bool() const { return value_ != nullptr; }
+
+  void reset() { ValueRef().swap(*this); }
+
+  void swap(ValueRef &rr) noexcept {
+    std::swap(value_, rr.value_);
+    std::swap(owner_, rr.owner_);
+  }
+
+  friend bool operator==(const ValueRef &a, std::nullptr_t) {
+    return a.value_ == nullptr;
+  }
+
+  friend bool operator!=(const ValueRef &a, std::nullptr_t) {
+    return a.value_ != nullptr;
+  }
+
+ private:
+  T *value_ = nullptr;
+  const RefCounted *owner_ = nullptr;
+};
+
+/**
+ * Heap box for a value that outlives the node it was stored in.
+ */
+template <typename Value>
+class HeapValue final : public RefCounted {
+ public:
+  template <typename Factory>
+  static ValueRef<Value> Make(Factory &&factory) {
+    auto *box = new HeapValue(std::forward<Factory>(factory));
+    return ValueRef<Value>(&box->value_, box);
+  }
+
+ private:
+  template <typename Factory>
+  explicit HeapValue(Factory &&factory) : value_(factory()) {}
+
+  Value value_;
+};
+
+/**
+ * Storage for one value constructed in place on demand. Used to co-allocate
+ * a node's first value with the node itself.
+ */
+template <typename Value>
+class EmbeddedValue {
+ public:
+  EmbeddedValue() = default;
+  EmbeddedValue(const EmbeddedValue &) = delete;
+  EmbeddedValue &operator=(const EmbeddedValue &) = delete;
+
+  ~EmbeddedValue() {
+    if (constructed_) {
+      get()->~Value();
+    }
+  }
+
+  bool constructed() const { return constructed_; }
+
+  template <typename Factory>
+  Value *Construct(Factory &&factory) {
+    auto *value = ::new (static_cast<void *>(storage_)) Value(factory());
+    constructed_ = true;
+    return value;
+  }
+
+  Value *get() { return std::launder(reinterpret_cast<Value *>(storage_)); }
+
+ private:
+  alignas(Value) unsigned char storage_[sizeof(Value)];
+  bool constructed_ = false;
+};
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_INTRUSIVE_HPP_
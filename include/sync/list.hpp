@@ -14,56 +14,128 @@
 
 #include <list>
 #include <atomic>
+#include <iterator>
 #include <mutex>
 #include <shared_mutex>
 #include <functional>
+#include <utility>
+#include <vector>
+
+#include "executor.hpp"
+#include "lock_policy.hpp"
+#include "stats_policy.hpp"
+#include "striped_counter.hpp"
 
 namespace juliet::sync {
 
-template<typename Type>
+/**
+ * @tparam LockPolicy 见lock_policy.hpp。链表用SharedMutex，缓冲区用Mutex
+ * @tparam StatsPolicy 见stats_policy.hpp
+ */
+template<typename Type, typename LockPolicy = StdLockPolicy, typename StatsPolicy = NoStats>
 class List {
 public:
+    using Mutex = typename LockPolicy::Mutex;
+    using SharedMutex = typename LockPolicy::SharedMutex;
+
     template<typename Container>
     explicit List(const Container& container) : list_(container.begin(), container.end()) {
-
+        size_.Add(static_cast<int64_t>(list_.size()));
     }
 
     explicit List(std::list<Type>&& list) : list_(std::move(list)) {
-
+        size_.Add(static_cast<int64_t>(list_.size()));
     }
 
-    List(List<Type>&& rr) noexcept : listMut_(std::move(rr.listMut_)), list_(std::move(rr.list_))
+    List(List&& rr) noexcept : listMut_(std::move(rr.listMut_)), list_(std::move(rr.list_))
     , buffer_(std::move(rr.buffer_)), bufferMut_(std::move(rr.bufferMut_)) {
-
+        size_.Add(rr.size_.Sum());
+        rr.size_.Reset();
     }
 
     void Add(const Type& value) {
-        std::lock_guard<std::mutex> guard(bufferMut_);
-        buffer_.emplace_back(value);
+        Emplace(value);
     }
 
-    void ForEach(const std::function<void (const Type&)>& func) {
+    void Add(Type&& value) {
+        Emplace(std::move(value));
+    }
+
+    // 在锁外构造节点，加锁后只做一次splice
+    template<typename... Args>
+    void Emplace(Args&&... args) {
+        std::list<Type> node;
+        node.emplace_back(std::forward<Args>(args)...);
         {
-            std::lock_guard<std::shared_timed_mutex> guard(listMut_);
+            auto guard = StatsLock<std::lock_guard<Mutex>>(stats_, bufferMut_);
+            buffer_.splice(buffer_.end(), node);
+        }
+        size_.Increment();
+    }
+
+    /**
+     * 元素个数，不加锁，O(核数)
+     * 与并发Add/ForEachRemove同时调用时是近似值
+     */
+    size_t Size() const {
+        auto size = size_.Sum();
+        return size > 0 ? static_cast<size_t>(size) : 0;
+    }
 
-            bufferMut_.lock();
-            auto buffer = std::move(buffer_);
-            bufferMut_.unlock();
+    /**
+     * 等锁、持锁的耗时分布：独占锁是Emplace的缓冲区锁和合并、删除时的链表锁，
+     * 共享锁是ForEach遍历期间持有的链表锁。StatsPolicy未启用时为空
+     */
+    StatsSnapshot Stats() const {
+        return stats_.Stats();
+    }
 
-            for (const auto& v : buffer) {
-                list_.emplace_back(v);
-            }
+    void ForEach(const std::function<void (const Type&)>& func) {
+        {
+            auto guard = StatsLock<std::lock_guard<SharedMutex>>(stats_, listMut_);
+
+            std::lock_guard<Mutex> bufferGuard(bufferMut_);
+            list_.splice(list_.end(), buffer_);
         }
 
-        std::shared_lock<std::shared_timed_mutex> lock(listMut_);
+        auto lock = StatsSharedLock<std::shared_lock<SharedMutex>>(stats_, listMut_);
         for (const auto& v : list_) {
             func(v);
         }
     }
 
+    /**
+     * 按块并行遍历：持共享锁走一遍链表定出块边界，块分给executor的工作线程和
+     * 调用线程。走链表本身是串行的，并行的是func的开销。func会被并发调用
+     */
+    template<typename Func>
+    void ParallelForEach(Executor& executor, Func&& func) {
+        WithChunks([&](const std::vector<Iterator>& bounds) {
+            executor.ParallelFor(0, bounds.size() - 1, 1, [&](size_t first, size_t last, size_t) {
+                for (auto it = bounds[first]; it != bounds[last]; ++it)
+                    func(*it);
+            });
+        });
+    }
+
+    /**
+     * 并行遍历并归约：visit(partial, value)累加到所在线程的部分结果，
+     * combine(result, partial)合并各部分结果，见Executor::ParallelReduce
+     */
+    template<typename T, typename Visit, typename Combine>
+    T ParallelForEach(Executor& executor, T identity, Visit&& visit, Combine&& combine) {
+        return WithChunks([&](const std::vector<Iterator>& bounds) {
+            return executor.ParallelReduce(0, bounds.size() - 1, 1, std::move(identity),
+                [&](T& partial, size_t first, size_t last) {
+                    for (auto it = bounds[first]; it != bounds[last]; ++it)
+                        visit(partial, *it);
+                }, combine);
+        });
+    }
+
     int ForEachRemove(const std::function<bool (const Type&)>& func) {
         int count = 0;
-        std::lock_guard<std::shared_timed_mutex> guard(listMut_);
+        auto guard = StatsLock<std::lock_guard<SharedMutex>>(stats_, listMut_);
 
         for (auto it = list_.begin(); it != list_.end(); ) {
             if (func(*it))
@@ -78,20 +150,50 @@ public:
         auto buffer = std::move(buffer_);
         bufferMut_.unlock();
 
-        for (const auto& v : buffer) {
-            if (func(v))
-                list_.emplace_back(v);
+        for (auto it = buffer.begin(); it != buffer.end(); ) {
+            auto next = std::next(it);
+            if (func(*it))
+                list_.splice(list_.end(), buffer, it);
             else
                 ++count;
+            it = next;
         }
+        size_.Add(-count);
         return count;
     }
 
 private:
-    std::shared_timed_mutex listMut_;
+    using Iterator = typename std::list<Type>::const_iterator;
+
+    // 每块的元素个数
+    static constexpr size_t kChunk = 1024;
+
+    // 合并缓冲区后持共享锁，把链表每kChunk个元素的边界交给body
+    template<typename Body>
+    auto WithChunks(Body&& body) {
+        {
+            auto guard = StatsLock<std::lock_guard<SharedMutex>>(stats_, listMut_);
+
+            std::lock_guard<Mutex> bufferGuard(bufferMut_);
+            list_.splice(list_.end(), buffer_);
+        }
+
+        auto lock = StatsSharedLock<std::shared_lock<SharedMutex>>(stats_, listMut_);
+        std::vector<Iterator> bounds{list_.cbegin()};
+        for (auto it = list_.cbegin(); it != list_.cend();) {
+            for (size_t i = 0; i < kChunk && it != list_.cend(); ++i)
+                ++it;
+            bounds.push_back(it);
+        }
+        return body(bounds);
+    }
+
+    SharedMutex listMut_;
     std::list<Type> list_;
-    std::mutex bufferMut_;
+    Mutex bufferMut_;
     std::list<Type> buffer_;
+    StripedCounter size_;
+    StatsPolicy stats_;
 };
 
 }
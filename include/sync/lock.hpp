@@ -0,0 +1,392 @@
+/**
+ * @file lock.hpp
+ * @brief Lock family for the sync containers. All types meet the standard
+ * Lockable requirements, so they work with std::lock_guard / std::unique_lock.
+ *   - SpinLock: test-and-test-and-set with exponential backoff.
+ *   - TicketLock: FIFO spinlock, fair under contention.
+ *   - McsLock: queue lock, each waiter spins on its own cache line.
+ *   - AdaptiveMutex: spins briefly, then parks the thread (futex on Linux).
+ *   - SharedSpinLock: writer-preferring reader/writer spinlock.
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_LOCK_HPP_
+#define _JULIET_SYNC_LOCK_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <atomic>
+#include <cstdint>
+#include <thread>
+
+#if defined(__linux__)
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#endif
+
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <intrin.h>
+#endif
+
+namespace juliet::sync {
+
+inline void CpuRelax() {
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  _mm_pause();
+#elif defined(__aarch64__) || defined(__arm__)
+  asm volatile("yield");
+#endif
+}
+
+/**
+ * Exponential backoff. Spins 1, 2, 4 ... pause instructions, then yields the
+ * CPU so an oversubscribed lock holder can make progress.
+ */
+class Backoff {
+ public:
+  void Pause() {
+    if (step_ <= kSpinSteps) {
+      for (uint32_t i = 0; i < (1u << step_); ++i) {
+        CpuRelax();
+      }
+      ++step_;
+    } else {
+      std::this_thread::yield();
+    }
+  }
+
+  bool Spinning() const { return step_ <= kSpinSteps; }
+
+ private:
+  static constexpr uint32_t kSpinSteps = 6;
+  uint32_t step_ = 0;
+};
+
+namespace lock_detail {
+
+static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t),
+              "futex needs a plain 32-bit word");
+
+// Sleep while *addr == expected. May return spuriously.
+inline void FutexWait(std::atomic<uint32_t> *addr, uint32_t expected) {
+#if defined(__linux__)
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAIT_PRIVATE,
+          expected, nullptr, nullptr, 0);
+#else
+  if (addr->load(std::memory_order_relaxed) == expected) {
+    std::this_thread::yield();
+  }
+#endif
+}
+
+inline void FutexWake(std::atomic<uint32_t> *addr, int count) {
+#if defined(__linux__)
+  syscall(SYS_futex, reinterpret_cast<uint32_t *>(addr), FUTEX_WAKE_PRIVATE,
+          count, nullptr, nullptr, 0);
+#else
+  (void)addr;
+  (void)count;
+#endif
+}
+
+}  // namespace lock_detail
+
+class SpinLock {
+ public:
+  SpinLock() = default;
+  SpinLock(const SpinLock &) = delete;
+  SpinLock &operator=(const SpinLock &) = delete;
+
+  void lock() {
+    for (;;) {
+      if (!locked_.exchange(true, std::memory_order_acquire)) {
+        return;
+      }
+      // Spin on a plain load so waiters share the cache line read-only.
+      Backoff backoff;
+      while (locked_.load(std::memory_order_relaxed)) {
+        backoff.Pause();
+      }
+    }
+  }
+
+  bool try_lock() {
+    return !locked_.load(std::memory_order_relaxed) &&
+           !locked_.exchange(true, std::memory_order_acquire);
+  }
+
+  void unlock() { locked_.store(false, std::memory_order_release); }
+
+ private:
+  std::atomic<bool> locked_{false};
+};
+
+class TicketLock {
+ public:
+  TicketLock() = default;
+  TicketLock(const TicketLock &) = delete;
+  TicketLock &operator=(const TicketLock &) = delete;
+
+  void lock() {
+    auto ticket = next_.fetch_add(1, std::memory_order_relaxed);
+    Backoff backoff;
+    while (serving_.load(std::memory_order_acquire) != ticket) {
+      backoff.Pause();
+    }
+  }
+
+  bool try_lock() {
+    auto serving = serving_.load(std::memory_order_relaxed);
+    auto expected = serving;
+    return next_.compare_exchange_strong(expected, serving + 1,
+                                         std::memory_order_acquire,
+                                         std::memory_order_relaxed);
+  }
+
+  void unlock() {
+    // Only the holder writes serving_.
+    serving_.store(serving_.load(std::memory_order_relaxed) + 1,
+                   std::memory_order_release);
+  }
+
+ private:
+  std::atomic<uint32_t> next_{0};
+  std::atomic<uint32_t> serving_{0};
+};
+
+/**
+ * Mellor-Crummey/Scott queue lock. Queue nodes come from a per-thread pool,
+ * so the lock keeps the plain lock()/unlock() interface; the holder's node
+ * is remembered in the lock itself.
+ */
+class McsLock {
+ public:
+  McsLock() = default;
+  McsLock(const McsLock &) = delete;
+  McsLock &operator=(const McsLock &) = delete;
+
+  void lock() {
+    Node *node = AcquireNode();
+    Node *prev = tail_.exchange(node, std::memory_order_acq_rel);
+    if (prev != nullptr) {
+      prev->next.store(node, std::memory_order_release);
+      Backoff backoff;
+      while (node->locked.load(std::memory_order_acquire)) {
+        backoff.Pause();
+      }
+    }
+    holder_ = node;
+  }
+
+  bool try_lock() {
+    Node *node = AcquireNode();
+    Node *expected = nullptr;
+    if (tail_.compare_exchange_strong(expected, node,
+                                      std::memory_order_acquire,
+                                      std::memory_order_relaxed)) {
+      holder_ = node;
+      return true;
+    }
+    ReleaseNode(node);
+    return false;
+  }
+
+  void unlock() {
+    Node *node = holder_;
+    Node *next = node->next.load(std::memory_order_acquire);
+    if (next == nullptr) {
+      Node *expected = node;
+      if (tail_.compare_exchange_strong(expected, nullptr,
+                                        std::memory_order_release,
+                                        std::memory_order_relaxed)) {
+        ReleaseNode(node);
+        return;
+      }
+      // A successor swapped tail_ but has not linked itself yet.
+      Backoff backoff;
+      while ((next = node->next.load(std::memory_order_acquire)) == nullptr) {
+        backoff.Pause();
+      }
+    }
+    next->locked.store(false, std::memory_order_release);
+    ReleaseNode(node);
+  }
+
+ private:
+  struct alignas(64) Node {
+    std::atomic<Node *> next{nullptr};
+    std::atomic<bool> locked{false};
+    Node *free_next = nullptr;
+  };
+
+  struct NodePool {
+    Node *head = nullptr;
+
+    ~NodePool() {
+      while (head != nullptr) {
+        Node *next = head->free_next;
+        delete head;
+        head = next;
+      }
+    }
+  };
+
+  static NodePool &Pool() {
+    thread_local NodePool pool;
+    return pool;
+  }
+
+  static Node *AcquireNode() {
+    auto &pool = Pool();
+    Node *node = pool.head;
+    if (node != nullptr) {
+      pool.head = node->free_next;
+    } else {
+      node = new Node;
+    }
+    node->next.store(nullptr, std::memory_order_relaxed);
+    node->locked.store(true, std::memory_order_relaxed);
+    return node;
+  }
+
+  static void ReleaseNode(Node *node) {
+    auto &pool = Pool();
+    node->free_next = pool.head;
+    pool.head = node;
+  }
+
+  std::atomic<Node *> tail_{nullptr};
+  // Written and read only by the current holder.
+  Node *holder_ = nullptr;
+};
+
+/**
+ * Spin-then-park mutex (Drepper's three-state futex mutex with a spin phase).
+ * 0: unlocked, 1: locked, 2: locked and there may be parked waiters.
+ */
+class AdaptiveMutex {
+ public:
+  AdaptiveMutex() = default;
+  AdaptiveMutex(const AdaptiveMutex &) = delete;
+  AdaptiveMutex &operator=(const AdaptiveMutex &) = delete;
+
+  void lock() {
+    uint32_t state = kUnlocked;
+    if (state_.compare_exchange_strong(state, kLocked,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+      return;
+    }
+
+    for (int i = 0; i < kSpinCount && state != kParked; ++i) {
+      CpuRelax();
+      state = kUnlocked;
+      if (state_.compare_exchange_weak(state, kLocked,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+        return;
+      }
+    }
+
+    if (state != kParked) {
+      state = state_.exchange(kParked, std::memory_order_acquire);
+    }
+    while (state != kUnlocked) {
+      lock_detail::FutexWait(&state_, kParked);
+      state = state_.exchange(kParked, std::memory_order_acquire);
+    }
+  }
+
+  bool try_lock() {
+    uint32_t state = kUnlocked;
+    return state_.compare_exchange_strong(state, kLocked,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed);
+  }
+
+  void unlock() {
+    if (state_.exchange(kUnlocked, std::memory_order_release) == kParked) {
+      lock_detail::FutexWake(&state_, 1);
+    }
+  }
+
+ private:
+  static constexpr uint32_t kUnlocked = 0;
+  static constexpr uint32_t kLocked = 1;
+  static constexpr uint32_t kParked = 2;
+  static constexpr int kSpinCount = 100;
+
+  std::atomic<uint32_t> state_{kUnlocked};
+};
+
+/**
+ * Writer-preferring reader/writer spinlock. A waiting writer blocks new
+ * readers, so writers are not starved by a steady stream of readers.
+ */
+class SharedSpinLock {
+ public:
+  SharedSpinLock() = default;
+  SharedSpinLock(const SharedSpinLock &) = delete;
+  SharedSpinLock &operator=(const SharedSpinLock &) = delete;
+
+  void lock() {
+    Backoff backoff;
+    for (;;) {
+      auto state = state_.load(std::memory_order_relaxed);
+      if ((state & ~kWriterPending) == 0) {
+        if (state_.compare_exchange_weak(state, kWriter,
+                                         std::memory_order_acquire,
+                                         std::memory_order_relaxed)) {
+          return;
+        }
+      } else if ((state & kWriterPending) == 0) {
+        state_.fetch_or(kWriterPending, std::memory_order_relaxed);
+      }
+      backoff.Pause();
+    }
+  }
+
+  bool try_lock() {
+    uint32_t state = 0;
+    return state_.compare_exchange_strong(state, kWriter,
+                                          std::memory_order_acquire,
+                                          std::memory_order_relaxed);
+  }
+
+  void unlock() { state_.fetch_and(~kWriter, std::memory_order_release); }
+
+  void lock_shared() {
+    Backoff backoff;
+    while (!try_lock_shared()) {
+      backoff.Pause();
+    }
+  }
+
+  bool try_lock_shared() {
+    auto state = state_.load(std::memory_order_relaxed);
+    return (state & (kWriter | kWriterPending)) == 0 &&
+           state_.compare_exchange_weak(state, state + 1,
+                                        std::memory_order_acquire,
+                                        std::memory_order_relaxed);
+  }
+
+  void unlock_shared() { state_.fetch_sub(1, std::memory_order_release); }
+
+ private:
+  static constexpr uint32_t kWriter = 1u << 31;
+  static constexpr uint32_t kWriterPending = 1u << 30;
+
+  // Low bits count readers.
+  std::atomic<uint32_t> state_{0};
+};
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_LOCK_HPP_
@@ -0,0 +1,56 @@
+/**
+ * @file lock_policy.hpp
+ * @brief Lock policies for the sync containers.
+ * A policy names three lock types:
+ *   - Mutex: exclusive lock around container-wide state (e.g. Map::mu_).
+ *   - SharedMutex: reader/writer lock around whole tables.
+ *   - EntryMutex: per-element lock with tiny critical sections
+ *     (e.g. map::Entry swapping its value pointer).
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_LOCK_POLICY_HPP_
+#define _JULIET_SYNC_LOCK_POLICY_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <mutex>
+#include <shared_mutex>
+
+#include "lock.hpp"
+#include "parking_lot.hpp"
+
+namespace juliet::sync {
+
+template <typename MutexT, typename SharedMutexT = std::shared_timed_mutex,
+          typename EntryMutexT = MutexT>
+struct LockPolicy {
+  using Mutex = MutexT;
+  using SharedMutex = SharedMutexT;
+  using EntryMutex = EntryMutexT;
+};
+
+// What every container used before lock policies existed.
+using StdLockPolicy = LockPolicy<std::mutex, std::shared_timed_mutex>;
+
+using SpinLockPolicy = LockPolicy<SpinLock, SharedSpinLock>;
+
+using TicketLockPolicy = LockPolicy<TicketLock>;
+
+using McsLockPolicy = LockPolicy<McsLock>;
+
+// Park on long waits for the container lock, spin on the entry lock.
+using AdaptiveLockPolicy = LockPolicy<AdaptiveMutex, std::shared_timed_mutex,
+                                      SpinLock>;
+
+// One-byte parking-lot locks. map::Entry packs its lock into the state byte.
+using CompactLockPolicy = LockPolicy<ByteLock, std::shared_timed_mutex,
+                                     ByteLock>;
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_LOCK_POLICY_HPP_
@@ -14,28 +14,152 @@
 #pragma once
 #endif /* __GNUC__ >= 3.4 || _MSC_VER */
 
+#include <algorithm>
 #include <atomic>
+#include <cassert>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
 #include <functional>
+#include <iterator>
 #include <memory>
+#include <mutex>
 #include <shared_mutex>
+#include <string>
+#include <type_traits>
 #include <unordered_map>
 #include <utility>
+#include <vector>
+
+#include "bloom_filter.hpp"
+#include "bulk_load.hpp"
+#include "drain.hpp"
+#include "executor.hpp"
+#include "hot_keys.hpp"
+#include "intrusive.hpp"
+#include "lock_policy.hpp"
+#include "node_table.hpp"
+#include "parking_lot.hpp"
+#include "promotion_policy.hpp"
+#include "snapshot.hpp"
+#include "stats_policy.hpp"
+#include "striped_counter.hpp"
+#include "transparent_hash.hpp"
 
 namespace juliet::sync {
 namespace map {
 
+enum EState : uint8_t { kNull, kValue, kExpunged };
+
+/**
+ * An entry's state word plus the lock guarding its value pointer.
+ * Lockable itself, so Entry can use std::lock_guard on it.
+ */
+template <typename Mutex>
+class EntrySync {
+ public:
+  explicit EntrySync(EState state) : state_(state) {}
+
+  EState Load() const { return state_.load(); }
+
+  bool CompareExchange(EState &expected, EState desired) {
+    return state_.compare_exchange_strong(expected, desired);
+  }
+
+  void Store(EState state) { state_.store(state); }
+
+  void lock() { mu_.lock(); }
+
+  void unlock() { mu_.unlock(); }
+
+ private:
+  std::atomic<EState> state_;
+  Mutex mu_;
+};
+
+/**
+ * With ByteLock the lock is packed into two spare bits of the state byte and
+ * parks through the ParkingLot, so the whole sync part of an entry is 1 byte.
+ * State updates preserve the lock bits and vice versa.
+ */
+template <>
+class EntrySync<ByteLock> {
+ public:
+  explicit EntrySync(EState state) : word_(state) {}
+
+  EState Load() const { return static_cast<EState>(word_.load() & kStateMask); }
+
+  bool CompareExchange(EState &expected, EState desired) {
+    auto word = word_.load();
+    for (;;) {
+      if ((word & kStateMask) != expected) {
+        expected = static_cast<EState>(word & kStateMask);
+        return false;
+      }
+      if (word_.compare_exchange_weak(word, (word & ~kStateMask) | desired)) {
+        return true;
+      }
+    }
+  }
+
+  void Store(EState state) {
+    auto word = word_.load();
+    while (!word_.compare_exchange_weak(word, (word & ~kStateMask) | state)) {
+    }
+  }
+
+  void lock() { Bits::Lock(word_); }
+
+  void unlock() { Bits::Unlock(word_); }
+
+ private:
+  static constexpr uint8_t kStateMask = 0x3;
+  using Bits = BitLock<uint8_t, 0x4, 0x8>;
+
+  std::atomic<uint8_t> word_;
+};
+
+/**
+ * Values stored inline in the entry instead of behind a shared_ptr.
+ */
 template <typename Value>
-class Entry {
+constexpr bool kInlineValue = std::is_trivially_copyable_v<Value> &&
+                              std::is_default_constructible_v<Value> &&
+                              sizeof(Value) <= 16;
+
+/**
+ * A key's value slot. Entries are reference counted and owned by the map's
+ * tables (see Node below). The first value is constructed inside the entry
+ * itself; values stored later are boxed on the heap, while the embedded one
+ * stays alive until the entry dies, since readers may still reference it.
+ */
+template <typename Value, typename Mutex = std::mutex,
+          bool kInline = kInlineValue<Value>>
+class Entry : public RefCounted {
  public:
-  using Ptr = std::shared_ptr<Value>;
-  enum EState { kNull, kValue, kExpunged };
+  using Ptr = ValueRef<Value>;
+  using ConstPtr = ValueRef<const Value>;
+  using Sync = EntrySync<Mutex>;
+
+  // Transitions to and from kValue are made while holding the lock, so ptr_
+  // is non-null iff the state is kValue whenever the lock is held.
+  // kNull -> kExpunged is the only transition made without it (by the map
+  // under its own lock).
+
+  explicit Entry(Ptr ptr)
+      : sync_(ptr != nullptr ? kValue : kNull), ptr_(std::move(ptr)) {}
 
-  explicit Entry(Ptr ptr) : ptr_(std::move(ptr)) {
-    state_ = (ptr_ != nullptr) ? kValue : kNull;
+  // Construct the first value in place from factory().
+  template <typename Factory>
+  Entry(std::in_place_t, Factory &&factory) : sync_(kValue) {
+    ptr_ = Ptr::Borrowed(embedded_.Construct(factory));
   }
 
-  static std::shared_ptr<Entry> NewEntry(const Value &val) {
-    return std::make_shared<Entry>(std::make_shared<Value>(val));
+  // Box factory() on the heap.
+  template <typename Factory>
+  static Ptr MakePtr(Factory &&factory) {
+    return HeapValue<Value>::Make(std::forward<Factory>(factory));
   }
 
   struct LoadResult {
@@ -44,37 +168,47 @@ class Entry {
   };
 
   LoadResult Load() const {
-    auto state = state_.load();
+    auto state = sync_.Load();
     if (state == kNull || state == kExpunged) {
       return {nullptr, false};
     }
-    std::lock_guard<std::mutex> guard(mu_);
-    return {ptr_, true};
+    std::lock_guard<Sync> guard(sync_);
+    if (ptr_ == nullptr) {
+      return {nullptr, false};
+    }
+    return {SharePtr(), true};
   }
 
-  bool TryStore(const Value &val) {
-    auto cur_state = state_.load();
+  /**
+   * @return the state before the store. kExpunged means nothing was stored.
+   */
+  EState TryStore(Ptr ptr) {
+    assert(ptr != nullptr);
+    if (sync_.Load() == kExpunged) {
+      return kExpunged;
+    }
+    std::lock_guard<Sync> guard(sync_);
+    auto cur_state = sync_.Load();
     for (;;) {
       if (cur_state == kExpunged) {
-        return false;
+        return kExpunged;
       }
-      if (state_.compare_exchange_strong(cur_state, kValue)) {
-        std::lock_guard<std::mutex> guard(mu_);
-        ptr_ = std::make_shared<Value>(val);
-        return true;
+      auto prev_state = cur_state;
+      if (sync_.CompareExchange(cur_state, kValue)) {
+        ptr_.swap(ptr);
+        return prev_state;
       }
     }
   }
 
-  void StoreLocked(const Value &val) {
-    auto cur_state = state_.load();
-    for (;;) {
-      if (state_.compare_exchange_strong(cur_state, kValue)) {
-        std::lock_guard<std::mutex> guard(mu_);
-        ptr_ = std::make_shared<Value>(val);
-        break;
-      }
-    }
+  // @return the state before the store.
+  EState StoreLocked(Ptr ptr) {
+    assert(ptr != nullptr);
+    std::lock_guard<Sync> guard(sync_);
+    auto prev_state = sync_.Load();
+    sync_.Store(kValue);
+    ptr_.swap(ptr);
+    return prev_state;
   }
 
   struct TryLoadOrStoreResult {
@@ -85,61 +219,97 @@ class Entry {
 
   /**
    * TryLoadOrStore
-   * @param val
-   * @return Value, loaded, Ok
+   * @param make returns the Ptr to store. Only invoked if the entry is empty,
+   * and at most once per call. It may return null to store nothing.
+   * @return Value, loaded, Ok; not ok if expunged or make returned null
    */
-  TryLoadOrStoreResult TryLoadOrStore(const Value &val) {
-    auto cur_state = state_.load();
+  template <typename Maker>
+  TryLoadOrStoreResult TryLoadOrStore(Maker &&make) {
+    auto cur_state = sync_.Load();
+    if (cur_state == kExpunged) {
+      return {nullptr, false, false};
+    }
+
+    std::lock_guard<Sync> guard(sync_);
+    cur_state = sync_.Load();
     if (cur_state == kExpunged) {
       return {nullptr, false, false};
     }
-    if (cur_state != kNull) {
-      std::lock_guard<std::mutex> guard(mu_);
-      return {ptr_, true, true};
+    if (cur_state == kValue) {
+      return {SharePtr(), true, true};
     }
 
-    for (;;) {
-      assert(cur_state == kNull);
-      if (state_.compare_exchange_strong(cur_state, kValue)) {
-        std::lock_guard<std::mutex> guard(mu_);
-        ptr_ = std::make_shared<Value>(val);
-        return {ptr_, false, true};
-      }
-      if (cur_state == kExpunged) {
-        return {nullptr, false, false};
-      }
-      if (cur_state != kNull) {
-        std::lock_guard<std::mutex> guard(mu_);
-        return {ptr_, true, true};
-      }
+    assert(cur_state == kNull);
+    Ptr ptr = make();
+    if (ptr == nullptr) {
+      return {nullptr, false, false};
+    }
+    // Only kNull -> kExpunged can race with us here.
+    if (!sync_.CompareExchange(cur_state, kValue)) {
+      assert(cur_state == kExpunged);
+      return {nullptr, false, false};
+    }
+    ptr_ = std::move(ptr);
+    return {SharePtr(), false, true};
+  }
+
+  /**
+   * Clear the value and return the pointer as held: one borrowed from the
+   * embedded value is only valid while the entry is. Null if there was none.
+   */
+  Ptr Detach() {
+    if (sync_.Load() != kValue) {
+      return nullptr;
+    }
+    Ptr ptr;
+    std::lock_guard<Sync> guard(sync_);
+    auto cur_state = kValue;
+    if (sync_.CompareExchange(cur_state, kNull)) {
+      ptr.swap(ptr_);
     }
+    return ptr;
   }
 
   bool Delete(Value *val) {
-    auto cur_state = state_.load();
-    for (;;) {
-      if (cur_state == kNull || cur_state == kExpunged) {
-        return false;
-      }
-      if (state_.compare_exchange_strong(cur_state, kNull)) {
-        Ptr ptr;
-        {
-          std::lock_guard<std::mutex> guard(mu_);
-          ptr.swap(ptr_);
-        }
-        assert(ptr != nullptr);
-        if (val != nullptr) {
+    auto ptr = Detach();
+    if (ptr == nullptr) {
+      return false;
+    }
+    if (val != nullptr) {
+      // Readers may still hold the value; only steal it when nobody can.
+      if constexpr (std::is_copy_assignable_v<Value>) {
+        if (ptr.owner() != nullptr && ptr.owner()->RefCount() == 1) {
           *val = std::move(*ptr);
+        } else {
+          *val = *ptr;
         }
-        return true;
+      } else {
+        *val = std::move(*ptr);
       }
     }
+    return true;
+  }
+
+  /**
+   * Replace the value with ptr if the current value equals old.
+   * Requires Value to be equality comparable.
+   */
+  bool TryCompareAndSwap(const Value &old, Ptr ptr) {
+    if (sync_.Load() != kValue) {
+      return false;
+    }
+    std::lock_guard<Sync> guard(sync_);
+    if (ptr_ == nullptr || !(*ptr_ == old)) {
+      return false;
+    }
+    ptr_.swap(ptr);
+    return true;
   }
 
   bool TryExpungeLocked() {
-    auto cur_state = state_.load();
+    auto cur_state = sync_.Load();
     while (cur_state == kNull) {
-      if (state_.compare_exchange_strong(cur_state, kExpunged)) {
+      if (sync_.CompareExchange(cur_state, kExpunged)) {
         return true;
       }
     }
@@ -148,277 +318,944 @@ class Entry {
 
   bool UnexpungeLocked() {
     auto expunged = kExpunged;
-    if (state_.compare_exchange_strong(expunged, kNull)) {
-      std::lock_guard<std::mutex> guard(mu_);
-      ptr_ = nullptr;
-      return true;
-    }
-    return false;
+    return sync_.CompareExchange(expunged, kNull);
   }
 
  private:
+  // A borrowed ptr_ points at embedded_; hand it out owned by the entry.
+  // Call with the lock held.
+  Ptr SharePtr() const {
+    if (ptr_.owner() != nullptr) {
+      return ptr_;
+    }
+    return Ptr(ptr_.get(), this);
+  }
+
+  // First, so a one-byte Sync fits next to the reference count.
+  mutable Sync sync_;
   Ptr ptr_;
-  std::atomic<EState> state_{kNull};
-  mutable std::mutex mu_;
+  EmbeddedValue<Value> embedded_;
 };
 
-template <typename Key, typename Value>
-struct ReadOnly {
-  using InnerMap = std::unordered_map<Key, std::shared_ptr<Entry<Value>>>;
-  std::shared_ptr<InnerMap> m;
-  bool amended;
+/**
+ * Pointer-like holder for an inline value, so inline entries keep the same
+ * interface as shared_ptr-based ones without allocating.
+ */
+template <typename Value>
+class InlinePtr {
+ public:
+  InlinePtr() = default;
 
-  ReadOnly() : m(std::make_shared<InnerMap>()), amended(false) {}
+  InlinePtr(std::nullptr_t) {}
 
-  explicit ReadOnly(std::shared_ptr<InnerMap> _m)
-      : m(std::move(_m)), amended(false) {}
-};
+  explicit InlinePtr(const Value &value) : value_(value), valid_(true) {}
 
-template <typename Key, typename Value>
-struct Read {
-  // There's no feature for std::atomic<struct T> in C++11,
-  // so only can implement it with rwlock.
-  // The performance will slightly inferior to golang/sync.Map.
-  mutable std::shared_timed_mutex mu;
-  ReadOnly<Key, Value> readOnly;
+  const Value &operator*() const { return value_; }
 
-  ReadOnly<Key, Value> Load() const {
-    std::shared_lock<std::shared_timed_mutex> lock(mu);
-    return readOnly;
+  const Value *operator->() const { return &value_; }
+
+  explicit operator bool() const { return valid_; }
+
+  friend bool operator==(const InlinePtr &p, std::nullptr_t) {
+    return !p.valid_;
   }
 
-  void Store(ReadOnly<Key, Value> ro) {
-    std::lock_guard<std::shared_timed_mutex> guard(mu);
-    readOnly = std::move(ro);
+  friend bool operator!=(const InlinePtr &p, std::nullptr_t) {
+    return p.valid_;
   }
+
+ private:
+  Value value_{};
+  bool valid_ = false;
 };
 
 /**
- * Read cached map.
- * Modify cache table only on cache missed or read cache oversize.
- * Other times, use read-only map.
- * @tparam Key
- * @tparam Value
+ * The (state, value) pair of an inline entry, updated as one unit.
+ * Values up to 4 bytes share one 64-bit word with the state and are updated
+ * by a single CAS, so every operation is lock-free. Larger values (up to 16
+ * bytes) use a seqlock: readers never block, writers are serialized by a
+ * short spin on the sequence word. Neither path allocates.
  */
-template <typename Key, typename Value>
-class Map {
+template <typename Value, bool kPacked = (sizeof(Value) <= 4)>
+class InlineCell;
+
+template <typename Value>
+struct InlineSnapshot {
+  EState state = kNull;
+  Value value{};
+};
+
+template <typename Value>
+class InlineCell<Value, true> {
  public:
-  using RawMap = std::unordered_map<Key, Value>;
-  using ValueEntry = Entry<Value>;
-  using EntryPtr = std::shared_ptr<ValueEntry>;
-  using InnerMap = std::unordered_map<Key, EntryPtr>;
+  using Snapshot = InlineSnapshot<Value>;
 
-  void Store(const Key &key, const Value &value) {
-    auto read = read_.Load();
-    auto it = read.m->find(key);
-    if (it != read.m->end()) {
-      auto entry = it->second;
-      assert(entry != nullptr);
-      if (entry->TryStore(value)) {
-        return;
-      }
-    }
+  explicit InlineCell(const Snapshot &snap) : word_(Pack(snap)) {}
 
-    std::lock_guard<std::mutex> guard(mu_);
-    read = read_.Load();
-    it = read.m->find(key);
-    if (it != read.m->end()) {
-      auto entry = it->second;
-      assert(entry != nullptr);
-      if (entry->UnexpungeLocked()) {
-        assert(dirty_ != nullptr);
-        (*dirty_)[key] = entry;
-      }
-      entry->StoreLocked(value);
-    } else if (dirty_ != nullptr && (it = dirty_->find(key)) != dirty_->end()) {
-      auto entry = it->second;
-      assert(entry != nullptr);
-      entry->StoreLocked(value);
-    } else {
-      if (!read.amended) {
-        DirtyLocked();
-        read_.readOnly.amended = true;
-      }
-      assert(dirty_ != nullptr);
-      (*dirty_)[key] = ValueEntry::NewEntry(value);
+  Snapshot Load() const { return Unpack(word_.load(std::memory_order_acquire)); }
+
+  bool CompareExchange(Snapshot &expected, const Snapshot &desired) {
+    auto word = Pack(expected);
+    if (word_.compare_exchange_strong(word, Pack(desired),
+                                      std::memory_order_acq_rel,
+                                      std::memory_order_acquire)) {
+      return true;
     }
+    expected = Unpack(word);
+    return false;
   }
 
-  Value Load(const Key &key) {
-    Value result{};
-    Get(key, &result);
-    return result;
+ private:
+  static uint64_t Pack(const Snapshot &snap) {
+    uint32_t bits = 0;
+    std::memcpy(&bits, &snap.value, sizeof(Value));
+    return (static_cast<uint64_t>(snap.state) << 32) | bits;
   }
 
-  bool Load(const Key &key, Value *value) {
-    EntryPtr entry;
-    auto read = read_.Load();
-    auto it = read.m->find(key);
-    if (it != read.m->end()) {
-      entry = it->second;
-    } else if (read.amended) {
-      std::lock_guard<std::mutex> guard(mu_);
-      read = read_.Load();
-      it = read.m->find(key);
-      if (it != read.m->end()) {
-        entry = it->second;
-      } else if (read.amended) {
-        it = dirty_->find(key);
-        if (it != dirty_->end()) {
-          entry = it->second;
-        }
-        MissLocked();
+  static Snapshot Unpack(uint64_t word) {
+    Snapshot snap;
+    snap.state = static_cast<EState>(word >> 32);
+    auto bits = static_cast<uint32_t>(word);
+    std::memcpy(&snap.value, &bits, sizeof(Value));
+    return snap;
+  }
+
+  std::atomic<uint64_t> word_;
+};
+
+template <typename Value>
+class InlineCell<Value, false> {
+ public:
+  using Snapshot = InlineSnapshot<Value>;
+
+  explicit InlineCell(const Snapshot &snap) { Write(snap); }
+
+  Snapshot Load() const {
+    for (;;) {
+      auto seq = seq_.load(std::memory_order_acquire);
+      if ((seq & 1) != 0) {
+        CpuRelax();
+        continue;
       }
-    }
-    if (entry) {
-      auto load_result = entry->Load();
-      if (load_result.loaded) {
-        assert(load_result.value != nullptr);
-        assert(value != nullptr);
-        *value = *load_result.value;
-        return true;
+      auto snap = Read();
+      std::atomic_thread_fence(std::memory_order_acquire);
+      if (seq_.load(std::memory_order_relaxed) == seq) {
+        return snap;
       }
     }
-    return false;
   }
 
-  /**
-   * Get value if key exists, or put a new key value.
-   * @param key
-   * @param value
-   * @param actual returns the value if key exists.
-   * @return true if the value was loaded, false if store.
-   */
-  bool LoadOrStore(const Key &key, const Value &value, Value *actual) {
-    auto read = read_.Load();
-    auto it = read.m->find(key);
-    if (it != read.m->end()) {
-      auto entry = it->second;
-      assert(entry != nullptr);
-      auto try_result = entry->TryLoadOrStore(value);
-      if (try_result.ok) {
-        assert(actual != nullptr);
-        *actual = *try_result.actual;
-        return try_result.loaded;
-      }
+  bool CompareExchange(Snapshot &expected, const Snapshot &desired) {
+    auto seq = seq_.load(std::memory_order_relaxed);
+    Backoff backoff;
+    while ((seq & 1) != 0 ||
+           !seq_.compare_exchange_weak(seq, seq + 1, std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+      backoff.Pause();
+      seq = seq_.load(std::memory_order_relaxed);
     }
+    std::atomic_thread_fence(std::memory_order_release);
 
-    std::lock_guard<std::mutex> guard(mu_);
-    read = read_.Load();
-    it = read.m->find(key);
-    if (it != read.m->end()) {
-      auto entry = it->second;
-      assert(entry != nullptr);
-      if (entry->UnexpungeLocked()) {
-        assert(dirty_ != nullptr);
-        (*dirty_)[key] = entry;
-      }
-      auto try_result = entry->TryLoadOrStore(value);
-      assert(actual != nullptr);
-      *actual = *try_result.actual;
-      return try_result.loaded;
-    } else if (dirty_ != nullptr && (it = dirty_->find(key)) != dirty_->end()) {
-      auto entry = it->second;
-      assert(entry != nullptr);
-      auto try_result = entry->TryLoadOrStore(value);
-      MissLocked();
-      assert(actual != nullptr);
-      *actual = *try_result.actual;
-      return try_result.loaded;
+    auto current = Read();
+    if (!Equal(current, expected)) {
+      // Nothing written, so readers that started before us stay valid.
+      seq_.store(seq, std::memory_order_release);
+      expected = current;
+      return false;
     }
+    Write(desired);
+    seq_.store(seq + 2, std::memory_order_release);
+    return true;
+  }
 
-    if (!read.amended) {
-      DirtyLocked();
-      read_.readOnly.amended = true;
-    }
-    assert(dirty_ != nullptr);
-    (*dirty_)[key] = ValueEntry::NewEntry(value);
-    assert(actual != nullptr);
-    *actual = value;
-    return false;
+ private:
+  static constexpr size_t kWords = (sizeof(Value) + 7) / 8;
+
+  static bool Equal(const Snapshot &a, const Snapshot &b) {
+    return a.state == b.state &&
+           std::memcmp(&a.value, &b.value, sizeof(Value)) == 0;
   }
 
-  void Delete(const Key &key) { Delete(key, nullptr); }
+  Snapshot Read() const {
+    Snapshot snap;
+    snap.state = static_cast<EState>(state_.load(std::memory_order_relaxed));
+    uint64_t words[kWords];
+    for (size_t i = 0; i < kWords; ++i) {
+      words[i] = words_[i].load(std::memory_order_relaxed);
+    }
+    std::memcpy(&snap.value, words, sizeof(Value));
+    return snap;
+  }
 
-  bool Delete(const Key &key, Value *value) {
-    EntryPtr entry;
-    auto read = read_.Load();
-    auto it = read.m->find(key);
-    if (it != read.m->end()) {
-      entry = it->second;
-    } else if (read.amended) {
-      std::lock_guard<std::mutex> guard(mu_);
-      read = read_.Load();
-      it = read.m->find(key);
-      if (it != read.m->end()) {
-        entry = it->second;
-      } else if (read.amended) {
-        it = dirty_->find(key);
-        if (it != dirty_->end()) {
-          entry = it->second;
-          dirty_->erase(it);
-        }
-        MissLocked();
-      }
+  void Write(const Snapshot &snap) {
+    state_.store(snap.state, std::memory_order_relaxed);
+    uint64_t words[kWords] = {};
+    std::memcpy(words, &snap.value, sizeof(Value));
+    for (size_t i = 0; i < kWords; ++i) {
+      words_[i].store(words[i], std::memory_order_relaxed);
     }
-    return entry != nullptr && entry->Delete(value);
   }
 
-  void Reset() { Reset(nullptr); }
+  std::atomic<uint32_t> seq_{0};
+  std::atomic<uint8_t> state_{kNull};
+  std::atomic<uint64_t> words_[kWords];
+};
 
-  void Reset(RawMap *raw) {
-    ReadOnly<Key, Value> read;
-    {
-      std::lock_guard<std::mutex> guard(mu_);
-      read = read_.Load();
-      if (read.amended) {
-        read = ReadOnly<Key, Value>{std::move(dirty_)};
+/**
+ * Entry for small trivially-copyable values, stored inline in an InlineCell.
+ * Load, Store, CompareAndSwap and Delete neither allocate nor take a lock
+ * (beyond the seqlock for values over 4 bytes). Mutex is unused.
+ */
+template <typename Value, typename Mutex>
+class Entry<Value, Mutex, true> : public RefCounted {
+ public:
+  using Ptr = InlinePtr<Value>;
+  using ConstPtr = InlinePtr<Value>;
+  using Snapshot = InlineSnapshot<Value>;
+
+  explicit Entry(Ptr ptr) : cell_(ptr != nullptr ? Snapshot{kValue, *ptr}
+                                                 : Snapshot{}) {}
+
+  template <typename Factory>
+  Entry(std::in_place_t, Factory &&factory)
+      : cell_(Snapshot{kValue, Value(factory())}) {}
+
+  template <typename Factory>
+  static Ptr MakePtr(Factory &&factory) {
+    return Ptr(Value(factory()));
+  }
+
+  struct LoadResult {
+    Ptr value;
+    bool loaded = false;
+  };
+
+  LoadResult Load() const {
+    auto snap = cell_.Load();
+    if (snap.state != kValue) {
+      return {nullptr, false};
+    }
+    return {Ptr(snap.value), true};
+  }
+
+  EState TryStore(const Ptr &ptr) {
+    assert(ptr != nullptr);
+    auto snap = cell_.Load();
+    for (;;) {
+      if (snap.state == kExpunged) {
+        return kExpunged;
+      }
+      auto prev_state = snap.state;
+      if (cell_.CompareExchange(snap, Snapshot{kValue, *ptr})) {
+        return prev_state;
       }
-      read_.Store(ReadOnly<Key, Value>{});
-      dirty_ = nullptr;
-      misses_ = 0;
     }
+  }
 
-    if (raw != nullptr) {
-      assert(read.m != nullptr);
-      for (const auto &kv : *read.m) {
-        auto entry = kv.second;
-        assert(entry != nullptr);
-        auto loaded = entry->Load();
-        if (loaded.loaded) {
-          raw->emplace(kv.first, *(loaded.value));
-        }
+  EState StoreLocked(const Ptr &ptr) {
+    assert(ptr != nullptr);
+    auto snap = cell_.Load();
+    for (;;) {
+      auto prev_state = snap.state;
+      if (cell_.CompareExchange(snap, Snapshot{kValue, *ptr})) {
+        return prev_state;
       }
     }
   }
 
-  using Enumerator = std::function<bool(const Key &key, const Value &value)>;
+  struct TryLoadOrStoreResult {
+    Ptr actual;
+    bool loaded = false;
+    bool ok = false;
+  };
 
-  void Range(const Enumerator &enumerator) {
-    if (!enumerator) {
-      return;
+  template <typename Maker>
+  TryLoadOrStoreResult TryLoadOrStore(Maker &&make) {
+    auto snap = cell_.Load();
+    Ptr ptr;
+    for (;;) {
+      if (snap.state == kExpunged) {
+        return {nullptr, false, false};
+      }
+      if (snap.state == kValue) {
+        return {Ptr(snap.value), true, true};
+      }
+      if (ptr == nullptr) {
+        ptr = make();
+        assert(ptr != nullptr);
+      }
+      if (cell_.CompareExchange(snap, Snapshot{kValue, *ptr})) {
+        return {ptr, false, true};
+      }
     }
+  }
 
-    auto read = read_.Load();
-    if (read.amended) {
-      std::lock_guard<std::mutex> guard(mu_);
-      read = read_.Load();
-      if (read.amended) {
-        read = ReadOnly<Key, Value>{std::move(dirty_)};
-        read_.Store(read);
-        dirty_ = nullptr;
-        misses_ = 0;
+  Ptr Detach() {
+    auto snap = cell_.Load();
+    for (;;) {
+      if (snap.state != kValue) {
+        return nullptr;
+      }
+      auto deleted = snap.value;
+      if (cell_.CompareExchange(snap, Snapshot{})) {
+        return Ptr(deleted);
       }
     }
+  }
 
-    assert(read.m != nullptr);
-    for (const auto &kv : *read.m) {
-      auto entry = kv.second;
-      assert(entry != nullptr);
-      auto load = entry->Load();
-      if (load.loaded && !enumerator(kv.first, *(load.value))) {
-        break;
-      }
+  bool Delete(Value *val) {
+    auto ptr = Detach();
+    if (ptr == nullptr) {
+      return false;
+    }
+    if (val != nullptr) {
+      *val = *ptr;
+    }
+    return true;
+  }
+
+  bool TryCompareAndSwap(const Value &old, const Ptr &ptr) {
+    auto snap = cell_.Load();
+    for (;;) {
+      if (snap.state != kValue || !(snap.value == old)) {
+        return false;
+      }
+      if (cell_.CompareExchange(snap, Snapshot{kValue, *ptr})) {
+        return true;
+      }
+    }
+  }
+
+  bool TryExpungeLocked() {
+    auto snap = cell_.Load();
+    while (snap.state == kNull) {
+      if (cell_.CompareExchange(snap, Snapshot{kExpunged, Value{}})) {
+        return true;
+      }
+    }
+    return snap.state == kExpunged;
+  }
+
+  bool UnexpungeLocked() {
+    auto snap = cell_.Load();
+    while (snap.state == kExpunged) {
+      if (cell_.CompareExchange(snap, Snapshot{})) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+ private:
+  InlineCell<Value> cell_;
+};
+
+/**
+ * An entry together with its key: one allocation per key, shared by the read
+ * and dirty tables through intrusive references.
+ */
+template <typename Key, typename EntryT>
+class Node final : public EntryT {
+ public:
+  using KeyType = Key;
+
+  template <typename... Args>
+  explicit Node(const Key &key, Args &&...args)
+      : EntryT(std::forward<Args>(args)...), key_(key) {}
+
+  const Key &key() const { return key_; }
+
+ private:
+  const Key key_;
+};
+
+/**
+ * A table that is, or will be promoted to, a read snapshot. While the snapshot
+ * is amended, every key inserted into dirty but absent from the table is also
+ * added to filter, so a key the filter rejects is a definite miss.
+ */
+template <typename NodeT, typename Hash = std::hash<typename NodeT::KeyType>,
+          typename KeyEqual = std::equal_to<typename NodeT::KeyType>>
+struct SnapshotTable : NodeTable<NodeT, Hash, KeyEqual> {
+  BloomFilter<typename NodeT::KeyType, Hash> filter;
+};
+
+template <typename Key, typename Value, typename LockPolicy = StdLockPolicy,
+          typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+struct ReadOnly {
+  using InnerMap =
+      SnapshotTable<Node<Key, Entry<Value, typename LockPolicy::EntryMutex>>,
+                    Hash, KeyEqual>;
+  std::shared_ptr<InnerMap> m;
+  bool amended;
+
+  ReadOnly() : m(std::make_shared<InnerMap>()), amended(false) {}
+
+  explicit ReadOnly(std::shared_ptr<InnerMap> _m)
+      : m(std::move(_m)), amended(false) {}
+};
+
+template <typename Key, typename Value, typename LockPolicy = StdLockPolicy,
+          typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+struct Read {
+  using SharedMutex = typename LockPolicy::SharedMutex;
+  using ReadOnlyMap = ReadOnly<Key, Value, LockPolicy, Hash, KeyEqual>;
+  // There's no feature for std::atomic<struct T> in C++11,
+  // so only can implement it with rwlock.
+  // The performance will slightly inferior to golang/sync.Map.
+  mutable SharedMutex mu;
+  ReadOnlyMap readOnly;
+
+  ReadOnlyMap Load() const {
+    std::shared_lock<SharedMutex> lock(mu);
+    return readOnly;
+  }
+
+  void Store(ReadOnlyMap ro) {
+    std::lock_guard<SharedMutex> guard(mu);
+    readOnly = std::move(ro);
+  }
+};
+
+/**
+ * The keys of a Map at the time Map::Snapshot was called: its read snapshot
+ * plus the nodes only dirty held then. Both tables are immutable, so a view
+ * can be used and copied from any thread while writers carry on. The key set
+ * is fixed; a key's value is the one it holds when read, as in Map::Range,
+ * and a key deleted since reads as absent, even if it was stored again.
+ */
+template <typename Key, typename Value, typename LockPolicy = StdLockPolicy,
+          typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class View {
+ public:
+  using InnerMap =
+      typename ReadOnly<Key, Value, LockPolicy, Hash, KeyEqual>::InnerMap;
+  using Enumerator = std::function<bool(const Key &key, const Value &value)>;
+
+  View(std::shared_ptr<const InnerMap> read,
+       std::shared_ptr<const InnerMap> fresh)
+      : read_(std::move(read)), fresh_(std::move(fresh)) {}
+
+  Value Load(const Key &key) const {
+    Value result{};
+    Load(key, &result);
+    return result;
+  }
+
+  bool Load(const Key &key, Value *value) const { return LoadAs(key, value); }
+
+  // Load by a K equal to a Key; see transparent_hash.hpp.
+  template <typename K, typename = EnableHeterogeneous<K, Key, Hash, KeyEqual>>
+  bool Load(const K &key, Value *value) const {
+    return LoadAs(key, value);
+  }
+
+  void Range(const Enumerator &enumerator) const {
+    if (!enumerator) {
+      return;
+    }
+    if (!RangeIn(*read_, enumerator) || fresh_ == nullptr) {
+      return;
+    }
+    RangeIn(*fresh_, enumerator);
+  }
+
+  // Keys in the view, including any deleted since it was taken.
+  size_t KeyCount() const {
+    return read_->Size() + (fresh_ != nullptr ? fresh_->Size() : 0);
+  }
+
+ private:
+  template <typename K>
+  bool LoadAs(const K &key, Value *value) const {
+    auto *entry = read_->Find(key);
+    if (entry == nullptr && fresh_ != nullptr) {
+      entry = fresh_->Find(key);
+    }
+    if (entry == nullptr) {
+      return false;
+    }
+    auto load = entry->Load();
+    if (load.loaded) {
+      assert(value != nullptr);
+      *value = *load.value;
+    }
+    return load.loaded;
+  }
+
+  // @return false if enumerator stopped the walk.
+  static bool RangeIn(const InnerMap &table, const Enumerator &enumerator) {
+    for (auto *entry : table) {
+      auto load = entry->Load();
+      if (load.loaded && !enumerator(entry->key(), *(load.value))) {
+        return false;
+      }
+    }
+    return true;
+  }
+
+  std::shared_ptr<const InnerMap> read_;
+  // Keys stored since read_ was promoted; null if there were none.
+  std::shared_ptr<const InnerMap> fresh_;
+};
+
+/**
+ * Read cached map.
+ * Modify cache table only on cache missed or read cache oversize.
+ * Other times, use read-only map.
+ * @tparam Key
+ * @tparam Value
+ * @tparam LockPolicy see lock_policy.hpp. Mutex guards dirty_, SharedMutex
+ * guards the read snapshot, EntryMutex guards each entry's value pointer.
+ * @tparam PromotionPolicy see promotion_policy.hpp. Decides when dirty_
+ * becomes the read snapshot.
+ * @tparam StatsPolicy see stats_policy.hpp.
+ * @tparam Hash
+ * @tparam KeyEqual when both are transparent, Load also takes other key types
+ * (see transparent_hash.hpp), e.g. std::string_view for std::string keys
+ * with StringHash and std::equal_to<>.
+ */
+template <typename Key, typename Value, typename LockPolicy = StdLockPolicy,
+          typename PromotionPolicy = AdaptivePromotion,
+          typename StatsPolicy = NoStats, typename Hash = std::hash<Key>,
+          typename KeyEqual = std::equal_to<Key>>
+class Map {
+ public:
+  using RawMap = std::unordered_map<Key, Value, Hash, KeyEqual>;
+  using Mutex = typename LockPolicy::Mutex;
+  using ValueEntry = Entry<Value, typename LockPolicy::EntryMutex>;
+  using EntryNode = Node<Key, ValueEntry>;
+  using EntryPtr = IntrusivePtr<EntryNode>;
+  using ReadOnlyMap = ReadOnly<Key, Value, LockPolicy, Hash, KeyEqual>;
+  using InnerMap = typename ReadOnlyMap::InnerMap;
+  using SnapshotView = View<Key, Value, LockPolicy, Hash, KeyEqual>;
+
+  using ValuePtr = typename ValueEntry::ConstPtr;
+
+  Map() = default;
+
+  // Bulk-load [first, last); see BulkLoad.
+  template <typename ForwardIt>
+  Map(ForwardIt first, ForwardIt last) {
+    BulkLoad(first, last);
+  }
+
+  explicit Map(RawMap &&raw) { BulkLoad(std::move(raw)); }
+
+  void Store(const Key &key, const Value &value) {
+    StoreWith(key, [&value]() -> Value { return value; });
+  }
+
+  void Store(const Key &key, Value &&value) {
+    StoreWith(key, [&value]() -> Value { return std::move(value); });
+  }
+
+  /**
+   * Construct a value in place from args and store it, overwriting any
+   * existing value.
+   */
+  template <typename... Args>
+  void Emplace(const Key &key, Args &&...args) {
+    StoreWith(key, [&]() -> Value { return Value(std::forward<Args>(args)...); });
+  }
+
+  Value Load(const Key &key) {
+    Value result{};
+    Load(key, &result);
+    return result;
+  }
+
+  bool Load(const Key &key, Value *value) { return LoadAs(key, value); }
+
+  /**
+   * Load by a K equal to a Key, such as a std::string_view for std::string
+   * keys, without converting it to Key. Only with a transparent Hash and
+   * KeyEqual; see transparent_hash.hpp.
+   */
+  template <typename K, typename = EnableHeterogeneous<K, Key, Hash, KeyEqual>>
+  Value Load(const K &key) {
+    Value result{};
+    LoadAs(key, &result);
+    return result;
+  }
+
+  template <typename K, typename = EnableHeterogeneous<K, Key, Hash, KeyEqual>>
+  bool Load(const K &key, Value *value) {
+    return LoadAs(key, value);
+  }
+
+  /**
+   * Get value if key exists, or put a new key value.
+   * @param key
+   * @param value
+   * @param actual returns the value if key exists.
+   * @return true if the value was loaded, false if store.
+   */
+  bool LoadOrStore(const Key &key, const Value &value, Value *actual) {
+    auto result = LoadOrStoreWith(key, [&value]() -> Value { return value; });
+    assert(actual != nullptr);
+    *actual = *result.actual;
+    return result.loaded;
+  }
+
+  bool LoadOrStore(const Key &key, Value &&value, Value *actual) {
+    auto result = LoadOrStoreWith(
+        key, [&value]() -> Value { return std::move(value); });
+    assert(actual != nullptr);
+    *actual = *result.actual;
+    return result.loaded;
+  }
+
+  /**
+   * Construct a value in place from args only if key does not exist.
+   * Works for values that are neither default-constructible nor copyable.
+   * @return the value now associated with key, and true if it was inserted.
+   */
+  template <typename... Args>
+  std::pair<ValuePtr, bool> TryEmplace(const Key &key, Args &&...args) {
+    auto result = LoadOrStoreWith(key, [&]() -> Value {
+      return Value(std::forward<Args>(args)...);
+    });
+    return {std::move(result.actual), !result.loaded};
+  }
+
+  /**
+   * Get value if key exists, or compute and store a new one.
+   * Unlike LoadOrStore, the value is only built when the key is absent:
+   * factory is invoked at most once per call, without the map lock held, so
+   * it may be slow or use the map itself. If another thread inserts key
+   * while factory runs, that value wins and factory's result is dropped.
+   * If factory throws, nothing is stored and the exception propagates.
+   * @param factory callable returning something Value is constructible from.
+   * @return the value associated with key (shared rather than copied, unless
+   * it is a small inline value), and true if it was computed and inserted,
+   * as TryEmplace reports.
+   */
+  template <typename Factory>
+  std::pair<ValuePtr, bool> LoadOrCompute(const Key &key, Factory &&factory) {
+    auto result = LoadOrStoreWith(
+        key, [&factory]() -> Value { return Value(factory()); });
+    return {std::move(result.actual), !result.loaded};
+  }
+
+  /**
+   * Swap in new_value if key is present and its value equals old_value.
+   * Requires Value to be equality comparable.
+   * @return true if swapped.
+   */
+  bool CompareAndSwap(const Key &key, const Value &old_value,
+                      const Value &new_value) {
+    auto hot = Tracker::Write(hot_.get(), key);
+    auto make = [&new_value]() -> Value { return new_value; };
+    auto read = read_.Load();
+    if (auto *entry = read.m->Find(key)) {
+      stats_.Count(kFastPath);
+      return entry->TryCompareAndSwap(old_value, ValueEntry::MakePtr(make));
+    } else if (!MayBeDirty(read, key)) {
+      stats_.Count(kFastPath);
+      return false;
+    }
+
+    stats_.Count(kSlowPath);
+    auto started = MissStarted();
+    auto guard = StatsLock<std::lock_guard<Mutex>>(stats_, mu_);
+    read = read_.Load();
+    if (auto *entry = read.m->Find(key)) {
+      return entry->TryCompareAndSwap(old_value, ValueEntry::MakePtr(make));
+    } else if (dirty_ != nullptr) {
+      if (auto *dirty_entry = dirty_->Find(key)) {
+        auto swapped = dirty_entry->TryCompareAndSwap(
+            old_value, ValueEntry::MakePtr(make));
+        MissLocked(started);
+        return swapped;
+      }
+    }
+    return false;
+  }
+
+  void Delete(const Key &key) { Delete(key, nullptr); }
+
+  bool Delete(const Key &key, Value *value) {
+    auto hot = Tracker::Write(hot_.get(), key);
+    EntryPtr pinned;
+    EntryNode *entry;
+    auto read = read_.Load();
+    entry = read.m->Find(key);
+    if (entry == nullptr && MayBeDirty(read, key)) {
+      stats_.Count(kSlowPath);
+      auto started = MissStarted();
+      auto guard = StatsLock<std::lock_guard<Mutex>>(stats_, mu_);
+      read = read_.Load();
+      entry = read.m->Find(key);
+      if (entry == nullptr && read.amended) {
+        pinned = dirty_->Erase(key);
+        entry = pinned.get();
+        MissLocked(started);
+      }
+    } else {
+      stats_.Count(kFastPath);
+    }
+    if (entry == nullptr || !entry->Delete(value)) {
+      return false;
+    }
+    size_.Decrement();
+    return true;
+  }
+
+  /**
+   * Number of keys with a value. O(cores), and approximate while other
+   * threads are storing or deleting.
+   */
+  size_t Size() const {
+    auto size = size_.Sum();
+    return size > 0 ? static_cast<size_t>(size) : 0;
+  }
+
+  /**
+   * Promotion counters since construction; Reset does not clear them.
+   */
+  PromotionStats Promotions() const {
+    auto guard = StatsLock<std::lock_guard<Mutex>>(stats_, mu_);
+    return promotion_stats_;
+  }
+
+  /**
+   * Operations served from the read snapshot (kFastPath) or under mu_
+   * (kSlowPath), promotions, dirty rebuilds and their time, and the wait
+   * for and hold of mu_. Empty unless StatsPolicy is enabled.
+   */
+  StatsSnapshot Stats() const { return stats_.Stats(); }
+
+  /**
+   * Sample reads to find the hottest keys and serve them from replicas,
+   * bypassing the read snapshot's lock and the entry; see hot_keys.hpp.
+   * Call before the map is shared between threads.
+   */
+  void TrackHotKeys(const HotKeyOptions &options = HotKeyOptions()) {
+    hot_ = std::make_unique<Tracker>(options);
+  }
+
+  // The keys TrackHotKeys found hot, hottest first.
+  std::vector<HotKey<Key>> HotKeys() const {
+    return hot_ != nullptr ? hot_->Top() : std::vector<HotKey<Key>>();
+  }
+
+  void Reset() { Drain(); }
+
+  // Empty the map, moving its contents into raw; see Drain.
+  void Reset(RawMap *raw) {
+    auto drained = Drain();
+    if (raw != nullptr) {
+      raw->reserve(raw->size() + drained.Size());
+      drained.ForEach([raw](const Key &key, Value &&value) {
+        raw->emplace(key, std::move(value));
+      });
+    }
+  }
+
+  /**
+   * Empty the map and return what it held, to be consumed at the caller's
+   * pace: values are moved out one by one as the handle is iterated, and
+   * nodes freed as they go. Only swaps tables under mu_. Stores racing with
+   * the drain may land in the drained contents.
+   */
+  Drained<Value, InnerMap> Drain() {
+    auto hot = Tracker::WriteAll(hot_.get());
+    std::shared_ptr<InnerMap> table;
+    // Released after the lock.
+    ReadOnlyMap read;
+    {
+      auto guard = StatsLock<std::lock_guard<Mutex>>(stats_, mu_);
+      read = read_.Load();
+      table = read.amended ? std::move(dirty_) : read.m;
+      read_.Store(ReadOnlyMap{});
+      dirty_ = nullptr;
+      fresh_.clear();
+      misses_ = 0;
+      inserts_ = 0;
+      size_.Reset();
+    }
+    return Drained<Value, InnerMap>(std::move(table));
+  }
+
+  using Enumerator = std::function<bool(const Key &key, const Value &value)>;
+
+  void Range(const Enumerator &enumerator) {
+    if (!enumerator) {
+      return;
+    }
+
+    auto read = PromotedSnapshot();
+    assert(read.m != nullptr);
+    for (auto *entry : *read.m) {
+      auto load = entry->Load();
+      if (load.loaded && !enumerator(entry->key(), *(load.value))) {
+        break;
+      }
+    }
+  }
+
+  /**
+   * A view of the keys present now, for lookups and Range. Unlike Range it
+   * leaves the map as it is: nothing is promoted, so the writes that follow
+   * do not have to rebuild dirty. O(1) unless keys were added since the last
+   * promotion; then those keys are indexed for the view, under mu_ only for
+   * copying their nodes.
+   */
+  SnapshotView Snapshot() const {
+    auto read = read_.Load();
+    if (!read.amended) {
+      return SnapshotView(std::move(read.m), nullptr);
+    }
+    std::vector<EntryPtr> fresh;
+    {
+      auto guard = StatsLock<std::lock_guard<Mutex>>(stats_, mu_);
+      read = read_.Load();
+      if (read.amended) {
+        fresh.assign(fresh_.begin(), fresh_.end());
+      }
+    }
+    if (fresh.empty()) {
+      return SnapshotView(std::move(read.m), nullptr);
+    }
+    auto table = std::make_shared<InnerMap>();
+    table->Reserve(fresh.size());
+    // Newest first, so a key stored again after Delete maps to its live node.
+    for (auto it = fresh.rbegin(); it != fresh.rend(); ++it) {
+      table->Insert(std::move(*it));
+    }
+    return SnapshotView(std::move(read.m), std::move(table));
+  }
+
+  /**
+   * Range with the snapshot's slots split across executor's workers and the
+   * caller. visitor(key, value) runs concurrently with itself; once it
+   * returns false, pieces not yet started are skipped.
+   */
+  template <typename Visitor>
+  void ParallelRange(Executor &executor, Visitor &&visitor) {
+    auto read = PromotedSnapshot();
+    std::atomic<bool> stopped{false};
+    executor.ParallelFor(
+        0, read.m->SlotCount(), 0, [&](size_t first, size_t last, size_t) {
+          if (stopped.load(std::memory_order_relaxed)) {
+            return;
+          }
+          read.m->ForEachIn(first, last, [&](EntryNode *entry) {
+            auto load = entry->Load();
+            if (load.loaded && !stopped.load(std::memory_order_relaxed) &&
+                !visitor(entry->key(), *(load.value))) {
+              stopped.store(true, std::memory_order_relaxed);
+            }
+          });
+        });
+  }
+
+  /**
+   * Aggregate over a parallel Range: visit(partial, key, value) folds an
+   * entry into its worker's partial result, combine(result, partial) folds
+   * the partials together. See Executor::ParallelReduce.
+   */
+  template <typename T, typename Visit, typename Combine>
+  T ParallelRange(Executor &executor, T identity, Visit &&visit,
+                  Combine &&combine) {
+    auto read = PromotedSnapshot();
+    return executor.ParallelReduce(
+        0, read.m->SlotCount(), 0, std::move(identity),
+        [&](T &partial, size_t first, size_t last) {
+          read.m->ForEachIn(first, last, [&](EntryNode *entry) {
+            auto load = entry->Load();
+            if (load.loaded) {
+              visit(partial, entry->key(), *(load.value));
+            }
+          });
+        },
+        combine);
+  }
+
+  /**
+   * Write every key with a value to path (see snapshot.hpp), replacing the
+   * file only once it is complete. Like Range, the snapshot is the promoted
+   * read table: each value is the one current when its entry is visited,
+   * and writers are never blocked.
+   * @return false on I/O error.
+   */
+  bool SaveSnapshot(const std::string &path) {
+    SnapshotWriter<Key, Value> writer;
+    if (!writer.Open(path)) {
+      return false;
+    }
+    auto read = PromotedSnapshot();
+    for (auto *entry : *read.m) {
+      auto load = entry->Load();
+      if (load.loaded) {
+        writer.Write(entry->key(), *load.value);
+      }
+    }
+    return writer.Commit();
+  }
+
+  /**
+   * Replace the contents with a snapshot written by SaveSnapshot. The table
+   * is sized once and built from the mapped file without locking, then
+   * published as the read snapshot, so every key is lock-free from the start.
+   * @return false, leaving the map untouched, if the file is missing,
+   * truncated or of other types.
+   */
+  bool LoadSnapshot(const std::string &path) {
+    SnapshotReader<Key, Value> reader;
+    if (!reader.Open(path)) {
+      return false;
+    }
+    auto table = std::make_shared<InnerMap>();
+    table->Reserve(reader.Count());
+    auto loaded = reader.ForEach([&table](Key &&key, Value &&value) {
+      table->Insert(EntryPtr(new EntryNode(
+          key, std::in_place, [&value]() -> Value { return std::move(value); })));
+    });
+    if (!loaded) {
+      return false;
+    }
+    ReplaceWith(std::move(table));
+    return true;
+  }
+
+  /**
+   * Replace the contents with the key/value pairs of [first, last); of
+   * equal keys the last wins. Nodes are built on several threads for large
+   * inputs and indexed into a table sized once, which is published as the
+   * read snapshot: no Store, no dirty map, no promotion.
+   */
+  template <typename ForwardIt>
+  void BulkLoad(ForwardIt first, ForwardIt last) {
+    auto table = std::make_shared<InnerMap>();
+    bulk::Fill(table.get(), first, last, [](auto &&kv) {
+      return EntryPtr(new EntryNode(kv.first, std::in_place, [&kv]() -> Value {
+        return std::forward<decltype(kv)>(kv).second;
+      }));
+    });
+    ReplaceWith(std::move(table));
+  }
+
+  // BulkLoad moving the values out of raw, which is left empty.
+  void BulkLoad(RawMap &&raw) {
+    BulkLoad(std::make_move_iterator(raw.begin()),
+             std::make_move_iterator(raw.end()));
+    raw.clear();
+  }
+
+  /**
+   * Size the dirty map for n keys when it is next rebuilt from the read
+   * snapshot (or now, if it exists), so a burst of new keys does not rehash.
+   */
+  void Reserve(size_t n) {
+    auto guard = StatsLock<std::lock_guard<Mutex>>(stats_, mu_);
+    reserve_ = n;
+    if (dirty_) {
+      dirty_->Reserve(n);
     }
   }
 
@@ -430,39 +1267,359 @@ class Map {
   //  }
 
  private:
-  void MissLocked() {
+  using EntryValuePtr = typename ValueEntry::Ptr;
+
+  /**
+   * Builds a key's value at most once, wherever it ends up: boxed for an
+   * existing entry, or inside the node when the key is new.
+   * @tparam Factory returns a Value prvalue.
+   */
+  template <typename Factory>
+  class ValueMaker {
+   public:
+    explicit ValueMaker(Factory &factory) : factory_(factory) {}
+
+    // The value may be built on the fast path and then rejected because the
+    // entry was expunged. Keep it so the slow path never builds a second one.
+    EntryValuePtr operator()() {
+      if (made_ == nullptr) {
+        made_ = node_ != nullptr ? node_->Load().value
+                                 : ValueEntry::MakePtr(factory_);
+      }
+      return made_;
+    }
+
+    bool Built() const { return made_ != nullptr || node_ != nullptr; }
+
+    // Build the node for key ahead of the insert, outside mu_.
+    void Build(const Key &key) {
+      if (!Built()) {
+        node_ = NewNode(key);
+      }
+    }
+
+    EntryPtr NewNode(const Key &key) {
+      if (node_ != nullptr) {
+        return std::move(node_);
+      }
+      if (made_ != nullptr) {
+        return EntryPtr(new EntryNode(key, std::move(made_)));
+      }
+      return EntryPtr(new EntryNode(key, std::in_place, factory_));
+    }
+
+   private:
+    Factory &factory_;
+    EntryValuePtr made_;
+    EntryPtr node_;
+  };
+
+  using Tracker = HotKeyTracker<Key, Value, Hash, KeyEqual, Mutex>;
+
+  // The body of Load, for Key and heterogeneous keys alike.
+  template <typename K>
+  bool LoadAs(const K &key, Value *value) {
+    if (hot_ != nullptr) {
+      return hot_->Load(key, value, [this](const K &k, Value *v) {
+        return LoadFromTables(k, v);
+      });
+    }
+    return LoadFromTables(key, value);
+  }
+
+  template <typename K>
+  bool LoadFromTables(const K &key, Value *value) {
+    // Nodes found in a read snapshot live as long as the snapshot; a node
+    // found in dirty_ must be pinned before mu_ is released.
+    EntryPtr pinned;
+    EntryNode *entry;
+    auto read = read_.Load();
+    entry = read.m->Find(key);
+    if (entry == nullptr && MayBeDirty(read, key)) {
+      stats_.Count(kSlowPath);
+      auto started = MissStarted();
+      auto guard = StatsLock<std::lock_guard<Mutex>>(stats_, mu_);
+      read = read_.Load();
+      entry = read.m->Find(key);
+      if (entry == nullptr && read.amended) {
+        pinned = EntryPtr(dirty_->Find(key));
+        entry = pinned.get();
+        MissLocked(started);
+      }
+    } else {
+      stats_.Count(kFastPath);
+    }
+    if (entry != nullptr) {
+      auto load_result = entry->Load();
+      if (load_result.loaded) {
+        assert(load_result.value != nullptr);
+        assert(value != nullptr);
+        *value = *load_result.value;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  template <typename Factory>
+  void StoreWith(const Key &key, Factory &&factory) {
+    auto hot = Tracker::Write(hot_.get(), key);
+    ValueMaker<Factory> make(factory);
+    auto read = read_.Load();
+    if (auto *entry = read.m->Find(key)) {
+      auto prev_state = entry->TryStore(make());
+      if (prev_state != kExpunged) {
+        CountStore(prev_state);
+        stats_.Count(kFastPath);
+        return;
+      }
+    }
+
+    stats_.Count(kSlowPath);
+    auto guard = StatsLock<std::lock_guard<Mutex>>(stats_, mu_);
+    read = read_.Load();
+    if (auto *entry = read.m->Find(key)) {
+      if (entry->UnexpungeLocked()) {
+        assert(dirty_ != nullptr);
+        dirty_->Insert(EntryPtr(entry));
+      }
+      CountStore(entry->StoreLocked(make()));
+    } else if (dirty_ != nullptr &&
+               (entry = dirty_->Find(key)) != nullptr) {
+      CountStore(entry->StoreLocked(make()));
+    } else {
+      InsertDirtyLocked(read, make.NewNode(key));
+      size_.Increment();
+    }
+  }
+
+  void CountStore(EState prev_state) {
+    if (prev_state != kValue) {
+      size_.Increment();
+    }
+  }
+
+  struct LoadOrStoreResult {
+    EntryValuePtr actual;
+    bool loaded = false;
+  };
+
+  /**
+   * Shared body of LoadOrStore and friends.
+   * @param factory returns a new Value. Invoked at most once, only when the
+   * key is absent, and never with mu_ held: a new key is looked up under
+   * mu_, built after releasing it and inserted under it again. If another
+   * thread inserts the key meanwhile, the value built here is dropped.
+   */
+  template <typename Factory>
+  LoadOrStoreResult LoadOrStoreWith(const Key &key, Factory &&factory) {
+    ValueMaker<Factory> make(factory);
+    auto read = read_.Load();
+    if (auto *entry = read.m->Find(key)) {
+      auto try_result = entry->TryLoadOrStore(make);
+      if (try_result.ok) {
+        CountLoadOrStore(try_result.loaded);
+        stats_.Count(kFastPath);
+        return {std::move(try_result.actual), try_result.loaded};
+      }
+    } else if (!MayBeDirty(read, key)) {
+      // A definite miss: build now rather than after a first trip into mu_.
+      make.Build(key);
+    }
+
+    stats_.Count(kSlowPath);
+    auto started = MissStarted();
+    // Under mu_, only a value built beforehand is stored.
+    auto built = [&make]() {
+      return make.Built() ? make() : EntryValuePtr();
+    };
+    bool missed = false;
+    for (;;) {
+      {
+        auto guard = StatsLock<std::lock_guard<Mutex>>(stats_, mu_);
+        read = read_.Load();
+        if (auto *entry = read.m->Find(key)) {
+          if (entry->UnexpungeLocked()) {
+            assert(dirty_ != nullptr);
+            dirty_->Insert(EntryPtr(entry));
+          }
+          auto try_result = entry->TryLoadOrStore(built);
+          if (try_result.ok) {
+            CountLoadOrStore(try_result.loaded);
+            return {std::move(try_result.actual), try_result.loaded};
+          }
+        } else if (dirty_ != nullptr &&
+                   (entry = dirty_->Find(key)) != nullptr) {
+          auto try_result = entry->TryLoadOrStore(built);
+          if (!missed) {
+            // A retry is the same miss; count it once.
+            MissLocked(started);
+            missed = true;
+          }
+          if (try_result.ok) {
+            CountLoadOrStore(try_result.loaded);
+            return {std::move(try_result.actual), try_result.loaded};
+          }
+        } else if (make.Built()) {
+          auto *entry = InsertDirtyLocked(read, make.NewNode(key));
+          size_.Increment();
+          return {entry->Load().value, false};
+        }
+        // Entries are not expunged while mu_ is held: not ok means empty.
+        assert(!make.Built());
+      }
+      make.Build(key);
+    }
+  }
+
+  void CountLoadOrStore(bool loaded) {
+    if (!loaded) {
+      size_.Increment();
+    }
+  }
+
+  // The read snapshot, after promoting dirty_ into it if it was amended.
+  // Publish table as the whole contents.
+  void ReplaceWith(std::shared_ptr<InnerMap> table) {
+    auto hot = Tracker::WriteAll(hot_.get());
+    auto size = static_cast<int64_t>(table->Size());
+    // Released after the lock.
+    ReadOnlyMap old;
+    std::shared_ptr<InnerMap> old_dirty;
+    auto guard = StatsLock<std::lock_guard<Mutex>>(stats_, mu_);
+    old = read_.Load();
+    old_dirty = std::move(dirty_);
+    fresh_.clear();
+    read_.Store(ReadOnlyMap{std::move(table)});
+    misses_ = 0;
+    inserts_ = 0;
+    size_.Reset();
+    size_.Add(size);
+  }
+
+  ReadOnlyMap PromotedSnapshot() {
+    auto read = read_.Load();
+    if (read.amended) {
+      auto guard = StatsLock<std::lock_guard<Mutex>>(stats_, mu_);
+      read = read_.Load();
+      if (read.amended) {
+        auto ctx = PromotionContextLocked();
+        read = ReadOnlyMap{std::move(dirty_)};
+        read_.Store(read);
+        PromotedLocked(ctx);
+      }
+    }
+    return read;
+  }
+
+  // False only if key is in neither the snapshot read came from nor dirty_.
+  template <typename K>
+  static bool MayBeDirty(const ReadOnlyMap &read, const K &key) {
+    return read.amended && read.m->filter.MayContain(key);
+  }
+
+  // Insert a node whose key is in neither table. Call with mu_ held.
+  EntryNode *InsertDirtyLocked(ReadOnlyMap &read, EntryPtr node) {
+    if (!read.amended) {
+      DirtyLocked();
+      fresh_.clear();
+      read.amended = true;
+      read_.Store(read);
+    }
+    ++inserts_;
+    assert(dirty_ != nullptr);
+    // Before the insert, so a reader that can see the key in dirty_ can also
+    // see it in the filter.
+    read.m->filter.Add(node->key());
+    fresh_.push_back(node);
+    return dirty_->Insert(std::move(node)).first;
+  }
+
+  // The start of a slow path, for one call in kMissSampleRate per thread.
+  static PromotionClock::time_point MissStarted() {
+    thread_local unsigned calls = 0;
+    if (++calls % kMissSampleRate != 0) {
+      return {};
+    }
+    return PromotionClock::now();
+  }
+
+  void MissLocked(PromotionClock::time_point started) {
     ++misses_;
+    ++promotion_stats_.misses;
+    if (started != PromotionClock::time_point{}) {
+      promotion_.OnMissSample(PromotionClock::now() - started);
+    }
     assert(dirty_ != nullptr);
-    if (misses_ < static_cast<int>(dirty_->size())) {
+    auto ctx = PromotionContextLocked();
+    if (!promotion_.ShouldPromote(ctx)) {
       return;
     }
 
-    read_.Store(ReadOnly<Key, Value>{std::move(dirty_)});
+    read_.Store(ReadOnlyMap{std::move(dirty_)});
+    PromotedLocked(ctx);
+  }
+
+  PromotionContext PromotionContextLocked() const {
+    return {misses_, dirty_->Size(), inserts_, amended_since_};
+  }
+
+  // Call right after dirty_ was moved into the read snapshot.
+  void PromotedLocked(const PromotionContext &ctx) {
+    ++promotion_stats_.promotions;
+    stats_.Count(kPromotions);
+    promotion_.OnPromote(ctx);
     dirty_ = nullptr;
+    fresh_.clear();
     misses_ = 0;
+    inserts_ = 0;
   }
 
   void DirtyLocked() {
     if (dirty_) {
       return;
     }
-    dirty_ = std::make_shared<InnerMap>();
 
+    auto started = PromotionClock::now();
     auto read = read_.Load();
-    for (const auto &kv : *read.m) {
-      auto entry = kv.second;
-      assert(entry != nullptr);
+    dirty_ = std::make_shared<InnerMap>();
+    dirty_->Reserve(std::max(read.m->Size(), reserve_));
+    for (auto *entry : *read.m) {
       if (!entry->TryExpungeLocked()) {
-        dirty_->emplace(kv);
+        dirty_->Insert(EntryPtr(entry));
       }
     }
+    amended_since_ = PromotionClock::now();
+    auto took = amended_since_ - started;
+    ++promotion_stats_.rebuilds;
+    promotion_stats_.rebuilt_entries += dirty_->Size();
+    promotion_stats_.rebuild_time +=
+        std::chrono::duration_cast<std::chrono::nanoseconds>(took);
+    stats_.Count(kRebuilds);
+    stats_.Record(kRebuildTime, took);
+    promotion_.OnRebuild(dirty_->Size(), took);
   }
 
  private:
-  mutable std::mutex mu_;
-  Read<Key, Value> read_;
+  mutable Mutex mu_;
+  Read<Key, Value, LockPolicy, Hash, KeyEqual> read_;
   std::shared_ptr<InnerMap> dirty_;
-  int misses_ = 0;
+  size_t misses_ = 0;
+  // Capacity asked for by Reserve.
+  size_t reserve_ = 0;
+  size_t inserts_ = 0;
+  // The nodes inserted into dirty_ since it was built, which the read
+  // snapshot lacks, oldest first. Kept after Delete erases them from dirty_,
+  // so a key may appear more than once. Only meaningful while amended.
+  std::vector<EntryPtr> fresh_;
+  PromotionClock::time_point amended_since_;
+  PromotionPolicy promotion_;
+  PromotionStats promotion_stats_;
+  mutable StatsPolicy stats_;
+  // Live values, maintained by every transition into or out of kValue.
+  StripedCounter size_;
+  // Null unless TrackHotKeys was called.
+  std::unique_ptr<Tracker> hot_;
 };
 
 }  // namespace map
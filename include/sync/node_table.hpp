@@ -0,0 +1,304 @@
+/**
+ * @file node_table.hpp
+ * @brief Open-addressing index of intrusive nodes.
+ * Each slot holds a node pointer and the key's hash; the key itself lives in
+ * the node, so inserting a node allocates nothing beyond occasional growth.
+ * Linear probing with backward-shift deletion (no tombstones).
+ * Not thread-safe: callers guard it with a lock, or publish it immutable.
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_NODE_TABLE_HPP_
+#define _JULIET_SYNC_NODE_TABLE_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <utility>
+
+#include "intrusive.hpp"
+#include "transparent_hash.hpp"
+
+namespace juliet::sync {
+
+/**
+ * @tparam Node RefCounted type exposing KeyType and key(). The table holds
+ * one reference to every node in it.
+ */
+template <typename Node, typename Hash = std::hash<typename Node::KeyType>,
+          typename KeyEqual = std::equal_to<typename Node::KeyType>>
+class NodeTable {
+ public:
+  using Key = typename Node::KeyType;
+  using NodeType = Node;
+  using NodePtr = IntrusivePtr<Node>;
+
+ private:
+  struct Slot {
+    size_t hash = 0;
+    Node *node = nullptr;
+  };
+
+ public:
+  class Iterator {
+   public:
+    Node *operator*() const { return slot_->node; }
+
+    Iterator &operator++() {
+      ++slot_;
+      Skip();
+      return *this;
+    }
+
+    bool operator==(const Iterator &rr) const { return slot_ == rr.slot_; }
+
+    bool operator!=(const Iterator &rr) const { return slot_ != rr.slot_; }
+
+   private:
+    friend class NodeTable;
+
+    Iterator(const Slot *slot, const Slot *end) : slot_(slot), end_(end) {
+      Skip();
+    }
+
+    void Skip() {
+      while (slot_ != end_ && slot_->node == nullptr) {
+        ++slot_;
+      }
+    }
+
+    const Slot *slot_;
+    const Slot *end_;
+  };
+
+  NodeTable() = default;
+
+  NodeTable(const NodeTable &rr) {
+    Reserve(rr.size_);
+    for (auto *node : rr) {
+      node->AddRef();
+      Place(HashOf(node->key()), node);
+    }
+  }
+
+  NodeTable(NodeTable &&rr) noexcept { Swap(rr); }
+
+  NodeTable &operator=(NodeTable rr) noexcept {
+    Swap(rr);
+    return *this;
+  }
+
+  ~NodeTable() { Clear(); }
+
+  size_t Size() const { return size_; }
+
+  bool Empty() const { return size_ == 0; }
+
+  Iterator begin() const {
+    return Iterator(slots_.get(), slots_.get() + Capacity());
+  }
+
+  Iterator end() const {
+    return Iterator(slots_.get() + Capacity(), slots_.get() + Capacity());
+  }
+
+  // Slots to split iteration over; see ForEachIn.
+  size_t SlotCount() const { return Capacity(); }
+
+  // Call fn(node) for the nodes in slots [first, last).
+  template <typename Fn>
+  void ForEachIn(size_t first, size_t last, Fn &&fn) const {
+    for (auto i = first; i < last; ++i) {
+      if (slots_[i].node != nullptr) {
+        fn(slots_[i].node);
+      }
+    }
+  }
+
+  // The node in slot i (below SlotCount), or nullptr.
+  Node *At(size_t i) const { return slots_[i].node; }
+
+  /**
+   * Remove the node in slot i (below SlotCount); nullptr if it is empty.
+   * Leaves holes in probe runs, so afterwards the table only supports
+   * Extract, iteration and destruction: for consuming a table nobody looks
+   * up in any more.
+   */
+  NodePtr Extract(size_t i) {
+    if (slots_[i].node == nullptr) {
+      return nullptr;
+    }
+    NodePtr removed(slots_[i].node);
+    removed->Release();
+    slots_[i] = Slot{};
+    --size_;
+    return removed;
+  }
+
+  /**
+   * @return the node stored under key, or nullptr. The pointer stays valid
+   * while the node is in this table.
+   */
+  Node *Find(const Key &key) const { return FindHashed(HashOf(key), key); }
+
+  // Find by a K equal to a Key; see transparent_hash.hpp.
+  template <typename K, typename = EnableHeterogeneous<K, Key, Hash, KeyEqual>>
+  Node *Find(const K &key) const {
+    return FindHashed(HashOf(key), key);
+  }
+
+  /**
+   * Insert node unless its key is already present.
+   * @return the node now stored under the key, and true if node was inserted.
+   */
+  std::pair<Node *, bool> Insert(NodePtr node) {
+    assert(node != nullptr);
+    auto hash = HashOf(node->key());
+    if (auto *found = FindHashed(hash, node->key())) {
+      return {found, false};
+    }
+    Reserve(size_ + 1);
+    auto *raw = node.get();
+    raw->AddRef();
+    Place(hash, raw);
+    return {raw, true};
+  }
+
+  /**
+   * Remove key.
+   * @return the removed node, or nullptr if key was absent.
+   */
+  NodePtr Erase(const Key &key) {
+    if (size_ == 0) {
+      return nullptr;
+    }
+    auto hash = HashOf(key);
+    auto i = hash & mask_;
+    for (;; i = (i + 1) & mask_) {
+      const auto &slot = slots_[i];
+      if (slot.node == nullptr) {
+        return nullptr;
+      }
+      if (slot.hash == hash && equal_(slot.node->key(), key)) {
+        break;
+      }
+    }
+
+    // Hand the table's reference over to the returned pointer.
+    NodePtr removed(slots_[i].node);
+    removed->Release();
+    // Shift later members of the probe run back over the hole.
+    for (auto j = (i + 1) & mask_;; j = (j + 1) & mask_) {
+      auto &slot = slots_[j];
+      if (slot.node == nullptr) {
+        break;
+      }
+      auto home = slot.hash & mask_;
+      if (((j - home) & mask_) >= ((j - i) & mask_)) {
+        slots_[i] = slot;
+        i = j;
+      }
+    }
+    slots_[i] = Slot{};
+    --size_;
+    return removed;
+  }
+
+  // Make room for n nodes without rehashing.
+  void Reserve(size_t n) {
+    if (n * kLoadDen <= Capacity() * kLoadNum) {
+      return;
+    }
+    size_t capacity = kMinCapacity;
+    while (n * kLoadDen > capacity * kLoadNum) {
+      capacity <<= 1;
+    }
+    auto old_capacity = Capacity();
+    auto old = std::move(slots_);
+    slots_ = std::make_unique<Slot[]>(capacity);
+    mask_ = capacity - 1;
+    size_ = 0;
+    for (size_t i = 0; i < old_capacity; ++i) {
+      if (old[i].node != nullptr) {
+        Place(old[i].hash, old[i].node);
+      }
+    }
+  }
+
+  void Clear() {
+    for (size_t i = 0, capacity = Capacity(); i < capacity; ++i) {
+      if (slots_[i].node != nullptr) {
+        slots_[i].node->Release();
+        slots_[i] = Slot{};
+      }
+    }
+    size_ = 0;
+  }
+
+  void Swap(NodeTable &rr) noexcept {
+    std::swap(slots_, rr.slots_);
+    std::swap(mask_, rr.mask_);
+    std::swap(size_, rr.size_);
+    std::swap(hash_, rr.hash_);
+    std::swap(equal_, rr.equal_);
+  }
+
+ private:
+  static constexpr size_t kMinCapacity = 8;
+  // Grow past 3/4 full.
+  static constexpr size_t kLoadNum = 3;
+  static constexpr size_t kLoadDen = 4;
+
+  size_t Capacity() const { return slots_ != nullptr ? mask_ + 1 : 0; }
+
+  template <typename K>
+  size_t HashOf(const K &key) const {
+    // Spread weak hashes (std::hash<int> is the identity) over the low bits.
+    auto h = static_cast<uint64_t>(hash_(key)) * 0x9E3779B97F4A7C15ull;
+    return static_cast<size_t>(h ^ (h >> 32));
+  }
+
+  template <typename K>
+  Node *FindHashed(size_t hash, const K &key) const {
+    if (size_ == 0) {
+      return nullptr;
+    }
+    for (auto i = hash & mask_;; i = (i + 1) & mask_) {
+      const auto &slot = slots_[i];
+      if (slot.node == nullptr) {
+        return nullptr;
+      }
+      if (slot.hash == hash && equal_(slot.node->key(), key)) {
+        return slot.node;
+      }
+    }
+  }
+
+  // Put a node known to be absent into a table with room for it.
+  void Place(size_t hash, Node *node) {
+    auto i = hash & mask_;
+    while (slots_[i].node != nullptr) {
+      i = (i + 1) & mask_;
+    }
+    slots_[i] = Slot{hash, node};
+    ++size_;
+  }
+
+  std::unique_ptr<Slot[]> slots_;
+  size_t mask_ = 0;
+  size_t size_ = 0;
+  Hash hash_;
+  KeyEqual equal_;
+};
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_NODE_TABLE_HPP_
@@ -3,15 +3,22 @@
  *   1. 一个Once对象只会执行一次任务，多次调用sync.Once.Call，只有第一个会执行；
  *   2. 多线程同时调用sync.Once.Call，只会有一个线程真正执行任务；
  *   3. 多线程并发调用时，其他线程会等待第一个执行的线程调用结束，以便同步地检查执行结果。
+ *
+ * OnceValue / OnceValues对应golang的sync.OnceValue / sync.OnceValues：
+ * 只执行一次函数，并把结果（或异常）缓存下来返回给所有调用者。
  */
 #ifndef _JULIET_SYNC_ONCE_H_
 #define _JULIET_SYNC_ONCE_H_
 
 #include <cassert>
 #include <atomic>
-#include <mutex>
+#include <exception>
 #include <functional>
-#include "Defer.hpp"
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <utility>
+#include "defer.hpp"
 
 namespace juliet::sync {
 
@@ -26,19 +33,24 @@ public:
 
     template<typename Callable, typename... Args>
     void Call(Callable&& _f, Args&&... _args) {
-        if (!done_.load()) {
-            std::function<void()> func = std::bind(std::forward<Callable>(_f), std::forward<Args>(_args)...);
-            CallSlow(func);
+        // 快速路径只有一次acquire读，不构造std::function
+        if (!done_.load(std::memory_order_acquire)) {
+            CallSlow(std::forward<Callable>(_f), std::forward<Args>(_args)...);
         }
     }
 
+    bool Done() const {
+        return done_.load(std::memory_order_acquire);
+    }
+
 private:
-    void CallSlow(const std::function<void()>& _func) {
-        assert(_func);
+    template<typename Callable, typename... Args>
+    void CallSlow(Callable&& _f, Args&&... _args) {
         std::lock_guard<std::mutex> guard(mu_);
-        if (!done_) {
-            DEFER([this]() { done_.store(true); });
-            _func();
+        if (!done_.load(std::memory_order_relaxed)) {
+            // 与golang一致：任务抛出异常也视为已执行
+            DEFER([this]() { done_.store(true, std::memory_order_release); });
+            std::invoke(std::forward<Callable>(_f), std::forward<Args>(_args)...);
         }
     }
 
@@ -46,6 +58,100 @@ private:
     std::mutex mu_;
 };
 
+/**
+ * 函数抛出异常时的处理策略
+ */
+enum class OncePolicy {
+    // 缓存异常，之后每次Get都重新抛出同一个异常（golang语义）
+    kCacheException,
+    // 不缓存异常，下一个调用者会重新执行函数
+    kRetryOnException,
+};
+
+/**
+ * 惰性初始化的值。第一次Get时执行函数，之后直接返回缓存的结果。
+ * 初始化完成后，Get只有一次acquire读，没有分配也没有类型擦除。
+ * @tparam T 值类型
+ * @tparam Policy 异常处理策略
+ * @tparam Func 函数对象类型，只在慢路径上调用。用MakeOnceValue可以避免std::function
+ */
+template<typename T,
+         OncePolicy Policy = OncePolicy::kCacheException,
+         typename Func = std::function<T()>>
+class OnceValue {
+public:
+    template<typename F>
+    explicit OnceValue(F&& _f) : func_(std::in_place, std::forward<F>(_f)) {
+
+    }
+
+    OnceValue(const OnceValue&) = delete;
+    OnceValue& operator=(const OnceValue&) = delete;
+
+    const T& Get() {
+        if (state_.load(std::memory_order_acquire) == kValue)
+            return *value_;
+        return GetSlow();
+    }
+
+    const T& operator()() {
+        return Get();
+    }
+
+    bool Done() const {
+        return state_.load(std::memory_order_acquire) != kInit;
+    }
+
+private:
+    enum EState : unsigned char { kInit, kValue, kException };
+
+    const T& GetSlow() {
+        std::lock_guard<std::mutex> guard(mu_);
+        auto state = state_.load(std::memory_order_relaxed);
+        if (state == kInit) {
+            try {
+                value_.emplace(std::invoke(*func_));
+                state = kValue;
+            } catch (...) {
+                if constexpr (Policy == OncePolicy::kRetryOnException)
+                    throw;
+                error_ = std::current_exception();
+                state = kException;
+            }
+            // 与golang一致：执行完后释放函数对象及其捕获的资源
+            func_.reset();
+            state_.store(state, std::memory_order_release);
+        }
+        if (state == kException)
+            std::rethrow_exception(error_);
+        return *value_;
+    }
+
+    std::atomic<EState> state_{kInit};
+    std::optional<T> value_;
+    std::exception_ptr error_;
+    std::optional<Func> func_;
+    std::mutex mu_;
+};
+
+/**
+ * 对应golang的sync.OnceValues，函数返回(value, error)对，两者一起缓存
+ */
+template<typename T, typename Err,
+         OncePolicy Policy = OncePolicy::kCacheException,
+         typename Func = std::function<std::pair<T, Err>()>>
+using OnceValues = OnceValue<std::pair<T, Err>, Policy, Func>;
+
+/**
+ * 推导函数对象类型，构造不做类型擦除的OnceValue
+ */
+template<OncePolicy Policy = OncePolicy::kCacheException, typename F>
+OnceValue<std::decay_t<std::invoke_result_t<std::decay_t<F>&>>, Policy, std::decay_t<F>>
+MakeOnceValue(F&& _f) {
+    return OnceValue<std::decay_t<std::invoke_result_t<std::decay_t<F>&>>, Policy, std::decay_t<F>>(
+        std::forward<F>(_f));
+}
+
 }
 
 #endif // !_JULIET_SYNC_ONCE_H_
@@ -0,0 +1,440 @@
+/**
+ * @file ordered_map.hpp
+ * @brief Concurrent ordered map: a lock-free skip list (Fraser / Herlihy &
+ * Shavit) with range scans.
+ *   - Get, LowerBound and iteration never block and never write shared state
+ *     (beyond helping to unlink deleted nodes).
+ *   - Put and Remove are lock-free; a key's value is replaced by swapping a
+ *     pointer, so concurrent readers always see a whole value.
+ *   - Iterators are weakly consistent: they never return a key twice or out
+ *     of order, see every key present for the whole scan, and may or may not
+ *     see keys inserted or removed during it.
+ * Unlinked nodes and replaced values are reclaimed through Epoch (epoch.hpp).
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_ORDERED_MAP_HPP_
+#define _JULIET_SYNC_ORDERED_MAP_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <new>
+#include <utility>
+
+#include "epoch.hpp"
+#include "striped_counter.hpp"
+
+namespace juliet::sync {
+
+template <typename Key, typename Value, typename Compare = std::less<Key>>
+class OrderedMap {
+  class Node;
+
+ public:
+  class Iterator;
+
+  OrderedMap() {
+    for (auto &next : head_) {
+      next.store(0, std::memory_order_relaxed);
+    }
+  }
+
+  OrderedMap(const OrderedMap &) = delete;
+  OrderedMap &operator=(const OrderedMap &) = delete;
+
+  // Not safe against concurrent access.
+  ~OrderedMap() {
+    auto *node = Ref(head_[0].load(std::memory_order_relaxed));
+    while (node != nullptr) {
+      auto *next = Ref(node->Next(0).load(std::memory_order_relaxed));
+      Node::Destroy(node);
+      node = next;
+    }
+  }
+
+  /**
+   * Insert or overwrite.
+   * @return true if key was inserted, false if an existing value was replaced.
+   */
+  bool Put(const Key &key, const Value &value) {
+    return PutWith(key, [&value]() { return new Value(value); });
+  }
+
+  bool Put(const Key &key, Value &&value) {
+    return PutWith(key, [&value]() { return new Value(std::move(value)); });
+  }
+
+  bool Get(const Key &key, Value *value) const {
+    Epoch::Guard guard;
+    auto *node = FindNode(key);
+    if (node == nullptr) {
+      return false;
+    }
+    assert(value != nullptr);
+    *value = *node->value.load(std::memory_order_acquire);
+    return true;
+  }
+
+  bool Contains(const Key &key) const {
+    Epoch::Guard guard;
+    return FindNode(key) != nullptr;
+  }
+
+  bool Remove(const Key &key) { return Remove(key, nullptr); }
+
+  bool Remove(const Key &key, Value *value) {
+    Epoch::Guard guard;
+    Node *preds[kMaxLevel];
+    Node *succs[kMaxLevel];
+    if (!Find(key, preds, succs)) {
+      return false;
+    }
+    auto *node = succs[0];
+
+    for (int level = node->height - 1; level > 0; --level) {
+      auto next = node->Next(level).load(std::memory_order_acquire);
+      while (!Marked(next)) {
+        node->Next(level).compare_exchange_weak(next, next | kMark,
+                                                std::memory_order_acq_rel,
+                                                std::memory_order_acquire);
+      }
+    }
+
+    // Marking level 0 is the linearization point; only one remover wins.
+    auto next = node->Next(0).load(std::memory_order_acquire);
+    for (;;) {
+      if (Marked(next)) {
+        return false;
+      }
+      if (node->Next(0).compare_exchange_weak(next, next | kMark,
+                                              std::memory_order_acq_rel,
+                                              std::memory_order_acquire)) {
+        break;
+      }
+    }
+    if (value != nullptr) {
+      *value = *node->value.load(std::memory_order_acquire);
+    }
+    size_.Decrement();
+    // Unlink from every level before giving up our reference.
+    Find(key, preds, succs);
+    node->Unref();
+    return true;
+  }
+
+  // First entry not less than key.
+  Iterator LowerBound(const Key &key) const {
+    Iterator it;
+    Node *preds[kMaxLevel];
+    Node *succs[kMaxLevel];
+    Find(key, preds, succs);
+    it.node_ = succs[0];
+    it.SkipDeleted();
+    return it;
+  }
+
+  Iterator Begin() const {
+    Iterator it;
+    it.node_ = Ref(head_[0].load(std::memory_order_acquire));
+    it.SkipDeleted();
+    return it;
+  }
+
+  /**
+   * Visit entries with from <= key < to in order, until fn returns false.
+   * Runs concurrently with writers; weakly consistent like Iterator.
+   */
+  template <typename Fn>
+  void Range(const Key &from, const Key &to, Fn &&fn) const {
+    for (auto it = LowerBound(from); it.Valid() && less_(it.key(), to);
+         it.Next()) {
+      if (!fn(it.key(), it.value())) {
+        break;
+      }
+    }
+  }
+
+  // Number of keys. O(cores); approximate while writers are active.
+  size_t Size() const {
+    auto size = size_.Sum();
+    return size > 0 ? static_cast<size_t>(size) : 0;
+  }
+
+  /**
+   * Forward iterator over live entries. Keeps the calling thread pinned
+   * (see Epoch) while it exists, so references from key() and value() stay
+   * valid; long-lived iterators delay reclamation for everyone.
+   */
+  class Iterator {
+   public:
+    bool Valid() const { return node_ != nullptr; }
+
+    const Key &key() const { return node_->key; }
+
+    // The value current when called.
+    const Value &value() const {
+      return *node_->value.load(std::memory_order_acquire);
+    }
+
+    void Next() {
+      node_ = Ref(node_->Next(0).load(std::memory_order_acquire));
+      SkipDeleted();
+    }
+
+   private:
+    friend class OrderedMap;
+
+    Iterator() = default;
+
+    void SkipDeleted() {
+      while (node_ != nullptr &&
+             Marked(node_->Next(0).load(std::memory_order_acquire))) {
+        node_ = Ref(node_->Next(0).load(std::memory_order_acquire));
+      }
+    }
+
+    Epoch::Guard guard_;
+    Node *node_ = nullptr;
+  };
+
+ private:
+  static constexpr int kMaxLevel = 20;
+  static constexpr uintptr_t kMark = 1;
+
+  // Links are Node pointers with the low bit marking the owning node deleted
+  // at that level.
+  using Link = std::atomic<uintptr_t>;
+
+  class Node {
+   public:
+    const Key key;
+    std::atomic<Value *> value;
+    // One reference for the inserter while it links the upper levels, one
+    // for the remover until it has unlinked the node. Retired at zero.
+    std::atomic<int> refs{2};
+    const int height;
+
+    static Node *Create(const Key &k, Value *v, int height) {
+      void *mem = ::operator new(sizeof(Node) + sizeof(Link) * height);
+      auto *node = new (mem) Node(k, v, height);
+      for (int i = 0; i < height; ++i) {
+        new (&node->Next(i)) Link(0);
+      }
+      return node;
+    }
+
+    static void Destroy(void *ptr) {
+      auto *node = static_cast<Node *>(ptr);
+      delete node->value.load(std::memory_order_relaxed);
+      node->~Node();
+      ::operator delete(ptr);
+    }
+
+    Link &Next(int level) {
+      assert(level < height);
+      return reinterpret_cast<Link *>(this + 1)[level];
+    }
+
+    void Unref() {
+      if (refs.fetch_sub(1, std::memory_order_acq_rel) == 1) {
+        Epoch::Retire(this, &Node::Destroy);
+      }
+    }
+
+   private:
+    Node(const Key &k, Value *v, int h) : key(k), value(v), height(h) {}
+  };
+
+  static_assert(alignof(Node) >= 2, "the mark bit needs aligned nodes");
+
+  static Node *Ref(uintptr_t link) {
+    return reinterpret_cast<Node *>(link & ~kMark);
+  }
+
+  static bool Marked(uintptr_t link) { return (link & kMark) != 0; }
+
+  static uintptr_t LinkTo(Node *node) {
+    return reinterpret_cast<uintptr_t>(node);
+  }
+
+  Link &NextOf(Node *pred, int level) const {
+    return pred == nullptr ? head_[level] : pred->Next(level);
+  }
+
+  bool Equal(const Key &a, const Key &b) const {
+    return !less_(a, b) && !less_(b, a);
+  }
+
+  static int RandomHeight() {
+    thread_local uint32_t state =
+        0x9E3779B9u ^ static_cast<uint32_t>(
+                          reinterpret_cast<uintptr_t>(&state) >> 4);
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    // p = 1/4 per level.
+    int height = 1;
+    for (auto bits = state; height < kMaxLevel && (bits & 3) == 0;
+         bits >>= 2) {
+      ++height;
+    }
+    return height;
+  }
+
+  /**
+   * Fill preds/succs with the neighbours of key on every level, unlinking
+   * marked nodes on the way. A null pred means the head.
+   * @return true if succs[0] holds key.
+   */
+  bool Find(const Key &key, Node **preds, Node **succs) const {
+  retry:
+    Node *pred = nullptr;
+    for (int level = kMaxLevel - 1; level >= 0; --level) {
+      auto curr = Ref(NextOf(pred, level).load(std::memory_order_acquire));
+      while (curr != nullptr) {
+        auto succ = curr->Next(level).load(std::memory_order_acquire);
+        if (Marked(succ)) {
+          auto expected = LinkTo(curr);
+          if (!NextOf(pred, level).compare_exchange_strong(
+                  expected, succ & ~kMark, std::memory_order_acq_rel,
+                  std::memory_order_acquire)) {
+            goto retry;
+          }
+          curr = Ref(succ);
+          continue;
+        }
+        if (!less_(curr->key, key)) {
+          break;
+        }
+        pred = curr;
+        curr = Ref(succ);
+      }
+      preds[level] = pred;
+      succs[level] = curr;
+    }
+    return succs[0] != nullptr && Equal(succs[0]->key, key);
+  }
+
+  // Like Find but read-only: skips marked nodes instead of unlinking them.
+  Node *FindNode(const Key &key) const {
+    Node *pred = nullptr;
+    Node *curr = nullptr;
+    for (int level = kMaxLevel - 1; level >= 0; --level) {
+      curr = Ref(NextOf(pred, level).load(std::memory_order_acquire));
+      while (curr != nullptr) {
+        auto succ = curr->Next(level).load(std::memory_order_acquire);
+        if (Marked(succ)) {
+          curr = Ref(succ);
+          continue;
+        }
+        if (!less_(curr->key, key)) {
+          break;
+        }
+        pred = curr;
+        curr = Ref(succ);
+      }
+    }
+    if (curr == nullptr || !Equal(curr->key, key) ||
+        Marked(curr->Next(0).load(std::memory_order_acquire))) {
+      return nullptr;
+    }
+    return curr;
+  }
+
+  template <typename MakeValue>
+  bool PutWith(const Key &key, MakeValue &&make_value) {
+    Epoch::Guard guard;
+    Node *preds[kMaxLevel];
+    Node *succs[kMaxLevel];
+    Value *value = nullptr;
+    Node *node = nullptr;
+    auto height = RandomHeight();
+
+    for (;;) {
+      if (Find(key, preds, succs)) {
+        // Replacing the value of a node being removed orders us before the
+        // removal, which is fine.
+        if (value == nullptr) {
+          value = make_value();
+        }
+        auto *old = succs[0]->value.exchange(value, std::memory_order_acq_rel);
+        Epoch::Retire(old);
+        if (node != nullptr) {
+          node->value.store(nullptr, std::memory_order_relaxed);
+          Node::Destroy(node);
+        }
+        return false;
+      }
+
+      if (node == nullptr) {
+        value = make_value();
+        node = Node::Create(key, value, height);
+      }
+      for (int level = 0; level < height; ++level) {
+        node->Next(level).store(LinkTo(succs[level]), std::memory_order_relaxed);
+      }
+      auto expected = LinkTo(succs[0]);
+      if (NextOf(preds[0], 0).compare_exchange_strong(
+              expected, LinkTo(node), std::memory_order_acq_rel,
+              std::memory_order_acquire)) {
+        break;
+      }
+    }
+    size_.Increment();
+
+    for (int level = 1; level < height; ++level) {
+      for (;;) {
+        // Point the new node at the current successor, unless a remover has
+        // already marked this level: then stop building the tower.
+        auto next = node->Next(level).load(std::memory_order_acquire);
+        if (Marked(next)) {
+          goto done;
+        }
+        if (Ref(next) != succs[level] &&
+            !node->Next(level).compare_exchange_strong(
+                next, LinkTo(succs[level]), std::memory_order_acq_rel,
+                std::memory_order_acquire)) {
+          goto done;
+        }
+        auto expected = LinkTo(succs[level]);
+        if (NextOf(preds[level], level)
+                .compare_exchange_strong(expected, LinkTo(node),
+                                         std::memory_order_acq_rel,
+                                         std::memory_order_acquire)) {
+          break;
+        }
+        Find(key, preds, succs);
+        if (succs[0] != node) {
+          // Removed (and maybe replaced by a newer node) meanwhile.
+          goto done;
+        }
+      }
+    }
+
+  done:
+    // A remover may have marked the node while we were linking it in; make
+    // sure no level still points at it before dropping our reference.
+    if (Marked(node->Next(0).load(std::memory_order_acquire))) {
+      Find(key, preds, succs);
+    }
+    node->Unref();
+    return true;
+  }
+
+  mutable Link head_[kMaxLevel];
+  Compare less_;
+  StripedCounter size_;
+};
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_ORDERED_MAP_HPP_
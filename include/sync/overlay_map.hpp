@@ -0,0 +1,318 @@
+/**
+ * @file overlay_map.hpp
+ * @brief A large immutable base plus a small concurrent delta, LSM-style.
+ * Reads check the delta and then the base (a FrozenMap) without locking.
+ * Writes and deletes go to the delta, an OrderedMap of values and
+ * tombstones, so a new key never copies anything. Once the delta grows past
+ * a fraction of the base, compaction freezes it behind a fresh delta, merges
+ * it into a new base and publishes that; readers see the frozen delta until
+ * then, so no write is ever invisible.
+ *   state_ --> { base, active delta, frozen delta or null }
+ * A state is replaced as a whole and reclaimed through Epoch (epoch.hpp).
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_OVERLAY_MAP_HPP_
+#define _JULIET_SYNC_OVERLAY_MAP_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <utility>
+
+#include "epoch.hpp"
+#include "frozen_map.hpp"
+#include "lock_policy.hpp"
+#include "ordered_map.hpp"
+
+namespace juliet::sync {
+
+/**
+ * @tparam Key see FrozenMap; the delta also orders keys by Compare.
+ * @tparam Value see FrozenMap; must be default-constructible.
+ * @tparam LockPolicy see lock_policy.hpp. Writers hold SharedMutex shared,
+ * compaction takes it exclusively only to swap the delta.
+ */
+template <typename Key, typename Value, typename Compare = std::less<Key>,
+          typename LockPolicy = StdLockPolicy>
+class OverlayMap {
+ public:
+  using Base = FrozenMap<Key, Value>;
+  using SharedMutex = typename LockPolicy::SharedMutex;
+
+  // Compact once the delta holds this many keys, or base size / kDeltaRatio.
+  static constexpr size_t kMinCompaction = 4096;
+  static constexpr size_t kDeltaRatio = 8;
+
+  /**
+   * @param base the initial contents, e.g. a FrozenMap opened from a file.
+   * @param background merge in a thread of the map's own; otherwise only
+   * Compact() merges.
+   */
+  explicit OverlayMap(Base base = Base(), bool background = true)
+      : state_(new State{std::make_shared<const Base>(std::move(base)),
+                         std::make_shared<Delta>(), nullptr}) {
+    if (background) {
+      worker_ = std::thread([this]() { Work(); });
+    }
+  }
+
+  OverlayMap(const OverlayMap &) = delete;
+  OverlayMap &operator=(const OverlayMap &) = delete;
+
+  // Waits for a running compaction. Not safe against concurrent access.
+  ~OverlayMap() {
+    if (worker_.joinable()) {
+      {
+        std::lock_guard<std::mutex> guard(worker_mu_);
+        stop_ = true;
+      }
+      worker_cv_.notify_one();
+      worker_.join();
+    }
+    delete state_.load(std::memory_order_relaxed);
+  }
+
+  void Store(const Key &key, const Value &value) {
+    bool inserted;
+    size_t delta_size;
+    {
+      std::shared_lock<SharedMutex> lock(mu_);
+      Epoch::Guard guard;
+      auto *state = state_.load(std::memory_order_acquire);
+      inserted = state->active->Put(key, Record{value, true});
+      delta_size = inserted ? state->active->Size() : 0;
+    }
+    if (inserted) {
+      MaybeCompact(delta_size);
+    }
+  }
+
+  /**
+   * Hide key behind a tombstone until the next compaction drops it.
+   * @return whether key was present.
+   */
+  bool Delete(const Key &key) {
+    bool inserted;
+    size_t delta_size;
+    {
+      std::shared_lock<SharedMutex> lock(mu_);
+      Epoch::Guard guard;
+      auto *state = state_.load(std::memory_order_acquire);
+      if (!Find(*state, key, nullptr)) {
+        return false;
+      }
+      inserted = state->active->Put(key, Record{Value{}, false});
+      delta_size = inserted ? state->active->Size() : 0;
+    }
+    if (inserted) {
+      MaybeCompact(delta_size);
+    }
+    return true;
+  }
+
+  bool Load(const Key &key, Value *value) const {
+    Epoch::Guard guard;
+    return Find(*state_.load(std::memory_order_acquire), key, value);
+  }
+
+  Value Load(const Key &key) const {
+    Value result{};
+    Load(key, &result);
+    return result;
+  }
+
+  bool Contains(const Key &key) const { return Load(key, nullptr); }
+
+  /**
+   * Number of keys: the base size corrected by every delta entry, so
+   * O(delta size * log). Approximate while writers are active.
+   */
+  size_t Size() const {
+    Epoch::Guard guard;
+    const auto &state = *state_.load(std::memory_order_acquire);
+    auto size = static_cast<int64_t>(state.base->Size());
+    for (auto it = state.active->Begin(); it.Valid(); it.Next()) {
+      Record below;
+      auto was = state.frozen != nullptr && state.frozen->Get(it.key(), &below)
+                     ? below.live
+                     : state.base->Contains(it.key());
+      size += static_cast<int64_t>(it.value().live) - was;
+    }
+    if (state.frozen != nullptr) {
+      for (auto it = state.frozen->Begin(); it.Valid(); it.Next()) {
+        if (!state.active->Contains(it.key())) {
+          size += static_cast<int64_t>(it.value().live) -
+                  state.base->Contains(it.key());
+        }
+      }
+    }
+    return size > 0 ? static_cast<size_t>(size) : 0;
+  }
+
+  // Keys and tombstones not yet merged into the base.
+  size_t DeltaSize() const {
+    Epoch::Guard guard;
+    const auto &state = *state_.load(std::memory_order_acquire);
+    return state.active->Size() +
+           (state.frozen != nullptr ? state.frozen->Size() : 0);
+  }
+
+  /**
+   * The current base; Compact() first to include every write so far, e.g.
+   * to Save it for the next start.
+   */
+  std::shared_ptr<const Base> BaseMap() const {
+    Epoch::Guard guard;
+    return state_.load(std::memory_order_acquire)->base;
+  }
+
+  /**
+   * Merge the delta into a new base now, in the calling thread. Readers and
+   * writers carry on meanwhile; writers block only while the delta is
+   * swapped. Serialized with background compaction.
+   */
+  void Compact() {
+    std::lock_guard<std::mutex> compacting(compact_mu_);
+    std::shared_ptr<const Base> base;
+    std::shared_ptr<Delta> frozen;
+    {
+      std::lock_guard<SharedMutex> guard(mu_);
+      auto *state = state_.load(std::memory_order_relaxed);
+      if (state->active->Size() == 0) {
+        return;
+      }
+      base = state->base;
+      frozen = state->active;
+      // From here on no writer holds the frozen delta.
+      Publish(new State{base, std::make_shared<Delta>(), frozen});
+    }
+
+    auto merged = std::make_shared<const Base>(Merge(*base, *frozen));
+    std::lock_guard<SharedMutex> guard(mu_);
+    Publish(new State{std::move(merged),
+                      state_.load(std::memory_order_relaxed)->active,
+                      nullptr});
+  }
+
+ private:
+  struct Record {
+    Value value;
+    // False for a tombstone.
+    bool live;
+  };
+
+  using Delta = OrderedMap<Key, Record, Compare>;
+
+  struct State {
+    std::shared_ptr<const Base> base;
+    std::shared_ptr<Delta> active;
+    // Being merged into the next base; read-only.
+    std::shared_ptr<Delta> frozen;
+  };
+
+  // Call with an Epoch::Guard held. value may be null.
+  static bool Find(const State &state, const Key &key, Value *value) {
+    Record record;
+    if (state.active->Get(key, &record) ||
+        (state.frozen != nullptr && state.frozen->Get(key, &record))) {
+      if (record.live && value != nullptr) {
+        *value = std::move(record.value);
+      }
+      return record.live;
+    }
+    return value != nullptr ? state.base->Load(key, value)
+                            : state.base->Contains(key);
+  }
+
+  static Base Merge(const Base &base, const Delta &delta) {
+    // Base keys the delta overrides, as a set with O(1) lookups.
+    typename FrozenMap<Key, bool>::Builder overridden;
+    overridden.Reserve(delta.Size());
+    for (auto it = delta.Begin(); it.Valid(); it.Next()) {
+      overridden.Add(it.key(), true);
+    }
+    auto shadow = overridden.Build();
+
+    typename Base::Builder builder;
+    builder.Reserve(base.Size() + delta.Size());
+    base.ForEach([&](typename Base::KeyView key,
+                     typename Base::ValueView value) {
+      if (!shadow.Contains(key)) {
+        builder.Add(key, value);
+      }
+    });
+    for (auto it = delta.Begin(); it.Valid(); it.Next()) {
+      if (it.value().live) {
+        builder.Add(it.key(), it.value().value);
+      }
+    }
+    return builder.Build();
+  }
+
+  // Call with mu_ held exclusively.
+  void Publish(State *state) {
+    Epoch::Retire(state_.exchange(state, std::memory_order_acq_rel));
+  }
+
+  void MaybeCompact(size_t delta_size) {
+    if (!worker_.joinable() ||
+        delta_size < std::max(kMinCompaction, BaseSize() / kDeltaRatio) ||
+        pending_.exchange(true, std::memory_order_acq_rel)) {
+      return;
+    }
+    // Taking the lock orders this with the worker's check of pending_.
+    { std::lock_guard<std::mutex> guard(worker_mu_); }
+    worker_cv_.notify_one();
+  }
+
+  size_t BaseSize() const {
+    Epoch::Guard guard;
+    return state_.load(std::memory_order_acquire)->base->Size();
+  }
+
+  void Work() {
+    std::unique_lock<std::mutex> lock(worker_mu_);
+    for (;;) {
+      worker_cv_.wait(lock, [this]() {
+        return stop_ || pending_.load(std::memory_order_acquire);
+      });
+      if (stop_) {
+        return;
+      }
+      lock.unlock();
+      Compact();
+      // Writes that arrived during the merge trigger the next one.
+      pending_.store(false, std::memory_order_release);
+      lock.lock();
+    }
+  }
+
+  std::atomic<State *> state_;
+  // Writers shared; swapping the delta exclusive.
+  mutable SharedMutex mu_;
+  std::mutex compact_mu_;
+
+  std::thread worker_;
+  std::mutex worker_mu_;
+  std::condition_variable worker_cv_;
+  std::atomic<bool> pending_{false};
+  bool stop_ = false;
+};
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_OVERLAY_MAP_HPP_
@@ -0,0 +1,284 @@
+/**
+ * @file parking_lot.hpp
+ * @brief WebKit-style parking lot and the compact locks built on it.
+ * Waiting threads are kept in a global hashed table of queues keyed by the
+ * address they wait on, so a lock itself only needs two bits (held, parked)
+ * and can live inside a byte or inside spare bits of another atomic word.
+ * Each parked thread sleeps on its own futex word.
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_PARKING_LOT_HPP_
+#define _JULIET_SYNC_PARKING_LOT_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <atomic>
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+
+#include "lock.hpp"
+
+namespace juliet::sync {
+
+class ParkingLot {
+ public:
+  /**
+   * Park the calling thread on addr, unless validate() returns false.
+   * validate runs under the queue lock, so it cannot race with UnparkOne.
+   * @return true if parked and then woken, false if validation failed.
+   */
+  template <typename Validate>
+  static bool Park(const void *addr, Validate &&validate) {
+    auto &me = Self();
+    auto &bucket = BucketFor(addr);
+    {
+      std::lock_guard<SpinLock> guard(bucket.lock);
+      if (!validate()) {
+        return false;
+      }
+      me.addr = addr;
+      me.next = nullptr;
+      me.parked.store(1, std::memory_order_relaxed);
+      if (bucket.tail != nullptr) {
+        bucket.tail->next = &me;
+      } else {
+        bucket.head = &me;
+      }
+      bucket.tail = &me;
+    }
+    while (me.parked.load(std::memory_order_acquire) != 0) {
+      lock_detail::FutexWait(&me.parked, 1);
+    }
+    return true;
+  }
+
+  /**
+   * Wake the oldest thread parked on addr.
+   * callback(did_unpark, may_have_more) runs under the queue lock before the
+   * thread is woken, so lock bits can be updated without racing Park.
+   */
+  template <typename Callback>
+  static void UnparkOne(const void *addr, Callback &&callback) {
+    auto &bucket = BucketFor(addr);
+    ThreadData *woken = nullptr;
+    bool more = false;
+    {
+      std::lock_guard<SpinLock> guard(bucket.lock);
+      ThreadData *prev = nullptr;
+      for (auto *cur = bucket.head; cur != nullptr; cur = cur->next) {
+        if (cur->addr != addr) {
+          prev = cur;
+          continue;
+        }
+        if (woken == nullptr) {
+          woken = cur;
+          Unlink(bucket, prev, cur);
+        } else {
+          more = true;
+          break;
+        }
+      }
+      callback(woken != nullptr, more);
+    }
+    if (woken != nullptr) {
+      Wake(woken);
+    }
+  }
+
+  static void UnparkAll(const void *addr) {
+    auto &bucket = BucketFor(addr);
+    ThreadData *woken = nullptr;
+    {
+      std::lock_guard<SpinLock> guard(bucket.lock);
+      ThreadData *prev = nullptr;
+      for (auto *cur = bucket.head; cur != nullptr;) {
+        auto *next = cur->next;
+        if (cur->addr == addr) {
+          Unlink(bucket, prev, cur);
+          cur->next = woken;
+          woken = cur;
+        } else {
+          prev = cur;
+        }
+        cur = next;
+      }
+    }
+    while (woken != nullptr) {
+      auto *next = woken->next;
+      Wake(woken);
+      woken = next;
+    }
+  }
+
+ private:
+  struct ThreadData {
+    std::atomic<uint32_t> parked{0};
+    const void *addr = nullptr;
+    ThreadData *next = nullptr;
+  };
+
+  struct alignas(64) Bucket {
+    SpinLock lock;
+    ThreadData *head = nullptr;
+    ThreadData *tail = nullptr;
+  };
+
+  static constexpr size_t kBucketBits = 8;
+
+  static ThreadData &Self() {
+    thread_local ThreadData data;
+    return data;
+  }
+
+  static Bucket &BucketFor(const void *addr) {
+    static Bucket buckets[size_t{1} << kBucketBits];
+    auto h = static_cast<uint64_t>(reinterpret_cast<uintptr_t>(addr)) *
+             0x9E3779B97F4A7C15ull;
+    return buckets[h >> (64 - kBucketBits)];
+  }
+
+  static void Unlink(Bucket &bucket, ThreadData *prev, ThreadData *cur) {
+    if (prev != nullptr) {
+      prev->next = cur->next;
+    } else {
+      bucket.head = cur->next;
+    }
+    if (bucket.tail == cur) {
+      bucket.tail = prev;
+    }
+  }
+
+  static void Wake(ThreadData *data) {
+    data->parked.store(0, std::memory_order_release);
+    lock_detail::FutexWake(&data->parked, 1);
+  }
+};
+
+/**
+ * Lock that uses two bits of an existing atomic word. The other bits are left
+ * to the owner, who must preserve the lock bits when updating them.
+ * @tparam Word unsigned integer type of the word
+ */
+template <typename Word, Word kHeld, Word kParked>
+class BitLock {
+  static_assert(std::is_unsigned<Word>::value, "Word must be unsigned");
+  static_assert((kHeld & kParked) == 0, "lock bits must differ");
+
+ public:
+  static constexpr Word kMask = kHeld | kParked;
+
+  static void Lock(std::atomic<Word> &word) {
+    Word cur = word.load(std::memory_order_relaxed);
+    if ((cur & kHeld) == 0 &&
+        word.compare_exchange_weak(cur, cur | kHeld, std::memory_order_acquire,
+                                   std::memory_order_relaxed)) {
+      return;
+    }
+    LockSlow(word);
+  }
+
+  static bool TryLock(std::atomic<Word> &word) {
+    Word cur = word.load(std::memory_order_relaxed);
+    while ((cur & kHeld) == 0) {
+      if (word.compare_exchange_weak(cur, cur | kHeld,
+                                     std::memory_order_acquire,
+                                     std::memory_order_relaxed)) {
+        return true;
+      }
+    }
+    return false;
+  }
+
+  static void Unlock(std::atomic<Word> &word) {
+    Word cur = word.load(std::memory_order_relaxed);
+    while ((cur & kParked) == 0) {
+      assert(cur & kHeld);
+      if (word.compare_exchange_weak(cur, cur & ~kHeld,
+                                     std::memory_order_release,
+                                     std::memory_order_relaxed)) {
+        return;
+      }
+    }
+    UnlockSlow(word);
+  }
+
+ private:
+  static constexpr int kSpinLimit = 40;
+
+  static void LockSlow(std::atomic<Word> &word) {
+    int spins = 0;
+    for (;;) {
+      Word cur = word.load(std::memory_order_relaxed);
+      if ((cur & kHeld) == 0) {
+        if (word.compare_exchange_weak(cur, cur | kHeld,
+                                       std::memory_order_acquire,
+                                       std::memory_order_relaxed)) {
+          return;
+        }
+        continue;
+      }
+      // Spin only while nobody is parked; otherwise we would barge ahead of
+      // parked threads forever.
+      if ((cur & kParked) == 0 && spins < kSpinLimit) {
+        ++spins;
+        std::this_thread::yield();
+        continue;
+      }
+      if ((cur & kParked) == 0 &&
+          !word.compare_exchange_weak(cur, cur | kParked,
+                                      std::memory_order_relaxed)) {
+        continue;
+      }
+      ParkingLot::Park(&word, [&word]() {
+        return (word.load(std::memory_order_relaxed) & kMask) == kMask;
+      });
+    }
+  }
+
+  static void UnlockSlow(std::atomic<Word> &word) {
+    ParkingLot::UnparkOne(&word, [&word](bool, bool more) {
+      Word cur = word.load(std::memory_order_relaxed);
+      Word clear = more ? kHeld : kMask;
+      while (!word.compare_exchange_weak(cur, cur & ~clear,
+                                         std::memory_order_release,
+                                         std::memory_order_relaxed)) {
+      }
+    });
+  }
+};
+
+/**
+ * One-byte mutex on the parking lot.
+ */
+class ByteLock {
+ public:
+  ByteLock() = default;
+  ByteLock(const ByteLock &) = delete;
+  ByteLock &operator=(const ByteLock &) = delete;
+
+  void lock() { Bits::Lock(bits_); }
+
+  bool try_lock() { return Bits::TryLock(bits_); }
+
+  void unlock() { Bits::Unlock(bits_); }
+
+ private:
+  using Bits = BitLock<uint8_t, 1, 2>;
+
+  std::atomic<uint8_t> bits_{0};
+};
+
+static_assert(sizeof(ByteLock) == 1, "ByteLock must stay one byte");
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_PARKING_LOT_HPP_
@@ -0,0 +1,188 @@
+/**
+ * @file promotion_policy.hpp
+ * @brief When sync::Map promotes its dirty table to the read snapshot.
+ * Promotion itself is a pointer swap; the cost comes later, when the next new
+ * key makes the map rebuild dirty by copying the whole snapshot. Until then,
+ * every lookup of a key that is only in dirty takes the map lock (a miss).
+ * A policy is consulted on each miss and may keep state: all of its members
+ * are called with the map lock held.
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_PROMOTION_POLICY_HPP_
+#define _JULIET_SYNC_PROMOTION_POLICY_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+
+namespace juliet::sync {
+
+using PromotionClock = std::chrono::steady_clock;
+
+// Misses are timed one in this many.
+constexpr unsigned kMissSampleRate = 64;
+
+struct PromotionContext {
+  // Misses since dirty was rebuilt.
+  size_t misses;
+  size_t dirty_size;
+  // Keys inserted into dirty since it was rebuilt.
+  size_t inserts;
+  // When dirty was rebuilt, i.e. when the snapshot became amended.
+  PromotionClock::time_point amended_since;
+};
+
+struct PromotionStats {
+  // Lookups that had to take the lock and consult dirty.
+  uint64_t misses = 0;
+  uint64_t promotions = 0;
+  // Times dirty was rebuilt from the snapshot, and what that cost.
+  uint64_t rebuilds = 0;
+  uint64_t rebuilt_entries = 0;
+  std::chrono::nanoseconds rebuild_time{0};
+};
+
+// No-op hooks for policies that only look at the context.
+struct PromotionHooks {
+  // Called for one miss in kMissSampleRate, with the time from the start of
+  // its slow path (including the wait for the lock) to the miss.
+  void OnMissSample(PromotionClock::duration /* took */) {}
+
+  // Called after dirty became the snapshot, with the context that led to it.
+  void OnPromote(const PromotionContext &) {}
+
+  void OnRebuild(size_t /* copied */, PromotionClock::duration /* took */) {}
+};
+
+// golang/sync.Map: pay as many misses as the rebuild will copy entries.
+struct GoPromotion : PromotionHooks {
+  bool ShouldPromote(const PromotionContext &ctx) const {
+    return ctx.misses >= ctx.dirty_size;
+  }
+};
+
+// Promote after Num/Den misses per dirty entry.
+template <size_t Num, size_t Den = 1>
+struct MissRatioPromotion : PromotionHooks {
+  static_assert(Num > 0 && Den > 0, "ratio must be positive");
+
+  bool ShouldPromote(const PromotionContext &ctx) const {
+    return ctx.misses * Den >= ctx.dirty_size * Num;
+  }
+};
+
+// New keys become lock-free readable at most Millis after the first one,
+// however large the map is.
+template <long Millis>
+struct IntervalPromotion : PromotionHooks {
+  bool ShouldPromote(const PromotionContext &ctx) const {
+    return ctx.misses >= ctx.dirty_size ||
+           PromotionClock::now() - ctx.amended_since >=
+               std::chrono::milliseconds(Millis);
+  }
+};
+
+// Hold off while new keys arrive faster than misses: each one would throw
+// the promoted snapshot away again.
+template <size_t MissesPerInsert = 4>
+struct WriteRatePromotion : PromotionHooks {
+  bool ShouldPromote(const PromotionContext &ctx) const {
+    return ctx.misses >= ctx.dirty_size &&
+           ctx.misses >= ctx.inserts * MissesPerInsert;
+  }
+};
+
+/**
+ * Go's rule with measured prices. Promoting pays once the misses paid so far
+ * cost as much as the rebuild a promotion may later cause (ski rental, at
+ * most twice the optimum). Go assumes a miss costs as much as copying one
+ * entry; this policy keeps moving averages of both instead, so maps whose
+ * misses are expensive (large, or with a contended lock) promote new keys
+ * early, and maps whose rebuilds are expensive promote less often.
+ * A promotion can only save the misses that would have come before the next
+ * new key forces a rebuild. When the recent miss rate times the recent
+ * snapshot lifetime is worth less than a rebuild, the map is churning and
+ * the policy falls back to Go's threshold.
+ */
+class AdaptivePromotion : public PromotionHooks {
+ public:
+  bool ShouldPromote(const PromotionContext &ctx) const {
+    return ctx.misses >= Threshold(ctx.dirty_size);
+  }
+
+  size_t Threshold(size_t dirty_size) const {
+    auto go = std::max(dirty_size, kMinMisses);
+    if (miss_ns_ <= 0 || copy_ns_ <= 0) {
+      return go;
+    }
+    auto rebuild_ns = static_cast<double>(dirty_size) * copy_ns_;
+    if (saved_measured_ && saved_ns_ < rebuild_ns) {
+      return go;
+    }
+    auto misses = rebuild_ns / miss_ns_;
+    auto most = static_cast<double>(dirty_size) * kMaxScale;
+    return std::max(static_cast<size_t>(std::min(misses, most)), kMinMisses);
+  }
+
+  void OnMissSample(PromotionClock::duration took) {
+    Average(&miss_ns_, Nanos(took));
+  }
+
+  void OnPromote(const PromotionContext &ctx) {
+    promoted_at_ = PromotionClock::now();
+    auto amended_ns = Nanos(promoted_at_ - ctx.amended_since);
+    misses_per_ns_ =
+        amended_ns > 0 ? static_cast<double>(ctx.misses) / amended_ns : 0;
+    promoted_ = true;
+  }
+
+  void OnRebuild(size_t copied, PromotionClock::duration took) {
+    if (copied >= kMinCopied) {
+      Average(&copy_ns_, Nanos(took) / static_cast<double>(copied));
+    }
+    if (promoted_) {
+      promoted_ = false;
+      auto lifetime_ns = Nanos(PromotionClock::now() - took - promoted_at_);
+      auto saved_ns = misses_per_ns_ * lifetime_ns * miss_ns_;
+      saved_ns_ = saved_measured_ ? saved_ns_ + kWeight * (saved_ns - saved_ns_)
+                                  : saved_ns;
+      saved_measured_ = true;
+    }
+  }
+
+ private:
+  static constexpr size_t kMinMisses = 8;
+  static constexpr double kMaxScale = 4;
+  // Smaller rebuilds are dominated by allocation, not per-entry copying.
+  static constexpr size_t kMinCopied = 64;
+  static constexpr double kWeight = 0.25;
+
+  static double Nanos(PromotionClock::duration d) {
+    return std::chrono::duration<double, std::nano>(d).count();
+  }
+
+  static void Average(double *average, double sample) {
+    *average = *average <= 0 ? sample : *average + kWeight * (sample - *average);
+  }
+
+  double miss_ns_ = 0;
+  double copy_ns_ = 0;
+  // Estimated miss time a promotion saved before its snapshot was rebuilt.
+  double saved_ns_ = 0;
+  bool saved_measured_ = false;
+  double misses_per_ns_ = 0;
+  bool promoted_ = false;
+  PromotionClock::time_point promoted_at_;
+};
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_PROMOTION_POLICY_HPP_
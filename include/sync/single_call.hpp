@@ -3,6 +3,8 @@
  * @author WangJun
  * @brief 工具函数，确保同时只有一个线程调用。其他线程立即返回，不阻塞等待也不重试。
  * 当然，没法阻止外部重试。
+ * Group对应golang的singleflight.Group：同一个key同时只有一个调用在执行，
+ * 其他并发调用者等待并共享它的结果（或异常）。
  * @version 0.1
  * @date 2021/8/16 18:27
  */
@@ -12,9 +14,18 @@
 #pragma once
 #endif /* __GNUC__ >= 3.4 || _MSC_VER */
 
+#include <array>
 #include <atomic>
+#include <exception>
 #include <functional>
-#include "Defer.hpp"
+#include <future>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
+#include "defer.hpp"
 
 namespace juliet::sync {
 
@@ -40,6 +51,109 @@ bool SingleCall(std::atomic_bool& __doCall, _Callable&& __f, _Args&&... __args)
     return true;
 }
 
+/**
+ * 按key合并并发调用。同一个key上，第一个调用者（leader）执行函数，
+ * 执行期间到达的其他调用者不再执行，而是等待leader的结果。
+ * 执行结束后key被移除，之后的调用会重新执行。
+ * @tparam Key
+ * @tparam Value 函数返回值类型，可以是void
+ */
+template<typename Key, typename Value, typename Hash = std::hash<Key>>
+class Group {
+public:
+    using Future = std::shared_future<Value>;
+
+    /**
+     * 执行或等待key上正在执行的调用
+     * @return 共享的结果。函数抛出的异常会重新抛给每个调用者
+     */
+    template<typename _Callable>
+    Value Do(const Key& __key, _Callable&& __f) {
+        return DoFuture(__key, std::forward<_Callable>(__f)).get();
+    }
+
+    /**
+     * 同Do，但非leader的调用者不阻塞，直接拿到进行中调用的future
+     * leader在当前线程执行函数，返回时future已就绪
+     */
+    template<typename _Callable>
+    Future DoFuture(const Key& __key, _Callable&& __f) {
+        auto& shard = ShardOf(__key);
+        std::shared_ptr<Call> call;
+        {
+            std::lock_guard<std::mutex> guard(shard.mu);
+            auto it = shard.calls.find(__key);
+            if (it != shard.calls.end())
+                return it->second->future;
+            call = std::make_shared<Call>();
+            shard.calls.emplace(__key, call);
+        }
+
+        std::exception_ptr error;
+        try {
+            if constexpr (std::is_void_v<Value>) {
+                std::forward<_Callable>(__f)();
+            } else {
+                call->value.emplace(std::forward<_Callable>(__f)());
+            }
+        } catch (...) {
+            error = std::current_exception();
+        }
+
+        // 先移除再发布结果，发布之后到达的调用者会发起新的调用
+        Forget(__key, call);
+        if (error) {
+            call->promise.set_exception(error);
+        } else if constexpr (std::is_void_v<Value>) {
+            call->promise.set_value();
+        } else {
+            call->promise.set_value(std::move(*call->value));
+        }
+        return call->future;
+    }
+
+    /**
+     * 忘掉key上正在执行的调用，之后的Do不再等待它
+     */
+    void Forget(const Key& __key) {
+        auto& shard = ShardOf(__key);
+        std::lock_guard<std::mutex> guard(shard.mu);
+        shard.calls.erase(__key);
+    }
+
+private:
+    struct Call {
+        Call() : future(promise.get_future().share()) {}
+
+        std::promise<Value> promise;
+        Future future;
+        // leader先在这里构造结果，再移入promise
+        std::conditional_t<std::is_void_v<Value>, bool, std::optional<Value>> value;
+    };
+
+    // 分段加锁，降低进行中调用表的竞争
+    struct alignas(64) Shard {
+        std::mutex mu;
+        std::unordered_map<Key, std::shared_ptr<Call>, Hash> calls;
+    };
+
+    static constexpr size_t kShards = 16;
+
+    Shard& ShardOf(const Key& __key) {
+        return shards_[Hash{}(__key) % kShards];
+    }
+
+    void Forget(const Key& __key, const std::shared_ptr<Call>& __call) {
+        auto& shard = ShardOf(__key);
+        std::lock_guard<std::mutex> guard(shard.mu);
+        auto it = shard.calls.find(__key);
+        if (it != shard.calls.end() && it->second == __call)
+            shard.calls.erase(it);
+    }
+
+    std::array<Shard, kShards> shards_;
+};
+
 } // namespace sync
 
 #endif // !_SYNC_SINGLE_CALL_HPP_
@@ -0,0 +1,330 @@
+/**
+ * @file snapshot.hpp
+ * @brief Binary snapshot files for warm-starting containers.
+ * Layout: a fixed header (magic, version, record count, key and value sizes)
+ * followed by count records, each the encoded key then the encoded value.
+ * Keys and values go through Codec<T>: trivially copyable types are stored as
+ * their raw bytes, std::string as a length prefix plus bytes, and anything
+ * else needs a Codec specialization. Files are native-endian and meant to be
+ * read back on the same platform.
+ * Writers write to path.tmp and rename it over path on Commit, so a reader
+ * never sees a half-written snapshot. Readers mmap the file and decode it in
+ * one pass.
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_SNAPSHOT_HPP_
+#define _JULIET_SYNC_SNAPSHOT_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <type_traits>
+#include <utility>
+
+#if defined _WIN32
+#include <fstream>
+#include <iterator>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace juliet::sync {
+
+/**
+ * How a key or value is stored in a snapshot. Specialize for your own types:
+ *   static constexpr size_t kFixedSize;  // encoded size, or 0 if it varies
+ *   static void Encode(const T &value, std::string *out);  // append
+ *   static bool Decode(const char **p, const char *end, T *value);
+ * Decode advances *p and returns false if the input is truncated or invalid.
+ */
+template <typename T, typename Enable = void>
+struct Codec;
+
+template <typename T>
+struct Codec<T, std::enable_if_t<std::is_trivially_copyable<T>::value>> {
+  static constexpr size_t kFixedSize = sizeof(T);
+
+  static void Encode(const T &value, std::string *out) {
+    out->append(reinterpret_cast<const char *>(&value), sizeof(T));
+  }
+
+  static bool Decode(const char **p, const char *end, T *value) {
+    if (static_cast<size_t>(end - *p) < sizeof(T)) {
+      return false;
+    }
+    std::memcpy(value, *p, sizeof(T));
+    *p += sizeof(T);
+    return true;
+  }
+};
+
+template <>
+struct Codec<std::string> {
+  static constexpr size_t kFixedSize = 0;
+
+  static void Encode(const std::string &value, std::string *out) {
+    Codec<uint64_t>::Encode(value.size(), out);
+    out->append(value);
+  }
+
+  static bool Decode(const char **p, const char *end, std::string *value) {
+    uint64_t size;
+    if (!Codec<uint64_t>::Decode(p, end, &size) ||
+        static_cast<uint64_t>(end - *p) < size) {
+      return false;
+    }
+    value->assign(*p, size);
+    *p += size;
+    return true;
+  }
+};
+
+namespace snapshot {
+
+constexpr char kMagic[8] = {'J', 'L', 'T', 'S', 'N', 'A', 'P', '\0'};
+constexpr uint32_t kVersion = 1;
+
+struct Header {
+  char magic[8];
+  uint32_t version;
+  uint32_t reserved;
+  uint64_t count;
+  // Codec<Key>::kFixedSize and Codec<Value>::kFixedSize, as a type check.
+  uint64_t key_size;
+  uint64_t value_size;
+};
+
+// How a mapped file will be read, passed on to the kernel as a hint.
+enum class Access { kSequential, kRandom };
+
+// A read-only view of a whole file: mmap'ed, or read into memory on Windows.
+class MappedFile {
+ public:
+  MappedFile() = default;
+  MappedFile(const MappedFile &) = delete;
+  MappedFile &operator=(const MappedFile &) = delete;
+
+  ~MappedFile() { Close(); }
+
+  bool Open(const std::string &path, Access access = Access::kSequential) {
+    Close();
+#if defined _WIN32
+    (void)access;
+    std::ifstream in(path, std::ios::binary);
+    if (!in) {
+      return false;
+    }
+    buffer_.assign(std::istreambuf_iterator<char>(in),
+                   std::istreambuf_iterator<char>());
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    return true;
+#else
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+      return false;
+    }
+    struct stat st;
+    if (::fstat(fd, &st) != 0) {
+      ::close(fd);
+      return false;
+    }
+    size_ = static_cast<size_t>(st.st_size);
+    if (size_ != 0) {
+      void *addr = ::mmap(nullptr, size_, PROT_READ, MAP_PRIVATE, fd, 0);
+      if (addr == MAP_FAILED) {
+        ::close(fd);
+        size_ = 0;
+        return false;
+      }
+      ::madvise(addr, size_,
+                access == Access::kSequential ? MADV_SEQUENTIAL : MADV_RANDOM);
+      data_ = static_cast<const char *>(addr);
+    }
+    ::close(fd);
+    return true;
+#endif
+  }
+
+  void Close() {
+#if defined _WIN32
+    buffer_.clear();
+#else
+    if (data_ != nullptr) {
+      ::munmap(const_cast<char *>(data_), size_);
+    }
+#endif
+    data_ = nullptr;
+    size_ = 0;
+  }
+
+  const char *data() const { return data_; }
+
+  size_t size() const { return size_; }
+
+ private:
+  const char *data_ = nullptr;
+  size_t size_ = 0;
+#if defined _WIN32
+  std::string buffer_;
+#endif
+};
+
+}  // namespace snapshot
+
+template <typename Key, typename Value>
+class SnapshotWriter {
+ public:
+  SnapshotWriter() = default;
+  SnapshotWriter(const SnapshotWriter &) = delete;
+  SnapshotWriter &operator=(const SnapshotWriter &) = delete;
+
+  // Abandons the temporary file unless Commit succeeded.
+  ~SnapshotWriter() {
+    if (file_ != nullptr) {
+      std::fclose(file_);
+      std::remove(tmp_path_.c_str());
+    }
+  }
+
+  bool Open(const std::string &path) {
+    path_ = path;
+    tmp_path_ = path + ".tmp";
+    file_ = std::fopen(tmp_path_.c_str(), "wb");
+    if (file_ == nullptr) {
+      return false;
+    }
+    // The count is patched in by Commit.
+    auto header = MakeHeader(0);
+    ok_ = std::fwrite(&header, sizeof(header), 1, file_) == 1;
+    return ok_;
+  }
+
+  void Write(const Key &key, const Value &value) {
+    Codec<Key>::Encode(key, &buffer_);
+    Codec<Value>::Encode(value, &buffer_);
+    ++count_;
+    if (buffer_.size() >= kFlushSize) {
+      Flush();
+    }
+  }
+
+  // Flush, fill in the count and move the file into place.
+  bool Commit() {
+    Flush();
+    auto header = MakeHeader(count_);
+    ok_ = ok_ && std::fseek(file_, 0, SEEK_SET) == 0 &&
+          std::fwrite(&header, sizeof(header), 1, file_) == 1;
+    ok_ = std::fclose(file_) == 0 && ok_;
+    file_ = nullptr;
+    if (!ok_ || std::rename(tmp_path_.c_str(), path_.c_str()) != 0) {
+      std::remove(tmp_path_.c_str());
+      return false;
+    }
+    return true;
+  }
+
+  uint64_t count() const { return count_; }
+
+ private:
+  static constexpr size_t kFlushSize = 1 << 20;
+
+  static snapshot::Header MakeHeader(uint64_t count) {
+    snapshot::Header header{};
+    std::memcpy(header.magic, snapshot::kMagic, sizeof(header.magic));
+    header.version = snapshot::kVersion;
+    header.count = count;
+    header.key_size = Codec<Key>::kFixedSize;
+    header.value_size = Codec<Value>::kFixedSize;
+    return header;
+  }
+
+  void Flush() {
+    if (!buffer_.empty()) {
+      ok_ = ok_ &&
+            std::fwrite(buffer_.data(), 1, buffer_.size(), file_) ==
+                buffer_.size();
+      buffer_.clear();
+    }
+  }
+
+  std::string path_;
+  std::string tmp_path_;
+  std::FILE *file_ = nullptr;
+  std::string buffer_;
+  uint64_t count_ = 0;
+  bool ok_ = false;
+};
+
+/**
+ * Decodes a snapshot written by SnapshotWriter<Key, Value>.
+ * Key and Value must be default-constructible.
+ */
+template <typename Key, typename Value>
+class SnapshotReader {
+ public:
+  // False if the file is missing, or not a snapshot of these types.
+  bool Open(const std::string &path) {
+    if (!file_.Open(path) || file_.size() < sizeof(snapshot::Header)) {
+      return false;
+    }
+    std::memcpy(&header_, file_.data(), sizeof(header_));
+    if (std::memcmp(header_.magic, snapshot::kMagic, sizeof(header_.magic)) !=
+            0 ||
+        header_.version != snapshot::kVersion ||
+        header_.key_size != Codec<Key>::kFixedSize ||
+        header_.value_size != Codec<Value>::kFixedSize) {
+      return false;
+    }
+    // Fixed-size records let a truncated file be rejected up front.
+    auto record = header_.key_size + header_.value_size;
+    if (header_.key_size != 0 && header_.value_size != 0 &&
+        (file_.size() - sizeof(header_)) / record < header_.count) {
+      return false;
+    }
+    return true;
+  }
+
+  uint64_t Count() const { return header_.count; }
+
+  /**
+   * Call fn(Key &&, Value &&) for each record in file order.
+   * @return false if the file ended early or a record failed to decode; fn
+   * has then seen only a prefix of the records.
+   */
+  template <typename Fn>
+  bool ForEach(Fn &&fn) const {
+    const char *p = file_.data() + sizeof(header_);
+    const char *end = file_.data() + file_.size();
+    for (uint64_t i = 0; i < header_.count; ++i) {
+      Key key{};
+      Value value{};
+      if (!Codec<Key>::Decode(&p, end, &key) ||
+          !Codec<Value>::Decode(&p, end, &value)) {
+        return false;
+      }
+      fn(std::move(key), std::move(value));
+    }
+    return true;
+  }
+
+ private:
+  snapshot::MappedFile file_;
+  snapshot::Header header_{};
+};
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_SNAPSHOT_HPP_
@@ -0,0 +1,235 @@
+/**
+ * @file stats_policy.hpp
+ * @brief Compile-time instrumentation for the sync containers.
+ * Every container takes a StatsPolicy template parameter:
+ *   - NoStats (the default) has empty inline hooks and never reads the
+ *     clock, so instrumented code compiles to what it was before.
+ *   - StripedStats counts events and records log2-bucketed latency
+ *     histograms into per-thread cells, summed by Stats().
+ * What a counter means is up to each container; see its Stats() comment.
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_STATS_POLICY_HPP_
+#define _JULIET_SYNC_STATS_POLICY_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <thread>
+
+namespace juliet::sync {
+
+using StatsClock = std::chrono::steady_clock;
+
+enum StatCounter : size_t {
+  // Served without the container lock.
+  kFastPath,
+  // Had to take the container lock.
+  kSlowPath,
+  kPromotions,
+  kRebuilds,
+  kStatCounters
+};
+
+enum StatTimer : size_t {
+  kLockWait,
+  kLockHold,
+  kSharedLockWait,
+  kSharedLockHold,
+  kRebuildTime,
+  kStatTimers
+};
+
+// Bucket 0 counts 0ns; bucket i counts [2^(i-1), 2^i) ns; the last is open.
+constexpr size_t kLatencyBuckets = 40;
+
+struct LatencyHistogram {
+  std::array<uint64_t, kLatencyBuckets> buckets{};
+  uint64_t count = 0;
+  std::chrono::nanoseconds total{0};
+
+  std::chrono::nanoseconds Mean() const {
+    return count == 0 ? total : total / static_cast<int64_t>(count);
+  }
+
+  // Upper bound of the bucket that holds quantile q, in [0, 1].
+  std::chrono::nanoseconds Percentile(double q) const {
+    auto rank = static_cast<uint64_t>(q * static_cast<double>(count));
+    uint64_t seen = 0;
+    for (size_t i = 0; i < kLatencyBuckets; ++i) {
+      seen += buckets[i];
+      if (seen > rank || (seen == count && seen != 0)) {
+        return std::chrono::nanoseconds(i == 0 ? 0 : int64_t{1} << i);
+      }
+    }
+    return std::chrono::nanoseconds(0);
+  }
+};
+
+struct StatsSnapshot {
+  std::array<uint64_t, kStatCounters> counters{};
+  std::array<LatencyHistogram, kStatTimers> timers{};
+
+  uint64_t operator[](StatCounter counter) const { return counters[counter]; }
+
+  const LatencyHistogram &operator[](StatTimer timer) const {
+    return timers[timer];
+  }
+};
+
+struct NoStats {
+  static constexpr bool kEnabled = false;
+
+  void Count(StatCounter, uint64_t = 1) {}
+
+  void Record(StatTimer, StatsClock::duration) {}
+
+  StatsSnapshot Stats() const { return {}; }
+};
+
+class StripedStats {
+ public:
+  static constexpr bool kEnabled = true;
+
+  StripedStats() : cells_(new Cell[kStripes]) {}
+  StripedStats(const StripedStats &) = delete;
+  StripedStats &operator=(const StripedStats &) = delete;
+
+  void Count(StatCounter counter, uint64_t n = 1) {
+    Local().counters[counter].fetch_add(n, std::memory_order_relaxed);
+  }
+
+  void Record(StatTimer timer, StatsClock::duration took) {
+    auto ns = std::max<int64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(took).count(), 0);
+    auto &histogram = Local().timers[timer];
+    histogram.buckets[Bucket(static_cast<uint64_t>(ns))].fetch_add(
+        1, std::memory_order_relaxed);
+    histogram.total_ns.fetch_add(static_cast<uint64_t>(ns),
+                                 std::memory_order_relaxed);
+  }
+
+  // Sums all threads' cells; exact once updates have stopped.
+  StatsSnapshot Stats() const {
+    StatsSnapshot snapshot;
+    for (size_t s = 0; s < kStripes; ++s) {
+      const auto &cell = cells_[s];
+      for (size_t c = 0; c < kStatCounters; ++c) {
+        snapshot.counters[c] += cell.counters[c].load(std::memory_order_relaxed);
+      }
+      for (size_t t = 0; t < kStatTimers; ++t) {
+        auto &histogram = snapshot.timers[t];
+        for (size_t b = 0; b < kLatencyBuckets; ++b) {
+          auto n = cell.timers[t].buckets[b].load(std::memory_order_relaxed);
+          histogram.buckets[b] += n;
+          histogram.count += n;
+        }
+        histogram.total += std::chrono::nanoseconds(
+            cell.timers[t].total_ns.load(std::memory_order_relaxed));
+      }
+    }
+    return snapshot;
+  }
+
+ private:
+  // Threads beyond kStripes share cells; the atomics keep that correct.
+  static constexpr size_t kStripes = 64;
+
+  struct Histogram {
+    std::array<std::atomic<uint64_t>, kLatencyBuckets> buckets{};
+    std::atomic<uint64_t> total_ns{0};
+  };
+
+  struct alignas(64) Cell {
+    std::array<std::atomic<uint64_t>, kStatCounters> counters{};
+    std::array<Histogram, kStatTimers> timers{};
+  };
+
+  static size_t Bucket(uint64_t ns) {
+    size_t bucket = 0;
+    while (ns != 0 && bucket + 1 < kLatencyBuckets) {
+      ns >>= 1;
+      ++bucket;
+    }
+    return bucket;
+  }
+
+  // Threads are numbered in the order they first record anything.
+  static size_t ThreadIndex() {
+    static std::atomic<size_t> next{0};
+    thread_local size_t index =
+        next.fetch_add(1, std::memory_order_relaxed) % kStripes;
+    return index;
+  }
+
+  Cell &Local() { return cells_[ThreadIndex()]; }
+
+  std::unique_ptr<Cell[]> cells_;
+};
+
+/**
+ * A lock guard that, under an enabled stats policy, records how long it
+ * waited for the lock and how long it held it.
+ * @tparam Guard std::lock_guard or std::shared_lock of some mutex.
+ */
+template <typename Guard, typename Stats>
+class TimedGuard {
+ public:
+  template <typename Mutex>
+  TimedGuard(Stats &stats, Mutex &mu, StatTimer wait, StatTimer hold)
+      : stats_(stats),
+        hold_(hold),
+        waited_(StatsClock::now()),
+        guard_(mu),
+        locked_(StatsClock::now()) {
+    stats_.Record(wait, locked_ - waited_);
+  }
+
+  TimedGuard(const TimedGuard &) = delete;
+  TimedGuard &operator=(const TimedGuard &) = delete;
+
+  ~TimedGuard() { stats_.Record(hold_, StatsClock::now() - locked_); }
+
+ private:
+  Stats &stats_;
+  const StatTimer hold_;
+  const StatsClock::time_point waited_;
+  Guard guard_;
+  const StatsClock::time_point locked_;
+};
+
+// Take mu exclusively; a plain Guard when stats are disabled.
+template <typename Guard, typename Stats, typename Mutex>
+auto StatsLock(Stats &stats, Mutex &mu) {
+  if constexpr (Stats::kEnabled) {
+    return TimedGuard<Guard, Stats>(stats, mu, kLockWait, kLockHold);
+  } else {
+    return Guard(mu);
+  }
+}
+
+// Take mu shared; a plain Guard when stats are disabled.
+template <typename Guard, typename Stats, typename Mutex>
+auto StatsSharedLock(Stats &stats, Mutex &mu) {
+  if constexpr (Stats::kEnabled) {
+    return TimedGuard<Guard, Stats>(stats, mu, kSharedLockWait,
+                                    kSharedLockHold);
+  } else {
+    return Guard(mu);
+  }
+}
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_STATS_POLICY_HPP_
@@ -0,0 +1,141 @@
+/**
+ * @file striped_counter.hpp
+ * @brief LongAdder-style counter. Updates go to a single base word until two
+ * threads collide on it; from then on each thread adds to its own cache-line
+ * sized cell (one per core), so increments never contend on one atomic.
+ * Sum() adds up the base and the cells: O(cores), and only approximate while
+ * updates are in flight.
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_STRIPED_COUNTER_HPP_
+#define _JULIET_SYNC_STRIPED_COUNTER_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <thread>
+
+namespace juliet::sync {
+
+// Cell selection shared by the striped counters.
+namespace stripe {
+
+constexpr size_t kMaxCells = 64;
+
+// Power of two no smaller than the core count.
+inline size_t CellCount() {
+  static const size_t count = []() {
+    size_t cores = std::thread::hardware_concurrency();
+    size_t n = 1;
+    while (n < cores && n < kMaxCells) {
+      n <<= 1;
+    }
+    return n;
+  }();
+  return count;
+}
+
+inline uint32_t Rehash(uint32_t probe) {
+  probe ^= probe << 13;
+  probe ^= probe >> 17;
+  probe ^= probe << 5;
+  return probe;
+}
+
+// The calling thread's cell index, before masking.
+inline uint32_t &Probe() {
+  static std::atomic<uint32_t> seed{0};
+  thread_local uint32_t probe =
+      (seed.fetch_add(1, std::memory_order_relaxed) + 1) * 0x9E3779B9u;
+  return probe;
+}
+
+}  // namespace stripe
+
+class StripedCounter {
+ public:
+  StripedCounter() = default;
+  StripedCounter(const StripedCounter &) = delete;
+  StripedCounter &operator=(const StripedCounter &) = delete;
+
+  ~StripedCounter() { delete[] cells_.load(std::memory_order_relaxed); }
+
+  void Add(int64_t x) {
+    Cell *cells = cells_.load(std::memory_order_acquire);
+    if (cells == nullptr) {
+      auto base = base_.load(std::memory_order_relaxed);
+      if (base_.compare_exchange_strong(base, base + x,
+                                        std::memory_order_relaxed)) {
+        return;
+      }
+      cells = InitCells();
+    }
+
+    auto &probe = stripe::Probe();
+    auto &cell = cells[probe & (CellCount() - 1)];
+    auto value = cell.value.load(std::memory_order_relaxed);
+    if (!cell.value.compare_exchange_strong(value, value + x,
+                                            std::memory_order_relaxed)) {
+      // Sharing a cell with another thread: move to another one next time.
+      probe = stripe::Rehash(probe);
+      cell.value.fetch_add(x, std::memory_order_relaxed);
+    }
+  }
+
+  void Increment() { Add(1); }
+
+  void Decrement() { Add(-1); }
+
+  int64_t Sum() const {
+    auto sum = base_.load(std::memory_order_relaxed);
+    if (const Cell *cells = cells_.load(std::memory_order_acquire)) {
+      for (size_t i = 0; i < CellCount(); ++i) {
+        sum += cells[i].value.load(std::memory_order_relaxed);
+      }
+    }
+    return sum;
+  }
+
+  // Zero the counter. Adds racing with Reset may or may not survive it.
+  void Reset() {
+    base_.store(0, std::memory_order_relaxed);
+    if (Cell *cells = cells_.load(std::memory_order_acquire)) {
+      for (size_t i = 0; i < CellCount(); ++i) {
+        cells[i].value.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+
+ private:
+  struct alignas(64) Cell {
+    std::atomic<int64_t> value{0};
+  };
+
+  static size_t CellCount() { return stripe::CellCount(); }
+
+  Cell *InitCells() {
+    auto *cells = new Cell[CellCount()];
+    Cell *expected = nullptr;
+    if (!cells_.compare_exchange_strong(expected, cells,
+                                        std::memory_order_acq_rel,
+                                        std::memory_order_acquire)) {
+      delete[] cells;
+      return expected;
+    }
+    return cells;
+  }
+
+  std::atomic<int64_t> base_{0};
+  std::atomic<Cell *> cells_{nullptr};
+};
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_STRIPED_COUNTER_HPP_
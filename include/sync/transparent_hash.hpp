@@ -0,0 +1,61 @@
+/**
+ * @file transparent_hash.hpp
+ * @brief Heterogeneous lookup for the hashed containers.
+ * As with C++20 unordered containers, a lookup may take any key type K
+ * (instead of converting it to Key first) when both the Hash and the KeyEqual
+ * a container was instantiated with declare is_transparent. Hash must then
+ * hash a K equal to a Key to the same value as that Key.
+ * @author WangJun
+ * @version 0.1
+ */
+#ifndef _JULIET_SYNC_TRANSPARENT_HASH_HPP_
+#define _JULIET_SYNC_TRANSPARENT_HASH_HPP_
+
+#if (defined __GNUC__ &&                                          \
+     ((__GNUC__ == 3 && __GNUC_MINOR__ >= 4) || __GNUC__ > 3)) || \
+    defined _MSC_VER
+#pragma once
+#endif /* __GNUC__ >= 3.4 || _MSC_VER */
+
+#include <cstddef>
+#include <functional>
+#include <string_view>
+#include <type_traits>
+
+namespace juliet::sync {
+
+/**
+ * Hash for std::string keys that also takes std::string_view and
+ * const char*, without building a std::string. Pair it with
+ * std::equal_to<>.
+ */
+struct StringHash {
+  using is_transparent = void;
+
+  size_t operator()(std::string_view s) const {
+    return std::hash<std::string_view>{}(s);
+  }
+};
+
+template <typename Hash, typename KeyEqual, typename = void>
+struct IsTransparent : std::false_type {};
+
+template <typename Hash, typename KeyEqual>
+struct IsTransparent<Hash, KeyEqual,
+                     std::void_t<typename Hash::is_transparent,
+                                 typename KeyEqual::is_transparent>>
+    : std::true_type {};
+
+/**
+ * Enables the lookup overloads taking a K other than Key, which exist only
+ * for transparent Hash and KeyEqual; Key itself goes through the const Key&
+ * overloads, which also keep implicit conversions working otherwise.
+ */
+template <typename K, typename Key, typename Hash, typename KeyEqual>
+using EnableHeterogeneous =
+    std::enable_if_t<IsTransparent<Hash, KeyEqual>::value &&
+                     !std::is_same_v<std::decay_t<K>, Key>>;
+
+}  // namespace juliet::sync
+
+#endif  // !_JULIET_SYNC_TRANSPARENT_HASH_HPP_
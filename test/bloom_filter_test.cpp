@@ -0,0 +1,45 @@
+#define CATCH_CONFIG_MAIN
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/bloom_filter.hpp"
+
+using juliet::sync::BloomFilter;
+
+TEST_CASE("BloomFilter has no false negatives across growth", "[BloomFilter]") {
+    BloomFilter<int> filter;
+    REQUIRE(filter.Empty());
+    REQUIRE_FALSE(filter.MayContain(1));
+
+    constexpr int kKeys = 100000;
+    for (int i = 0; i < kKeys; ++i)
+        filter.Add(i * 2);
+    for (int i = 0; i < kKeys; ++i)
+        REQUIRE(filter.MayContain(i * 2));
+
+    int false_positives = 0;
+    for (int i = 0; i < kKeys; ++i)
+        false_positives += filter.MayContain(i * 2 + 1);
+    // 每个block满载约0.5%，几个block叠加后仍应远低于5%
+    REQUIRE(false_positives < kKeys / 20);
+}
+
+TEST_CASE("BloomFilter lookups run alongside adds", "[BloomFilter]") {
+    BloomFilter<int> filter;
+    std::atomic_int added{0};
+    std::thread writer([&]() {
+        for (int i = 0; i < 50000; ++i) {
+            filter.Add(i);
+            added.store(i + 1, std::memory_order_release);
+        }
+    });
+    // 已发布的key必须可见
+    while (added.load(std::memory_order_acquire) < 50000) {
+        int n = added.load(std::memory_order_acquire);
+        if (n > 0)
+            REQUIRE(filter.MayContain(n - 1));
+    }
+    writer.join();
+}
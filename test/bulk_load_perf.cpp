@@ -0,0 +1,77 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/cached_map.hpp"
+#include "sync/hash_table.hpp"
+#include "sync/map.hpp"
+
+namespace {
+
+std::vector<std::pair<int, long>> Pairs(int n) {
+    std::vector<std::pair<int, long>> pairs;
+    pairs.reserve(n);
+    for (int i = 0; i < n; ++i)
+        pairs.emplace_back(i, i);
+    return pairs;
+}
+
+// 逐个写入与批量载入的启动耗时
+void Startup(int n, const std::string& label) {
+    auto pairs = Pairs(n);
+    BENCHMARK("Map<int, long> Store loop, " + label) {
+        juliet::sync::Map<int, long> m;
+        for (const auto& kv : pairs)
+            m.Store(kv.first, kv.second);
+        return m.Size();
+    };
+    BENCHMARK("Map<int, long> bulk load, " + label) {
+        juliet::sync::Map<int, long> m(pairs.begin(), pairs.end());
+        return m.Size();
+    };
+    BENCHMARK("HashTable<int, long> Put loop, " + label) {
+        juliet::sync::HashTable<int, long> t;
+        for (const auto& kv : pairs)
+            t.Put(kv.first, kv.second);
+        return t.Size();
+    };
+    BENCHMARK("HashTable<int, long> bulk load, " + label) {
+        juliet::sync::HashTable<int, long> t(pairs.begin(), pairs.end());
+        return t.Size();
+    };
+    BENCHMARK("CachedMap<int, long> Put loop, " + label) {
+        juliet::sync::CachedMap<int, long> c;
+        for (const auto& kv : pairs)
+            c.Put(kv.first, kv.second);
+        return c.Size();
+    };
+    BENCHMARK("CachedMap<int, long> bulk load, " + label) {
+        juliet::sync::CachedMap<int, long> c(pairs.begin(), pairs.end());
+        return c.Size();
+    };
+}
+
+}
+
+TEST_CASE("bulk load perf smoke", "[BulkLoad]") {
+    auto pairs = Pairs(100);
+    juliet::sync::Map<int, long> m(pairs.begin(), pairs.end());
+    REQUIRE(m.Load(99) == 99);
+}
+
+// Run with: bulk_load_perf "[!benchmark]"
+// 10M和50M分别需要约2GB和10GB内存，可以单独运行，如 bulk_load_perf "startup 10M"
+TEST_CASE("startup 1M", "[BulkLoad][!benchmark]") {
+    Startup(1000000, "1M");
+}
+
+TEST_CASE("startup 10M", "[BulkLoad][!benchmark]") {
+    Startup(10000000, "10M");
+}
+
+TEST_CASE("startup 50M", "[BulkLoad][!benchmark]") {
+    Startup(50000000, "50M");
+}
@@ -0,0 +1,130 @@
+#define CATCH_CONFIG_MAIN
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/cached_map.hpp"
+
+namespace {
+
+struct Counted {
+    static int constructed;
+
+    explicit Counted(int v) : value(v) { ++constructed; }
+    Counted(Counted&&) = default;
+    Counted(const Counted&) = delete;
+
+    int value;
+};
+
+int Counted::constructed = 0;
+
+}
+
+TEST_CASE("sync.CachedMap put and get", "[CachedMap]") {
+    juliet::sync::CachedMap<int, std::string> m;
+    std::string v;
+    REQUIRE_FALSE(m.Get(1, v));
+
+    m.Put(1, "a");
+    REQUIRE(m.Get(1) == "a");
+    m.Put(1, std::string("b"));
+    REQUIRE(m.Get(1) == "b");
+    m.TryPut(1, "c");
+    REQUIRE(m.Get(1) == "b");
+    m.Emplace(2, 2, 'x');
+    REQUIRE(m.Get(2) == "xx");
+
+    m.Remove(1);
+    REQUIRE_FALSE(m.Get(1, v));
+}
+
+TEST_CASE("sync.CachedMap try emplace constructs only on insert", "[CachedMap]") {
+    using Map = juliet::sync::CachedMap<int, Counted>;
+    Map m;
+    REQUIRE(m.TryEmplace(1, 1) == Map::EPutStatus::PUT_NEW);
+    REQUIRE(m.TryEmplace(1, 2) == Map::EPutStatus::PUT_SKIPPED);
+    REQUIRE(Counted::constructed == 1);
+    m.Remove(1);
+}
+
+TEST_CASE("sync.CachedMap cached misses see later puts", "[CachedMap]") {
+    juliet::sync::CachedMap<int, std::string> m;
+    std::string v;
+    // 缓存的miss与写表共享节点，Put之后立即可见
+    REQUIRE_FALSE(m.Get(1, v));
+    m.Put(1, "a");
+    REQUIRE(m.Get(1) == "a");
+    REQUIRE(m.Remove(1, v));
+    REQUIRE(v == "a");
+    REQUIRE_FALSE(m.Get(1, v));
+    m.Emplace(1, 2, 'b');
+    REQUIRE(m.Get(1) == "bb");
+
+    juliet::sync::CachedMap<int, std::string>::Map all;
+    m.Clear(all);
+    REQUIRE(all.size() == 1);
+    REQUIRE_FALSE(m.Get(1, v));
+}
+
+TEST_CASE("sync.CachedMap bulk load", "[CachedMap]") {
+    std::vector<std::pair<int, std::string>> pairs;
+    for (int i = 0; i < 100000; ++i)
+        pairs.emplace_back(i, std::to_string(i));
+    juliet::sync::CachedMap<int, std::string> m;
+    std::string v;
+    // 先缓存一个miss，载入后必须能看到新值
+    REQUIRE_FALSE(m.Get(7, v));
+    m.Put(-1, "old");
+    m.BulkLoad(pairs.begin(), pairs.end());
+    REQUIRE(m.Size() == 100000);
+    REQUIRE(m.Get(7) == "7");
+    REQUIRE_FALSE(m.Get(-1, v));
+    m.Put(100000, "new");
+    REQUIRE(m.Size() == 100001);
+
+    juliet::sync::CachedMap<int, std::string>::Map raw{{1, "a"}};
+    juliet::sync::CachedMap<int, std::string> moved(std::move(raw));
+    REQUIRE(raw.empty());
+    moved.Reserve(64);
+    REQUIRE(moved.Get(1) == "a");
+}
+
+TEST_CASE("sync.CachedMap drain", "[CachedMap]") {
+    juliet::sync::CachedMap<int, std::string> m;
+    for (int i = 0; i < 10; ++i)
+        m.Put(i, std::to_string(i));
+    // 读缓存里的节点随Drain一起放掉
+    REQUIRE(m.Get(3) == "3");
+    auto drained = m.Drain();
+    REQUIRE(m.Size() == 0);
+    std::string v;
+    REQUIRE_FALSE(m.Get(3, v));
+    m.Put(3, "30");
+
+    std::string all;
+    int count = 0;
+    drained.ForEach([&](const int& key, std::string&& value) {
+        REQUIRE(value == std::to_string(key));
+        all += value;
+        ++count;
+    });
+    REQUIRE(count == 10);
+    REQUIRE(all.size() == 10);
+    REQUIRE(m.Get(3) == "30");
+}
+
+TEST_CASE("sync.CachedMap heterogeneous lookup", "[CachedMap]") {
+    juliet::sync::CachedMap<std::string, int, juliet::sync::StdLockPolicy, juliet::sync::NoStats,
+                            juliet::sync::StringHash, std::equal_to<>> m;
+    m.Put("a", 1);
+    // 第一次未命中读缓存，第二次命中
+    REQUIRE(m.Get(std::string_view("a")) == 1);
+    REQUIRE(m.Get(std::string_view("a")) == 1);
+    int v = 0;
+    // 缓存的miss随后的Put可见
+    REQUIRE_FALSE(m.Get(std::string_view("b"), v));
+    m.Put("b", 2);
+    REQUIRE(m.Get("b") == 2);
+}
@@ -0,0 +1,64 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/counter_map.hpp"
+#include "sync/hash_table.hpp"
+
+namespace {
+
+constexpr int kKeys = 4096;
+constexpr int kOps = 200000;
+
+// 每个线程做kOps次自增；hot为真时一半落在同一个key上
+template<typename Increment>
+void Run(int threads, bool hot, Increment&& increment) {
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            for (int i = 0; i < kOps; ++i) {
+                int key = hot && (i & 1) ? 0 : (i * 7 + t) % kKeys;
+                increment(key);
+            }
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+}
+
+}
+
+TEST_CASE("counter map perf smoke", "[CounterMap]") {
+    juliet::sync::CounterMap<int> m;
+    Run(2, true, [&m](int key) { m.Add(key); });
+    REQUIRE(m.Get(0) > 0);
+}
+
+// Run with: counter_map_perf "[!benchmark]"
+TEST_CASE("per-key counters: locked Get+Put vs CounterMap Add", "[CounterMap][!benchmark]") {
+    for (bool hot : {false, true}) {
+        for (int threads : {1, 4, 8}) {
+            auto suffix = std::string(hot ? " hot key, " : " spread, ") + std::to_string(threads) + " threads";
+            BENCHMARK("HashTable Get+Put under a mutex" + suffix) {
+                juliet::sync::HashTable<int, long> table;
+                std::mutex mu;
+                Run(threads, hot, [&](int key) {
+                    std::lock_guard<std::mutex> guard(mu);
+                    long count = 0;
+                    table.Get(key, count);
+                    table.Put(key, count + 1);
+                });
+                return table.Size();
+            };
+            BENCHMARK("CounterMap Add" + suffix) {
+                juliet::sync::CounterMap<int> m;
+                Run(threads, hot, [&m](int key) { m.Add(key); });
+                return m.Size();
+            };
+        }
+    }
+}
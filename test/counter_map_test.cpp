@@ -0,0 +1,109 @@
+#define CATCH_CONFIG_MAIN
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/counter_map.hpp"
+
+using namespace juliet::sync;
+
+TEST_CASE("CounterMap adds in place", "[CounterMap]") {
+    CounterMap<std::string> m;
+    REQUIRE(m.Size() == 0);
+    REQUIRE(m.Get("a") == 0);
+    m.Add("a");
+    m.Add("a", 4);
+    m.Increment("b");
+    m.Add("c", -2);
+    REQUIRE(m.Get("a") == 5);
+    REQUIRE(m.Get("b") == 1);
+    REQUIRE(m.Get("c") == -2);
+    // Get不会创建key
+    REQUIRE(m.Get("d") == 0);
+    REQUIRE(m.Size() == 3);
+
+    // 反复访问后pending里的key被发布到读表，计数不变
+    for (int i = 0; i < 100; ++i)
+        m.Add("a");
+    REQUIRE(m.Get("a") == 105);
+    REQUIRE(m.Size() == 3);
+
+    auto snapshot = m.Snapshot();
+    std::unordered_map<std::string, int64_t> counts(snapshot.begin(), snapshot.end());
+    REQUIRE(counts == std::unordered_map<std::string, int64_t>{{"a", 105}, {"b", 1}, {"c", -2}});
+
+    REQUIRE(m.ResetAndGet("a") == 105);
+    REQUIRE(m.Get("a") == 0);
+    REQUIRE(m.ResetAndGet("d") == 0);
+    REQUIRE(m.Size() == 3);
+
+    // 清零全部时跳过已经为0的key
+    auto reset = m.ResetAndGet();
+    std::sort(reset.begin(), reset.end());
+    REQUIRE(reset == std::vector<std::pair<std::string, int64_t>>{{"b", 1}, {"c", -2}});
+    REQUIRE(m.Get("b") == 0);
+    REQUIRE(m.ResetAndGet().empty());
+
+    CounterMap<std::string, uint32_t, StdLockPolicy, StringHash, std::equal_to<>> transparent;
+    transparent.Add(std::string_view("x"), 2);
+    REQUIRE(transparent.Get(std::string_view("x")) == 2);
+    REQUIRE(transparent.Get("x") == 2);
+}
+
+TEST_CASE("CounterMap TopK", "[CounterMap]") {
+    CounterMap<int, int> m;
+    REQUIRE(m.TopK(3).empty());
+    for (int i = 0; i < 1000; ++i)
+        m.Add(i, (i * 7919) % 1000);
+    REQUIRE(m.TopK(0).empty());
+    auto top = m.TopK(3);
+    // 7919 mod 1000 = 919，与1000互素，计数恰好是0..999的一个排列
+    REQUIRE(top.size() == 3);
+    REQUIRE(top[0].second == 999);
+    REQUIRE(top[1].second == 998);
+    REQUIRE(top[2].second == 997);
+    REQUIRE(m.Get(top[0].first) == 999);
+    REQUIRE(m.TopK(5000).size() == 1000);
+}
+
+TEST_CASE("CounterMap concurrent adds", "[CounterMap]") {
+    constexpr int kThreads = 8;
+    constexpr int kAdds = 50000;
+    CounterMap<int> m;
+    std::atomic<int64_t> exported{0};
+    std::atomic<bool> done{false};
+    // 导出线程不断清零，已导出的加上剩余的必须等于全部增量
+    std::thread exporter([&]() {
+        while (!done) {
+            for (auto& [key, count] : m.ResetAndGet())
+                exported += count;
+            exported += m.ResetAndGet(0);
+        }
+    });
+    std::vector<std::thread> threads;
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&m, t]() {
+            for (int i = 0; i < kAdds; ++i) {
+                // 一个所有线程共享的热点key，加上不断出现的新key
+                m.Add(0);
+                m.Add(1 + (t * kAdds + i) % 5000, 2);
+            }
+        });
+    }
+    for (auto& th : threads)
+        th.join();
+    done = true;
+    exporter.join();
+
+    int64_t remaining = 0;
+    for (auto& [key, count] : m.Snapshot())
+        remaining += count;
+    REQUIRE(exported + remaining == int64_t{kThreads} * kAdds * 3);
+    REQUIRE(m.Size() == 5001);
+}
@@ -0,0 +1,67 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include "catch2/catch.hpp"
+
+#include "defer.hpp"
+
+#if defined(__GNUC__)
+#define _DEFER_PERF_NOINLINE __attribute__((noinline))
+#elif defined(_MSC_VER)
+#define _DEFER_PERF_NOINLINE __declspec(noinline)
+#else
+#define _DEFER_PERF_NOINLINE
+#endif
+
+namespace {
+
+long counter = 0;
+
+// 捕获32字节，超出std::function的小对象缓冲区
+struct Delta {
+    long a, b, c, d;
+};
+
+_DEFER_PERF_NOINLINE void Manual(Delta delta) {
+    counter += delta.a;
+    counter -= delta.a + delta.b + delta.c + delta.d;
+}
+
+_DEFER_PERF_NOINLINE void WithScopeExit(Delta delta) {
+    DEFER([delta]() { counter -= delta.a + delta.b + delta.c + delta.d; });
+    counter += delta.a;
+}
+
+_DEFER_PERF_NOINLINE void WithDeferGuard(Delta delta) {
+    DeferGuard guard([delta]() { counter -= delta.a + delta.b + delta.c + delta.d; });
+    counter += delta.a;
+}
+
+}
+
+TEST_CASE("ScopeExit stores only the callable and its flags", "[ScopeGuard]") {
+    Delta delta{1, 2, 3, 4};
+    auto lambda = [delta]() { counter += delta.a; };
+    ScopeExit guard(lambda);
+    guard.Cancel();
+    REQUIRE(sizeof(guard) == sizeof(lambda) + alignof(decltype(lambda)));
+}
+
+// Run with: defer_perf "[!benchmark]"
+TEST_CASE("scope guard overhead", "[ScopeGuard][!benchmark]") {
+    Delta delta{3, 0, 0, 1};
+
+    BENCHMARK("manual cleanup") {
+        Manual(delta);
+        return counter;
+    };
+
+    BENCHMARK("ScopeExit / DEFER") {
+        WithScopeExit(delta);
+        return counter;
+    };
+
+    BENCHMARK("DeferGuard (std::function)") {
+        WithDeferGuard(delta);
+        return counter;
+    };
+}
@@ -1,7 +1,9 @@
 #define CATCH_CONFIG_MAIN
 #include "catch2/catch.hpp"
 
-#include "Defer.hpp"
+#include <stdexcept>
+
+#include "defer.hpp"
 
 void ChangeNumber(int& val, int to) {
     DEFER([&]() { val = to; });
@@ -12,3 +14,50 @@ TEST_CASE("defer", "[lambda]") {
     ChangeNumber(a, 100);
     REQUIRE(a == 100);
 }
+
+TEST_CASE("defer guard with arguments", "[DeferGuard]") {
+    int a = 0;
+    {
+        DeferGuard guard([](int& v, int to) { v = to; }, std::ref(a), 7);
+    }
+    REQUIRE(a == 7);
+    {
+        DeferGuard guard([&a]() { a = 8; });
+        guard.Cancel();
+    }
+    REQUIRE(a == 7);
+}
+
+TEST_CASE("scope guards", "[ScopeGuard]") {
+    int exits = 0, fails = 0, successes = 0;
+    auto body = [&](bool fail) {
+        ON_SCOPE_EXIT([&]() { ++exits; });
+        ON_SCOPE_FAIL([&]() { ++fails; });
+        ON_SCOPE_SUCCESS([&]() { ++successes; });
+        if (fail)
+            throw std::runtime_error("fail");
+    };
+
+    body(false);
+    REQUIRE_THROWS(body(true));
+    REQUIRE(exits == 2);
+    REQUIRE(fails == 1);
+    REQUIRE(successes == 1);
+
+    {
+        ScopeExit guard([&]() { ++exits; });
+        ScopeExit moved(std::move(guard));
+        moved.Cancel();
+    }
+    REQUIRE(exits == 2);
+
+    // 析构发生在另一个异常的栈展开过程中，也能正确判断
+    try {
+        ScopeExit outer([&]() {
+            ScopeSuccess inner([&]() { ++successes; });
+        });
+        throw std::runtime_error("unwinding");
+    } catch (const std::runtime_error&) {
+    }
+    REQUIRE(successes == 2);
+}
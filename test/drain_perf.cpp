@@ -0,0 +1,74 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/cached_map.hpp"
+#include "sync/map.hpp"
+
+namespace {
+
+constexpr int kEntries = 200000;
+
+using StringMap = juliet::sync::Map<int, std::string>;
+
+// 64字节的值，超出SSO，复制要分配
+std::vector<std::unique_ptr<StringMap>> Filled(int count) {
+    std::vector<std::unique_ptr<StringMap>> maps;
+    for (int c = 0; c < count; ++c) {
+        maps.push_back(std::make_unique<StringMap>());
+        for (int i = 0; i < kEntries; ++i)
+            maps.back()->Store(i, std::string(64, 'v'));
+    }
+    return maps;
+}
+
+}
+
+TEST_CASE("drain perf smoke", "[Drain]") {
+    auto maps = Filled(1);
+    size_t bytes = 0;
+    maps[0]->Drain().ForEach([&bytes](const int&, std::string&& v) { bytes += v.size(); });
+    REQUIRE(bytes == kEntries * 64);
+}
+
+// Run with: drain_perf "[!benchmark]"
+TEST_CASE("hand off a table to a flusher", "[Drain][!benchmark]") {
+    // 原来的Reset(raw)：先把每个值复制进unordered_map，再整体交出
+    BENCHMARK_ADVANCED("copy out then Reset, 200K strings")(Catch::Benchmark::Chronometer meter) {
+        auto maps = Filled(meter.runs());
+        meter.measure([&maps](int i) {
+            StringMap::RawMap raw;
+            maps[i]->Range([&raw](const int& k, const std::string& v) {
+                raw.emplace(k, v);
+                return true;
+            });
+            maps[i]->Reset();
+            size_t bytes = 0;
+            for (auto& kv : raw)
+                bytes += kv.second.size();
+            return bytes;
+        });
+    };
+    BENCHMARK_ADVANCED("Reset(raw) moving values, 200K strings")(Catch::Benchmark::Chronometer meter) {
+        auto maps = Filled(meter.runs());
+        meter.measure([&maps](int i) {
+            StringMap::RawMap raw;
+            maps[i]->Reset(&raw);
+            size_t bytes = 0;
+            for (auto& kv : raw)
+                bytes += kv.second.size();
+            return bytes;
+        });
+    };
+    BENCHMARK_ADVANCED("Drain streaming, 200K strings")(Catch::Benchmark::Chronometer meter) {
+        auto maps = Filled(meter.runs());
+        meter.measure([&maps](int i) {
+            size_t bytes = 0;
+            maps[i]->Drain().ForEach([&bytes](const int&, std::string&& v) { bytes += v.size(); });
+            return bytes;
+        });
+    };
+}
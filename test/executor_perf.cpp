@@ -0,0 +1,66 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <list>
+
+#include "catch2/catch.hpp"
+#include "sync/hash_table.hpp"
+#include "sync/list.hpp"
+#include "sync/map.hpp"
+
+namespace {
+
+constexpr int kEntries = 4000000;
+
+void Add(long& result, long&& partial) {
+    result += partial;
+}
+
+}
+
+TEST_CASE("executor perf smoke", "[Executor]") {
+    juliet::sync::Executor executor;
+    juliet::sync::Map<int, long> m;
+    m.Store(1, 1);
+    REQUIRE(m.ParallelRange(executor, 0L, [](long& s, const int&, const long& v) { s += v; }, Add) == 1);
+}
+
+// Run with: executor_perf "[!benchmark]"
+TEST_CASE("aggregation: serial vs parallel iteration", "[Executor][!benchmark]") {
+    juliet::sync::Executor executor;
+    juliet::sync::Map<int, long> map;
+    juliet::sync::HashTable<int, long> table;
+    juliet::sync::List<long> list{std::list<long>()};
+    for (int i = 0; i < kEntries; ++i) {
+        map.Store(i, i);
+        table.Put(i, i);
+        list.Add(i);
+    }
+
+    BENCHMARK("Map Range sum, 4M") {
+        long sum = 0;
+        map.Range([&sum](const int&, const long& v) {
+            sum += v;
+            return true;
+        });
+        return sum;
+    };
+    BENCHMARK("Map ParallelRange sum, 4M") {
+        return map.ParallelRange(executor, 0L, [](long& s, const int&, const long& v) { s += v; }, Add);
+    };
+    BENCHMARK("HashTable ForEach sum, 4M") {
+        long sum = 0;
+        table.ForEach([&sum](const int&, const long& v) { sum += v; });
+        return sum;
+    };
+    BENCHMARK("HashTable ParallelForEach sum, 4M") {
+        return table.ParallelForEach(executor, 0L, [](long& s, const int&, const long& v) { s += v; }, Add);
+    };
+    BENCHMARK("List ForEach sum, 4M") {
+        long sum = 0;
+        list.ForEach([&sum](const long& v) { sum += v; });
+        return sum;
+    };
+    BENCHMARK("List ParallelForEach sum, 4M") {
+        return list.ParallelForEach(executor, 0L, [](long& s, const long& v) { s += v; }, Add);
+    };
+}
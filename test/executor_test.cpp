@@ -0,0 +1,80 @@
+#define CATCH_CONFIG_MAIN
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/executor.hpp"
+
+using juliet::sync::Executor;
+
+TEST_CASE("Executor ParallelFor covers the range once", "[Executor]") {
+    for (size_t workers : {0, 1, 4}) {
+        Executor executor(workers);
+        REQUIRE(executor.Slots() == workers + 1);
+        REQUIRE(executor.CurrentSlot() == workers);
+
+        constexpr size_t kN = 100000;
+        std::vector<std::atomic<int>> hits(kN);
+        // 同一slot上不会同时运行两块
+        std::vector<std::atomic<int>> busy(executor.Slots());
+        std::atomic<int> overlapped{0};
+        std::atomic<int> oversized{0};
+        // Catch的断言不是线程安全的，工作线程里只计数
+        executor.ParallelFor(0, kN, 100, [&](size_t first, size_t last, size_t slot) {
+            if (last - first > 100)
+                ++oversized;
+            if (busy[slot].fetch_add(1) != 0)
+                ++overlapped;
+            for (auto i = first; i < last; ++i)
+                ++hits[i];
+            --busy[slot];
+        });
+        REQUIRE(overlapped == 0);
+        REQUIRE(oversized == 0);
+        for (auto& h : hits)
+            REQUIRE(h == 1);
+
+        // 空区间
+        executor.ParallelFor(5, 5, 0, [](size_t, size_t, size_t) { FAIL(); });
+    }
+}
+
+TEST_CASE("Executor nested loops and reductions", "[Executor]") {
+    Executor executor(3);
+    // 嵌套的ParallelFor不会死锁
+    std::atomic<uint64_t> sum{0};
+    executor.ParallelFor(0, 64, 1, [&](size_t first, size_t last, size_t) {
+        for (auto i = first; i < last; ++i) {
+            executor.ParallelFor(0, 1000, 10, [&](size_t f, size_t l, size_t) {
+                for (auto j = f; j < l; ++j)
+                    sum += j;
+            });
+        }
+    });
+    REQUIRE(sum == 64 * (999 * 1000 / 2));
+
+    auto total = executor.ParallelReduce(
+        1, 100001, 0, uint64_t{0},
+        [](uint64_t& partial, size_t first, size_t last) {
+            for (auto i = first; i < last; ++i)
+                partial += i;
+        },
+        [](uint64_t& result, uint64_t&& partial) { result += partial; });
+    REQUIRE(total == uint64_t{100000} * 100001 / 2);
+}
+
+TEST_CASE("Executor Submit", "[Executor]") {
+    std::atomic<int> ran{0};
+    {
+        Executor executor(2);
+        for (int i = 0; i < 100; ++i)
+            executor.Submit([&ran]() { ++ran; });
+        // 析构时先执行完排队的任务
+    }
+    REQUIRE(ran == 100);
+
+    Executor inline_executor(0);
+    inline_executor.Submit([&ran]() { ++ran; });
+    REQUIRE(ran == 101);
+}
@@ -0,0 +1,65 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/hash_table.hpp"
+
+namespace {
+
+using Table = juliet::sync::HashTable<int, int>;
+using SpinTable = juliet::sync::HashTable<int, int, juliet::sync::SpinLockPolicy>;
+
+constexpr int kKeys = 4096;
+constexpr int kWrites = 400000;
+
+// writers个线程共写kWrites次，键在kKeys个里轮转，写满后都是改写
+template<typename Container>
+void Writes(Container& t, int writers) {
+    std::vector<std::thread> threads;
+    for (int n = 0; n < writers; ++n) {
+        threads.emplace_back([&t, n, writers]() {
+            for (int i = n; i < kWrites; i += writers)
+                t.Put(i % kKeys, i);
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+}
+
+}
+
+TEST_CASE("flat combining perf smoke", "[HashTable]") {
+    Table t;
+    t.EnableFlatCombining();
+    Writes(t, 4);
+    REQUIRE(t.Size() == kKeys);
+}
+
+// Run with: flat_combining_perf "[!benchmark]"
+TEST_CASE("contended Put: locked vs flat combining", "[HashTable][!benchmark]") {
+    for (int writers : {8, 32, 64}) {
+        auto suffix = ", " + std::to_string(writers) + " writers";
+        Table locked;
+        Table combined;
+        combined.EnableFlatCombining();
+        SpinTable spin_locked;
+        SpinTable spin_combined;
+        spin_combined.EnableFlatCombining();
+
+        BENCHMARK("shared_timed_mutex" + suffix) {
+            Writes(locked, writers);
+        };
+        BENCHMARK("shared_timed_mutex, flat combining" + suffix) {
+            Writes(combined, writers);
+        };
+        BENCHMARK("SharedSpinLock" + suffix) {
+            Writes(spin_locked, writers);
+        };
+        BENCHMARK("SharedSpinLock, flat combining" + suffix) {
+            Writes(spin_combined, writers);
+        };
+    }
+}
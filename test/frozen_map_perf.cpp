@@ -0,0 +1,135 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <cstdio>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/frozen_map.hpp"
+
+namespace {
+
+constexpr int kEntries = 1000000;
+constexpr int kLookups = 1000000;
+const char* kPath = "juliet_frozen_perf";
+const char* kSnapshotPath = "juliet_frozen_perf_snapshot";
+
+std::string Key(int i) {
+    return "geo:" + std::to_string(i);
+}
+
+// 一半命中一半不命中
+std::vector<int> Probes() {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> dist(0, kEntries * 2 - 1);
+    std::vector<int> probes(kLookups);
+    for (auto& p : probes)
+        p = dist(rng);
+    return probes;
+}
+
+}
+
+TEST_CASE("frozen map perf smoke", "[FrozenMap]") {
+    juliet::sync::Map<int, long> m;
+    m.Store(1, 1);
+    juliet::sync::FrozenMap<int, long> frozen(m);
+    REQUIRE(frozen.Save(kPath));
+    juliet::sync::FrozenMap<int, long> opened;
+    REQUIRE(opened.Open(kPath));
+    REQUIRE(*opened.Find(1) == 1);
+    std::remove(kPath);
+}
+
+// Run with: frozen_map_perf "[!benchmark]"
+TEST_CASE("static lookups: Map vs HashTable vs FrozenMap", "[FrozenMap][!benchmark]") {
+    auto probes = Probes();
+    juliet::sync::Map<int, long> map;
+    juliet::sync::HashTable<int, long> table;
+    for (int i = 0; i < kEntries; ++i) {
+        map.Store(i, i);
+        table.Put(i, i);
+    }
+    juliet::sync::FrozenMap<int, long> frozen(map);
+    frozen.Save(kPath);
+    juliet::sync::FrozenMap<int, long> opened;
+    opened.Open(kPath);
+
+    BENCHMARK("Map<int, long> Load, 1M probes") {
+        long sum = 0, v;
+        for (auto p : probes)
+            if (map.Load(p, &v))
+                sum += v;
+        return sum;
+    };
+    BENCHMARK("HashTable<int, long> Get, 1M probes") {
+        long sum = 0, v;
+        for (auto p : probes)
+            if (table.Get(p, v))
+                sum += v;
+        return sum;
+    };
+    BENCHMARK("FrozenMap<int, long> Find, 1M probes") {
+        long sum = 0;
+        for (auto p : probes)
+            if (auto v = frozen.Find(p))
+                sum += *v;
+        return sum;
+    };
+    BENCHMARK("FrozenMap<int, long> Find on the mmap, 1M probes") {
+        long sum = 0;
+        for (auto p : probes)
+            if (auto v = opened.Find(p))
+                sum += *v;
+        return sum;
+    };
+    BENCHMARK("FrozenMap<int, long> build from Map, 1M") {
+        return juliet::sync::FrozenMap<int, long>(map).Size();
+    };
+    std::remove(kPath);
+}
+
+TEST_CASE("static strings: startup and lookups", "[FrozenMap][!benchmark]") {
+    auto probes = Probes();
+    juliet::sync::HashTable<std::string, std::string> table;
+    for (int i = 0; i < kEntries; ++i)
+        table.Put(Key(i), std::to_string(i));
+    table.SaveSnapshot(kSnapshotPath);
+    juliet::sync::FrozenMap<std::string, std::string>(table).Save(kPath);
+    std::vector<std::string> keys;
+    keys.reserve(probes.size());
+    for (auto p : probes)
+        keys.push_back(Key(p));
+
+    BENCHMARK("HashTable<string, string> LoadSnapshot, 1M") {
+        juliet::sync::HashTable<std::string, std::string> t;
+        t.LoadSnapshot(kSnapshotPath);
+        return t.Size();
+    };
+    BENCHMARK("FrozenMap<string, string> Open, 1M") {
+        juliet::sync::FrozenMap<std::string, std::string> f;
+        f.Open(kPath);
+        return f.Size();
+    };
+
+    juliet::sync::FrozenMap<std::string, std::string> opened;
+    opened.Open(kPath);
+    BENCHMARK("HashTable<string, string> Get, 1M probes") {
+        size_t sum = 0;
+        std::string v;
+        for (const auto& key : keys)
+            if (table.Get(key, v))
+                sum += v.size();
+        return sum;
+    };
+    BENCHMARK("FrozenMap<string, string> Find on the mmap, 1M probes") {
+        size_t sum = 0;
+        for (const auto& key : keys)
+            if (auto v = opened.Find(key))
+                sum += v->size();
+        return sum;
+    };
+    std::remove(kPath);
+    std::remove(kSnapshotPath);
+}
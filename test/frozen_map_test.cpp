@@ -0,0 +1,164 @@
+#define CATCH_CONFIG_MAIN
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+#include "catch2/catch.hpp"
+#include "sync/frozen_map.hpp"
+
+using namespace juliet::sync;
+
+namespace {
+
+struct Point {
+    int x;
+    int y;
+};
+
+std::string TempPath(const char* name) {
+    return std::string("juliet_frozen_") + name;
+}
+
+}
+
+TEST_CASE("FrozenMap from Map", "[FrozenMap]") {
+    Map<int, long> m;
+    for (int i = 0; i < 10000; ++i)
+        m.Store(i, i * 3L);
+    m.Delete(5);
+
+    FrozenMap<int, long> frozen(m);
+    REQUIRE(frozen.Size() == 9999);
+    for (int i = 0; i < 10000; ++i) {
+        auto found = frozen.Find(i);
+        if (i == 5) {
+            REQUIRE_FALSE(found);
+        } else {
+            REQUIRE(found);
+            REQUIRE(*found == i * 3L);
+        }
+    }
+    // 不存在的键
+    for (int i = 10000; i < 20000; ++i)
+        REQUIRE_FALSE(frozen.Contains(i));
+
+    long v = 0;
+    REQUIRE(frozen.Load(9999, &v));
+    REQUIRE(v == 9999 * 3L);
+}
+
+TEST_CASE("FrozenMap of strings", "[FrozenMap]") {
+    HashTable<std::string, std::string> t;
+    for (int i = 0; i < 1000; ++i)
+        t.Put("key" + std::to_string(i), std::string(i % 50, 'v'));
+
+    FrozenMap<std::string, std::string> frozen(t);
+    REQUIRE(frozen.Size() == 1000);
+    // 用string_view查询，返回指向表内的string_view
+    auto found = frozen.Find(std::string_view("key49"));
+    REQUIRE(found);
+    REQUIRE(*found == std::string(49, 'v'));
+    REQUIRE(frozen.Find(std::string("key999")) == std::string_view(std::string(49, 'v')));
+    REQUIRE_FALSE(frozen.Contains("key1000"));
+    REQUIRE_FALSE(frozen.Contains(""));
+
+    std::string v;
+    REQUIRE(frozen.Load("key10", &v));
+    REQUIRE(v == std::string(10, 'v'));
+
+    size_t count = 0;
+    frozen.ForEach([&count](std::string_view key, std::string_view value) {
+        REQUIRE(key.substr(0, 3) == "key");
+        REQUIRE(value.size() == std::stoul(std::string(key.substr(3))) % 50);
+        ++count;
+    });
+    REQUIRE(count == 1000);
+}
+
+TEST_CASE("FrozenMap from unordered_map and builder", "[FrozenMap]") {
+    std::unordered_map<uint64_t, Point> raw;
+    for (uint64_t i = 0; i < 5; ++i)
+        raw.emplace(i << 40, Point{static_cast<int>(i), -static_cast<int>(i)});
+    FrozenMap<uint64_t, Point> frozen(raw);
+    REQUIRE(frozen.Size() == 5);
+    REQUIRE(frozen.Find(uint64_t{3} << 40)->y == -3);
+    REQUIRE_FALSE(frozen.Contains(3));
+
+    // 重复的键以最后一次为准
+    FrozenMap<std::string, int>::Builder builder;
+    builder.Add("a", 1);
+    builder.Add("b", 2);
+    builder.Add("a", 3);
+    auto built = builder.Build();
+    REQUIRE(built.Size() == 2);
+    REQUIRE(*built.Find("a") == 3);
+    REQUIRE(*built.Find("b") == 2);
+
+    FrozenMap<std::string, int> empty;
+    REQUIRE(empty.Size() == 0);
+    REQUIRE_FALSE(empty.Contains("a"));
+
+    // 移走后为空表
+    auto moved = std::move(built);
+    REQUIRE(moved.Size() == 2);
+    REQUIRE(built.Size() == 0);
+    REQUIRE_FALSE(built.Contains("a"));
+}
+
+TEST_CASE("FrozenMap save and open", "[FrozenMap]") {
+    auto path = TempPath("strings");
+    std::unordered_map<std::string, int> raw;
+    for (int i = 0; i < 100000; ++i)
+        raw.emplace("user:" + std::to_string(i), i);
+    {
+        FrozenMap<std::string, int> frozen(raw);
+        REQUIRE(frozen.Save(path));
+    }
+
+    FrozenMap<std::string, int> opened;
+    REQUIRE(opened.Open(path));
+    REQUIRE(opened.Size() == raw.size());
+    for (const auto& kv : raw)
+        REQUIRE(*opened.Find(kv.first) == kv.second);
+    REQUIRE_FALSE(opened.Contains("user:100000"));
+
+    // 打开的表可以再保存
+    auto copy_path = TempPath("strings_copy");
+    REQUIRE(opened.Save(copy_path));
+    FrozenMap<std::string, int> copy;
+    REQUIRE(copy.Open(copy_path));
+    REQUIRE(*copy.Find("user:42") == 42);
+    std::remove(path.c_str());
+    std::remove(copy_path.c_str());
+}
+
+TEST_CASE("FrozenMap rejects bad files", "[FrozenMap]") {
+    auto path = TempPath("bad");
+    FrozenMap<int, int> frozen;
+    REQUIRE_FALSE(frozen.Open(path + ".missing"));
+
+    std::unordered_map<int, int> raw{{1, 10}, {2, 20}};
+    REQUIRE(FrozenMap<int, int>(raw).Save(path));
+
+    // 类型不符
+    FrozenMap<int, std::string> other;
+    REQUIRE_FALSE(other.Open(path));
+    FrozenMap<int, long> wider;
+    REQUIRE_FALSE(wider.Open(path));
+
+    // 截断，原内容不变
+    std::string bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size() - 1));
+    }
+    FrozenMap<int, int> loaded(std::unordered_map<int, int>{{7, 7}});
+    REQUIRE_FALSE(loaded.Open(path));
+    REQUIRE(*loaded.Find(7) == 7);
+    std::remove(path.c_str());
+}
@@ -0,0 +1,154 @@
+#define CATCH_CONFIG_MAIN
+#include <atomic>
+#include <memory>
+#include <string>
+#include <stdexcept>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/hash_table.hpp"
+
+using juliet::sync::HashTable;
+
+TEST_CASE("sync.HashTable put and get", "[HashTable]") {
+    HashTable<int, std::string> t;
+    REQUIRE(t.Put(1, "a") == HashTable<int, std::string>::PUT_NEW);
+    REQUIRE(t.Put(1, std::string("b")) == HashTable<int, std::string>::PUT_OVERWRITE);
+    REQUIRE(t.TryPut(1, "c") == HashTable<int, std::string>::PUT_SKIPPED);
+    REQUIRE(t.Get(1) == "b");
+
+    REQUIRE(t.Emplace(2, 3, 'x') == HashTable<int, std::string>::PUT_NEW);
+    REQUIRE(t.Emplace(2, 2, 'y') == HashTable<int, std::string>::PUT_OVERWRITE);
+    REQUIRE(t.TryEmplace(2, 1, 'z') == HashTable<int, std::string>::PUT_SKIPPED);
+    REQUIRE(t.Get(2) == "yy");
+
+    t.Remove(2);
+    std::string v;
+    REQUIRE_FALSE(t.Get(2, v));
+}
+
+TEST_CASE("sync.HashTable move-only values", "[HashTable]") {
+    using Table = HashTable<int, std::unique_ptr<int>>;
+    Table t;
+    REQUIRE(t.Put(1, std::make_unique<int>(1)) == Table::PUT_NEW);
+    REQUIRE(t.TryEmplace(1, new int(2)) == Table::PUT_SKIPPED);
+    REQUIRE(t.Emplace(1, new int(3)) == Table::PUT_OVERWRITE);
+
+    std::unique_ptr<int> out;
+    REQUIRE(t.Remove(1, out));
+    REQUIRE(*out == 3);
+}
+
+TEST_CASE("sync.HashTable bulk load", "[HashTable]") {
+    std::vector<std::pair<int, std::string>> pairs{{1, "a"}, {2, "b"}, {1, "c"}};
+    HashTable<int, std::string> t(pairs.begin(), pairs.end());
+    // 重复的键以最后一次为准
+    REQUIRE(t.Size() == 2);
+    REQUIRE(t.Get(1) == "c");
+
+    HashTable<int, std::string>::Map m{{3, "x"}};
+    t.Reserve(100);
+    t.BulkLoad(std::move(m));
+    REQUIRE(m.empty());
+    REQUIRE(t.Size() == 1);
+    REQUIRE(t.Get(3) == "x");
+    std::string v;
+    REQUIRE_FALSE(t.Get(1, v));
+}
+
+TEST_CASE("sync.HashTable parallel ForEach", "[HashTable]") {
+    HashTable<int, int> t;
+    for (int i = 0; i < 10000; ++i)
+        t.Put(i, i);
+    juliet::sync::Executor executor(3);
+
+    std::atomic<long> sum{0};
+    t.ParallelForEach(executor, [&sum](const int&, const int& v) { sum += v; });
+    REQUIRE(sum == 9999L * 10000 / 2);
+
+    auto total = t.ParallelForEach(executor, 0L,
+        [](long& partial, const int&, const int& v) { partial += v; },
+        [](long& result, long&& partial) { result += partial; });
+    REQUIRE(total == 9999L * 10000 / 2);
+}
+
+TEST_CASE("sync.HashTable heterogeneous lookup", "[HashTable]") {
+    using StringTable = HashTable<std::string, int, juliet::sync::StdLockPolicy, juliet::sync::NoStats,
+                                  juliet::sync::StringHash, std::equal_to<>>;
+    StringTable t;
+    t.Put(std::string(40, 'k'), 1);
+    t.Put("short", 2);
+    std::string long_key(40, 'k');
+    REQUIRE(t.Get(std::string_view(long_key)) == 1);
+    REQUIRE(t.Get("short") == 2);
+    int v = 0;
+    REQUIRE_FALSE(t.Get(std::string_view("missing"), v));
+    // 普通的Hash仍然可以隐式转换成Key查找
+    HashTable<std::string, int> plain;
+    plain.Put("a", 1);
+    REQUIRE(plain.Get("a") == 1);
+}
+
+TEST_CASE("sync.HashTable flat combining", "[HashTable]") {
+    using Table = HashTable<int, std::string>;
+    Table t;
+    t.EnableFlatCombining();
+    REQUIRE(t.Put(1, "a") == Table::PUT_NEW);
+    REQUIRE(t.Put(1, std::string("b")) == Table::PUT_OVERWRITE);
+    REQUIRE(t.TryPut(1, "c") == Table::PUT_SKIPPED);
+    REQUIRE(t.Emplace(2, 3, 'x') == Table::PUT_NEW);
+    REQUIRE(t.TryEmplace(2, 1, 'z') == Table::PUT_SKIPPED);
+    REQUIRE(t.Get(1) == "b");
+    REQUIRE(t.Get(2) == "xxx");
+
+    std::string v;
+    REQUIRE(t.Remove(2, v));
+    REQUIRE(v == "xxx");
+    t.Remove(1);
+    REQUIRE(t.Size() == 0);
+
+    // 由其他线程代为执行时抛出的异常，在发布它的线程重新抛出
+    struct Throwing {
+        Throwing() = default;
+        explicit Throwing(bool) { throw std::runtime_error("construct"); }
+    };
+    HashTable<int, Throwing> throwing;
+    throwing.EnableFlatCombining();
+    REQUIRE_THROWS_AS(throwing.Emplace(1, true), std::runtime_error);
+    REQUIRE(throwing.Size() == 0);
+    REQUIRE(throwing.Emplace(1) == HashTable<int, Throwing>::PUT_NEW);
+}
+
+TEST_CASE("sync.HashTable flat combining concurrent writers", "[HashTable]") {
+    HashTable<int, int> t;
+    t.EnableFlatCombining();
+    // 比槽位数多，有线程会退回直接加锁
+    constexpr int kThreads = 80;
+    constexpr int kKeys = 200;
+    std::atomic<int> failures{0};
+    std::vector<std::thread> threads;
+    for (int n = 0; n < kThreads; ++n) {
+        threads.emplace_back([&, n] {
+            for (int i = 0; i < kKeys; ++i) {
+                auto key = n * kKeys + i;
+                if (t.Put(key, i) != HashTable<int, int>::PUT_NEW)
+                    ++failures;
+                if (i % 2 == 0) {
+                    int v = -1;
+                    if (!t.Remove(key, v) || v != i)
+                        ++failures;
+                }
+            }
+        });
+    }
+    for (auto& thread : threads)
+        thread.join();
+    REQUIRE(failures == 0);
+    REQUIRE(t.Size() == kThreads * kKeys / 2);
+    int v = 0;
+    REQUIRE(t.Get(kKeys + 1, v));
+    REQUIRE(v == 1);
+    REQUIRE_FALSE(t.Get(kKeys, v));
+}
@@ -0,0 +1,85 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/cached_map.hpp"
+#include "sync/map.hpp"
+
+namespace {
+
+constexpr int kKeys = 1024;
+constexpr int kReads = 200000;
+
+// 每个线程kReads次读，九成落在key 0上
+template<typename Read>
+size_t SkewedReads(int threads, Read&& read) {
+    std::atomic<size_t> total{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            size_t local = 0;
+            for (int i = 0; i < kReads; ++i) {
+                int key = i % 10 != 0 ? 0 : (i * 7 + t) % kKeys;
+                local += read(key).size();
+            }
+            total += local;
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    return total;
+}
+
+template<typename Container>
+void Fill(Container& m) {
+    for (int i = 0; i < kKeys; ++i)
+        m.Put(i, std::string(32, 'a' + i % 26));
+}
+
+}
+
+TEST_CASE("hot keys perf smoke", "[HotKeys]") {
+    juliet::sync::Map<int, std::string> m;
+    m.TrackHotKeys();
+    m.Store(0, "x");
+    REQUIRE(SkewedReads(2, [&m](int key) { return m.Load(key); }) > 0);
+}
+
+// Run with: hot_keys_perf "[!benchmark]"
+TEST_CASE("skewed reads: plain vs hot key replicas", "[HotKeys][!benchmark]") {
+    juliet::sync::Map<int, std::string> map;
+    juliet::sync::Map<int, std::string> tracked_map;
+    tracked_map.TrackHotKeys();
+    juliet::sync::CachedMap<int, std::string> cached;
+    juliet::sync::CachedMap<int, std::string> tracked_cached;
+    tracked_cached.TrackHotKeys();
+    for (int i = 0; i < kKeys; ++i) {
+        map.Store(i, std::string(32, 'a' + i % 26));
+        tracked_map.Store(i, std::string(32, 'a' + i % 26));
+    }
+    Fill(cached);
+    Fill(tracked_cached);
+    // 先读一轮，让热点被认出并建好副本
+    SkewedReads(1, [&](int key) { return tracked_map.Load(key); });
+    SkewedReads(1, [&](int key) { return tracked_cached.Get(key); });
+
+    for (int threads : {1, 4, 8}) {
+        auto suffix = ", " + std::to_string(threads) + " threads";
+        BENCHMARK("Map" + suffix) {
+            return SkewedReads(threads, [&](int key) { return map.Load(key); });
+        };
+        BENCHMARK("Map with hot keys" + suffix) {
+            return SkewedReads(threads, [&](int key) { return tracked_map.Load(key); });
+        };
+        BENCHMARK("CachedMap" + suffix) {
+            return SkewedReads(threads, [&](int key) { return cached.Get(key); });
+        };
+        BENCHMARK("CachedMap with hot keys" + suffix) {
+            return SkewedReads(threads, [&](int key) { return tracked_cached.Get(key); });
+        };
+    }
+}
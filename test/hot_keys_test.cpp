@@ -0,0 +1,161 @@
+#define CATCH_CONFIG_MAIN
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/cached_map.hpp"
+#include "sync/hot_keys.hpp"
+#include "sync/map.hpp"
+
+using namespace juliet::sync;
+
+namespace {
+
+// 每次读都抽样，阈值低，便于测试中很快认出热点
+HotKeyOptions EagerOptions() {
+    HotKeyOptions options;
+    options.capacity = 2;
+    options.sample_interval = 1;
+    options.threshold = 8;
+    return options;
+}
+
+// 读key直到它有副本；arm要等epoch前进，需要多读一些次
+template<typename Read, typename Container>
+bool ReadUntilReplicated(Container& m, int key, Read&& read) {
+    for (int i = 0; i < 100000; ++i) {
+        read(key);
+        auto hot = m.HotKeys();
+        if (!hot.empty() && hot[0].key == key && hot[0].replicated)
+            return true;
+    }
+    return false;
+}
+
+}
+
+TEST_CASE("CountMinSketch never undercounts", "[HotKeys]") {
+    CountMinSketch sketch(64);
+    std::unordered_map<size_t, uint32_t> truth;
+    for (size_t i = 0; i < 5000; ++i) {
+        // 少数key很热，其余是长尾
+        size_t key = i % 3 == 0 ? i % 4 : i;
+        auto estimate = sketch.Add(std::hash<size_t>{}(key));
+        ++truth[key];
+        REQUIRE(estimate >= truth[key]);
+    }
+    for (auto& [key, count] : truth)
+        REQUIRE(sketch.Estimate(std::hash<size_t>{}(key)) >= count);
+    REQUIRE(sketch.Estimate(std::hash<size_t>{}(0)) < 2 * truth[0]);
+
+    sketch.Halve();
+    REQUIRE(sketch.Estimate(std::hash<size_t>{}(0)) >= truth[0] / 2);
+}
+
+TEST_CASE("sync.Map hot keys are replicated and invalidated on write", "[HotKeys][Map]") {
+    Map<int, std::string> m;
+    REQUIRE(m.HotKeys().empty());
+    m.TrackHotKeys(EagerOptions());
+    for (int i = 0; i < 100; ++i)
+        m.Store(i, std::to_string(i));
+
+    // 长尾key偶尔读一次，不会成为热点
+    for (int i = 0; i < 100; ++i)
+        REQUIRE(m.Load(i) == std::to_string(i));
+    REQUIRE(m.HotKeys().empty());
+
+    REQUIRE(ReadUntilReplicated(m, 7, [&m](int key) { REQUIRE(m.Load(key) == "7"); }));
+    auto hot = m.HotKeys();
+    REQUIRE(hot.size() == 1);
+    REQUIRE(hot[0].reads >= 8);
+
+    // 写入使副本失效，之后的读立即看到新值
+    m.Store(7, "seven");
+    REQUIRE(m.Load(7) == "seven");
+    REQUIRE(ReadUntilReplicated(m, 7, [&m](int key) { REQUIRE(m.Load(key) == "seven"); }));
+    REQUIRE(m.CompareAndSwap(7, "seven", "7!"));
+    REQUIRE(m.Load(7) == "7!");
+    REQUIRE(ReadUntilReplicated(m, 7, [&m](int key) { REQUIRE(m.Load(key) == "7!"); }));
+    m.Delete(7);
+    std::string value;
+    REQUIRE_FALSE(m.Load(7, &value));
+    m.Store(7, "back");
+    REQUIRE(ReadUntilReplicated(m, 7, [&m](int key) { REQUIRE(m.Load(key) == "back"); }));
+
+    // 整体替换内容也使副本失效
+    m.BulkLoad(Map<int, std::string>::RawMap{{7, "bulk"}});
+    REQUIRE(m.Load(7) == "bulk");
+    REQUIRE(ReadUntilReplicated(m, 7, [&m](int key) { REQUIRE(m.Load(key) == "bulk"); }));
+    m.Reset();
+    REQUIRE_FALSE(m.Load(7, &value));
+
+    // 容量为2：更热的key挤掉较冷的
+    m.Store(1, "1");
+    m.Store(2, "2");
+    m.Store(3, "3");
+    for (int i = 0; i < 200; ++i) {
+        m.Load(1);
+        m.Load(2);
+    }
+    for (int i = 0; i < 1000; ++i)
+        m.Load(3);
+    hot = m.HotKeys();
+    REQUIRE(hot.size() == 2);
+    REQUIRE(hot[0].key == 3);
+}
+
+TEST_CASE("sync.CachedMap hot keys are replicated and invalidated on write", "[HotKeys][CachedMap]") {
+    CachedMap<int, std::string> m;
+    m.TrackHotKeys(EagerOptions());
+    m.Put(5, "5");
+    REQUIRE(ReadUntilReplicated(m, 5, [&m](int key) { REQUIRE(m.Get(key) == "5"); }));
+    m.Put(5, "five");
+    REQUIRE(m.Get(5) == "five");
+    REQUIRE(ReadUntilReplicated(m, 5, [&m](int key) { REQUIRE(m.Get(key) == "five"); }));
+    m.Remove(5);
+    std::string value;
+    REQUIRE_FALSE(m.Get(5, value));
+    m.Put(5, "again");
+    REQUIRE(ReadUntilReplicated(m, 5, [&m](int key) { REQUIRE(m.Get(key) == "again"); }));
+    m.Clear();
+    REQUIRE_FALSE(m.Get(5, value));
+}
+
+TEST_CASE("sync.Map hot key reads never go back in time", "[HotKeys][Map]") {
+    Map<int, long> m;
+    m.TrackHotKeys(EagerOptions());
+    m.Store(0, 0);
+    constexpr long kWrites = 20000;
+    std::atomic<bool> done{false};
+    std::atomic<int> regressions{0};
+    std::atomic<long> committed{0};
+    // 读者看到的值不能比读之前已经完成的写更旧，也不能倒退
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; ++t) {
+        readers.emplace_back([&, t]() {
+            long last = 0;
+            while (!done) {
+                auto floor = committed.load();
+                auto v = m.Load(0);
+                if (v < last || v < floor)
+                    ++regressions;
+                last = v;
+                m.Load(1 + t);
+            }
+        });
+    }
+    for (long i = 1; i <= kWrites; ++i) {
+        m.Store(0, i);
+        committed = i;
+        if (i % 64 == 0)
+            std::this_thread::yield();
+    }
+    done = true;
+    for (auto& th : readers)
+        th.join();
+    REQUIRE(regressions == 0);
+    REQUIRE(m.Load(0) == kWrites);
+}
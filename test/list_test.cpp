@@ -0,0 +1,46 @@
+#define CATCH_CONFIG_MAIN
+#include <atomic>
+#include <list>
+#include <memory>
+
+#include "catch2/catch.hpp"
+#include "sync/list.hpp"
+
+TEST_CASE("sync.List add move-only values", "[List]") {
+    juliet::sync::List<std::unique_ptr<int>> l{std::list<std::unique_ptr<int>>()};
+    l.Add(std::make_unique<int>(1));
+    l.Emplace(new int(2));
+    l.Emplace(new int(3));
+
+    int sum = 0;
+    l.ForEach([&sum](const std::unique_ptr<int>& v) { sum += *v; });
+    REQUIRE(sum == 6);
+
+    l.Emplace(new int(4));
+    REQUIRE(l.ForEachRemove([](const std::unique_ptr<int>& v) { return *v % 2 == 0; }) == 2);
+    sum = 0;
+    l.ForEach([&sum](const std::unique_ptr<int>& v) { sum += *v; });
+    REQUIRE(sum == 6);
+}
+
+TEST_CASE("sync.List parallel ForEach", "[List]") {
+    juliet::sync::List<int> l{std::list<int>()};
+    for (int i = 1; i <= 10000; ++i)
+        l.Add(i);
+    juliet::sync::Executor executor(3);
+
+    std::atomic<long> sum{0};
+    l.ParallelForEach(executor, [&sum](const int& v) { sum += v; });
+    REQUIRE(sum == 10000L * 10001 / 2);
+
+    // 按线程归约
+    auto total = l.ParallelForEach(executor, 0L,
+        [](long& partial, const int& v) { partial += v; },
+        [](long& result, long&& partial) { result += partial; });
+    REQUIRE(total == 10000L * 10001 / 2);
+
+    juliet::sync::List<int> empty{std::list<int>()};
+    REQUIRE(empty.ParallelForEach(executor, 0L,
+        [](long& partial, const int& v) { partial += v; },
+        [](long& result, long&& partial) { result += partial; }) == 0);
+}
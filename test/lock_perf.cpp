@@ -0,0 +1,54 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/lock.hpp"
+#include "sync/parking_lot.hpp"
+
+using namespace juliet::sync;
+
+namespace {
+
+constexpr int kOpsPerThread = 20000;
+
+// 每次加锁只做一次自增，测的是加锁/解锁和锁所在缓存行的开销
+template<typename Lock>
+long Contend(Lock& mu, int threads) {
+    long counter = 0;
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&]() {
+            for (int i = 0; i < kOpsPerThread; ++i) {
+                std::lock_guard<Lock> guard(mu);
+                ++counter;
+            }
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    return counter;
+}
+
+}
+
+TEST_CASE("lock matrix smoke", "[Lock]") {
+    SpinLock mu;
+    REQUIRE(Contend(mu, 2) == 2 * kOpsPerThread);
+}
+
+// Run with: lock_perf "[!benchmark]"
+TEMPLATE_TEST_CASE("lock matrix", "[Lock][!benchmark]",
+                   std::mutex, std::shared_timed_mutex, SpinLock, TicketLock, McsLock,
+                   AdaptiveMutex, SharedSpinLock, ByteLock) {
+    for (int threads : {1, 2, 4, 8}) {
+        TestType mu;
+        BENCHMARK(std::to_string(threads) + " threads") {
+            return Contend(mu, threads);
+        };
+    }
+}
@@ -0,0 +1,88 @@
+#define CATCH_CONFIG_MAIN
+#include <mutex>
+#include <shared_mutex>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/cached_map.hpp"
+#include "sync/hash_table.hpp"
+#include "sync/list.hpp"
+#include "sync/lock.hpp"
+#include "sync/lock_policy.hpp"
+#include "sync/map.hpp"
+
+using namespace juliet::sync;
+
+TEMPLATE_TEST_CASE("locks provide mutual exclusion", "[Lock]",
+                   SpinLock, TicketLock, McsLock, AdaptiveMutex, SharedSpinLock, ByteLock) {
+    TestType mu;
+    long counter = 0;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 10000; ++i) {
+                std::lock_guard<TestType> guard(mu);
+                ++counter;
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    REQUIRE(counter == 40000);
+
+    REQUIRE(mu.try_lock());
+    REQUIRE_FALSE(mu.try_lock());
+    mu.unlock();
+}
+
+TEST_CASE("SharedSpinLock readers and writers", "[Lock]") {
+    SharedSpinLock mu;
+    mu.lock_shared();
+    REQUIRE(mu.try_lock_shared());
+    REQUIRE_FALSE(mu.try_lock());
+    mu.unlock_shared();
+    mu.unlock_shared();
+    REQUIRE(mu.try_lock());
+    REQUIRE_FALSE(mu.try_lock_shared());
+    mu.unlock();
+}
+
+TEMPLATE_TEST_CASE("containers accept lock policies", "[LockPolicy]",
+                   StdLockPolicy, SpinLockPolicy, TicketLockPolicy, McsLockPolicy, AdaptiveLockPolicy,
+                   CompactLockPolicy) {
+    Map<int, int, TestType> m;
+    HashTable<int, int, TestType> t;
+    CachedMap<int, int, TestType> c;
+    List<int, TestType> l{std::list<int>()};
+
+    std::vector<std::thread> threads;
+    for (int n = 0; n < 4; ++n) {
+        threads.emplace_back([&, n]() {
+            for (int i = 0; i < 1000; ++i) {
+                m.Store(i, n);
+                t.Put(i, n);
+                c.Put(i, n);
+                l.Add(i);
+                int v;
+                m.Load(i, &v);
+                t.Get(i, v);
+                c.Get(i, v);
+            }
+        });
+    }
+    for (auto& th : threads)
+        th.join();
+
+    int count = 0;
+    m.Range([&count](const int&, const int&) { return ++count; });
+    REQUIRE(count == 1000);
+    count = 0;
+    t.ForEach([&count](const int&, const int&) { ++count; });
+    REQUIRE(count == 1000);
+    count = 0;
+    l.ForEach([&count](const int&) { ++count; });
+    REQUIRE(count == 4000);
+    int v;
+    REQUIRE(c.Get(999, v));
+}
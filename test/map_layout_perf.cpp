@@ -0,0 +1,135 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <atomic>
+#include <cstddef>
+#include <cstdlib>
+#include <iostream>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/cached_map.hpp"
+#include "sync/map.hpp"
+
+namespace {
+
+std::atomic_long allocations{0};
+std::atomic_long allocated_bytes{0};
+
+struct AllocScope {
+    long count = allocations.load();
+    long bytes = allocated_bytes.load();
+
+    long Count() const { return allocations.load() - count; }
+    long Bytes() const { return allocated_bytes.load() - bytes; }
+};
+
+constexpr int kEntries = 100000;
+
+std::string KeyOf(int i) {
+    return "key-" + std::to_string(i);
+}
+
+}
+
+// 每块前面记录大小，统计的是存活字节数（扩容时释放的旧表不计入）
+void* operator new(std::size_t size) {
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    allocated_bytes.fetch_add(static_cast<long>(size), std::memory_order_relaxed);
+    if (auto* p = static_cast<std::max_align_t*>(std::malloc(size + sizeof(std::max_align_t)))) {
+        *reinterpret_cast<std::size_t*>(p) = size;
+        return p + 1;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+    if (p == nullptr)
+        return;
+    auto* block = static_cast<std::max_align_t*>(p) - 1;
+    allocated_bytes.fetch_sub(static_cast<long>(*reinterpret_cast<std::size_t*>(block)),
+                              std::memory_order_relaxed);
+    std::free(block);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    operator delete(p);
+}
+
+TEST_CASE("entry layout: allocations and bytes per insert", "[Layout]") {
+    std::vector<std::string> keys;
+    for (int i = 0; i < kEntries; ++i)
+        keys.push_back(KeyOf(i));
+    const std::string value(24, 'v');
+
+    {
+        juliet::sync::Map<std::string, std::string> m;
+        AllocScope scope;
+        for (const auto& key : keys)
+            m.Store(key, value);
+        // 提升到read之后的稳定状态
+        m.Range([](const std::string&, const std::string&) { return false; });
+        std::cout << "Map<string, string>: " << static_cast<double>(scope.Count()) / kEntries
+                  << " allocations/insert, " << scope.Bytes() / kEntries << " live bytes/entry" << std::endl;
+    }
+    {
+        juliet::sync::Map<std::string, std::string, juliet::sync::CompactLockPolicy> m;
+        AllocScope scope;
+        for (const auto& key : keys)
+            m.Store(key, value);
+        m.Range([](const std::string&, const std::string&) { return false; });
+        std::cout << "Map<string, string, CompactLockPolicy>: " << static_cast<double>(scope.Count()) / kEntries
+                  << " allocations/insert, " << scope.Bytes() / kEntries << " live bytes/entry" << std::endl;
+    }
+    {
+        juliet::sync::Map<std::string, long> m;
+        AllocScope scope;
+        for (const auto& key : keys)
+            m.Store(key, 1);
+        m.Range([](const std::string&, const long&) { return false; });
+        std::cout << "Map<string, long>: " << static_cast<double>(scope.Count()) / kEntries
+                  << " allocations/insert, " << scope.Bytes() / kEntries << " live bytes/entry" << std::endl;
+    }
+    {
+        juliet::sync::CachedMap<std::string, std::string> m;
+        AllocScope scope;
+        std::string out;
+        for (const auto& key : keys) {
+            m.Put(key, value);
+            m.Get(key, out);
+        }
+        std::cout << "CachedMap<string, string> (put + cached get): "
+                  << static_cast<double>(scope.Count()) / kEntries << " allocations/insert, "
+                  << scope.Bytes() / kEntries << " live bytes/entry" << std::endl;
+    }
+}
+
+// Run with: map_layout_perf "[!benchmark]"
+TEST_CASE("entry layout: lookup latency", "[Layout][!benchmark]") {
+    std::vector<std::string> keys;
+    for (int i = 0; i < kEntries; ++i)
+        keys.push_back(KeyOf(i));
+    const std::string value(24, 'v');
+
+    juliet::sync::Map<std::string, std::string> m;
+    juliet::sync::CachedMap<std::string, std::string> c;
+    for (const auto& key : keys) {
+        m.Store(key, value);
+        c.Put(key, value);
+    }
+    m.Range([](const std::string&, const std::string&) { return false; });
+    std::string out;
+    for (const auto& key : keys)
+        c.Get(key, out);
+
+    size_t i = 0;
+    BENCHMARK("Map::Load hit") {
+        i = (i + 7919) % keys.size();
+        return m.Load(keys[i], &out);
+    };
+    BENCHMARK("CachedMap::Get hit") {
+        i = (i + 7919) % keys.size();
+        return c.Get(keys[i], out);
+    };
+}
@@ -1,13 +1,351 @@
 #define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
 #include <atomic>
 #include <iostream>
 #include <map>
+#include <string>
+#include <string_view>
 #include <thread>
 #include <unordered_map>
+#include <vector>
 
 #include "catch2/catch.hpp"
 #include "sync/cached_map.hpp"
 #include "sync/hash_table.hpp"
 #include "sync/map.hpp"
 
+namespace {
+
+// Stands in for a parsed config or compiled regex: costly to build.
+std::vector<std::string> ExpensiveValue(int key) {
+    std::vector<std::string> value;
+    value.reserve(32);
+    for (int i = 0; i < 32; ++i) {
+        value.emplace_back(std::to_string(key * 31 + i) + std::string(48, 'v'));
+    }
+    return value;
+}
+
+constexpr int kKeys = 1024;
+
+// 不可平凡复制，强制走shared_ptr + 锁的Entry，作为对照组
+struct BoxedInt {
+    BoxedInt() = default;
+    BoxedInt(int v) : value(v) {}
+    BoxedInt(const BoxedInt& o) : value(o.value) {}
+    BoxedInt& operator=(const BoxedInt& o) {
+        value = o.value;
+        return *this;
+    }
+
+    int value = 0;
+};
+
+int ToInt(int v) { return v; }
+
+int ToInt(const BoxedInt& v) { return v.value; }
+
+// 每个线程对kKeys个key做一半Load一半Store
+template<typename Map>
+long LoadStoreMix(Map& m, int threads, int ops) {
+    std::atomic_long sum{0};
+    std::vector<std::thread> workers;
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&, t]() {
+            long local = 0;
+            for (int i = 0; i < ops; ++i) {
+                int key = (i * 7 + t) % kKeys;
+                if (i & 1) {
+                    m.Store(key, i);
+                } else {
+                    local += ToInt(m.Load(key));
+                }
+            }
+            sum += local;
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    return sum;
+}
+
+}
+
 TEST_CASE("sync.Map", "[Map]") {}
+
+// Run with: map_perf "[!benchmark]"
+TEST_CASE("sync.Map LoadOrStore vs LoadOrCompute, hit-heavy", "[Map][!benchmark]") {
+    juliet::sync::Map<int, std::vector<std::string>> m;
+    for (int i = 0; i < kKeys; ++i) {
+        m.Store(i, ExpensiveValue(i));
+    }
+    // Promote dirty to read so hits stay on the lock-free read path.
+    m.Range([](const int&, const std::vector<std::string>&) { return false; });
+
+    BENCHMARK("LoadOrStore (value built on every call)") {
+        std::vector<std::string> actual;
+        size_t n = 0;
+        for (int i = 0; i < kKeys; ++i) {
+            m.LoadOrStore(i, ExpensiveValue(i), &actual);
+            n += actual.size();
+        }
+        return n;
+    };
+
+    BENCHMARK("LoadOrCompute (value built on miss only)") {
+        size_t n = 0;
+        for (int i = 0; i < kKeys; ++i) {
+            n += m.LoadOrCompute(i, [i]() { return ExpensiveValue(i); }).first->size();
+        }
+        return n;
+    };
+}
+
+// Run with: map_perf "[!benchmark]"
+TEST_CASE("sync.Map int-to-int 50/50 load/store", "[Map][!benchmark]") {
+    juliet::sync::Map<int, int> inline_map;
+    juliet::sync::Map<int, BoxedInt> boxed_map;
+    for (int i = 0; i < kKeys; ++i) {
+        inline_map.Store(i, i);
+        boxed_map.Store(i, i);
+    }
+    inline_map.Range([](const int&, const int&) { return false; });
+    boxed_map.Range([](const int&, const BoxedInt&) { return false; });
+
+    for (int threads : {1, 4}) {
+        BENCHMARK("inline entry, " + std::to_string(threads) + " threads") {
+            return LoadStoreMix(inline_map, threads, 20000);
+        };
+        BENCHMARK("shared_ptr entry, " + std::to_string(threads) + " threads") {
+            return LoadStoreMix(boxed_map, threads, 20000);
+        };
+    }
+}
+
+// Run with: map_perf "[!benchmark]"
+TEST_CASE("sync.Map negative lookups among inserts", "[Map][!benchmark]") {
+    for (int threads : {1, 4}) {
+        // 1 insert of a new key per 16 lookups of absent keys: read stays amended.
+        BENCHMARK_ADVANCED("absent keys, " + std::to_string(threads) + " threads")(Catch::Benchmark::Chronometer meter) {
+            juliet::sync::Map<int, int> m;
+            for (int i = 0; i < kKeys; ++i) {
+                m.Store(i, i);
+            }
+            m.Range([](const int&, const int&) { return false; });
+            std::atomic_int next_key{kKeys};
+            meter.measure([&]() {
+                std::atomic_long found{0};
+                std::vector<std::thread> workers;
+                for (int t = 0; t < threads; ++t) {
+                    workers.emplace_back([&, t]() {
+                        int v;
+                        long local = 0;
+                        for (int i = 0; i < 20000; ++i) {
+                            if (i % 16 == 0) {
+                                m.Store(next_key++, i);
+                            } else {
+                                local += m.Load(-1 - t * 20000 - i, &v);
+                            }
+                        }
+                        found += local;
+                    });
+                }
+                for (auto& w : workers)
+                    w.join();
+                return found.load();
+            });
+        };
+    }
+}
+
+namespace {
+
+// 插入burst个新key，再读这批key共lookups次
+template<typename Map>
+long BurstLookups(Map& m, int base, int burst, int lookups) {
+    long sum = 0;
+    int v;
+    for (int i = 0; i < burst; ++i)
+        m.Store(base + i, i);
+    for (int i = 0; i < lookups; ++i)
+        sum += m.Load(base + i % burst, &v);
+    return sum;
+}
+
+}
+
+// Run with: map_perf "[!benchmark]"
+TEST_CASE("sync.Map promotion policy on a large map", "[Map][!benchmark]") {
+    using juliet::sync::StdLockPolicy;
+    constexpr int kLarge = 1 << 16;
+    juliet::sync::Map<int, int, StdLockPolicy, juliet::sync::GoPromotion> go;
+    juliet::sync::Map<int, int, StdLockPolicy, juliet::sync::AdaptivePromotion> adaptive;
+    auto print = [](const char* name, const juliet::sync::PromotionStats& s) {
+        std::cout << name << ": " << s.misses << " misses, " << s.promotions << " promotions, "
+                  << s.rebuild_time.count() / 1000000 << " ms rebuilding\n";
+    };
+    for (int i = 0; i < kLarge; ++i) {
+        go.Store(i, i);
+        adaptive.Store(i, i);
+    }
+    go.Range([](const int&, const int&) { return false; });
+    adaptive.Range([](const int&, const int&) { return false; });
+
+    // 读多写少：新key成批到来，之后被反复读取
+    int go_base = kLarge, adaptive_base = kLarge;
+    BENCHMARK("bursts of new keys, GoPromotion") {
+        go_base += 64;
+        return BurstLookups(go, go_base, 64, 200000);
+    };
+    BENCHMARK("bursts of new keys, AdaptivePromotion") {
+        adaptive_base += 64;
+        return BurstLookups(adaptive, adaptive_base, 64, 200000);
+    };
+    print("GoPromotion", go.Promotions());
+    print("AdaptivePromotion", adaptive.Promotions());
+
+    // 抖动：每读1000次就来一个新key，提升后的快照马上作废
+    BENCHMARK("steady new keys, GoPromotion") {
+        go_base += 64;
+        return BurstLookups(go, go_base, 1, 1000);
+    };
+    BENCHMARK("steady new keys, AdaptivePromotion") {
+        adaptive_base += 64;
+        return BurstLookups(adaptive, adaptive_base, 1, 1000);
+    };
+    print("GoPromotion", go.Promotions());
+    print("AdaptivePromotion", adaptive.Promotions());
+}
+
+// Run with: map_perf "[!benchmark]"
+TEST_CASE("sync.Map stats policy overhead", "[Map][!benchmark]") {
+    using juliet::sync::StdLockPolicy;
+    juliet::sync::Map<int, int> plain;
+    juliet::sync::Map<int, int, StdLockPolicy, juliet::sync::AdaptivePromotion, juliet::sync::StripedStats> counted;
+    for (int i = 0; i < kKeys; ++i) {
+        plain.Store(i, i);
+        counted.Store(i, i);
+    }
+    plain.Range([](const int&, const int&) { return false; });
+    counted.Range([](const int&, const int&) { return false; });
+
+    for (int threads : {1, 4}) {
+        BENCHMARK("NoStats, " + std::to_string(threads) + " threads") {
+            return LoadStoreMix(plain, threads, 20000);
+        };
+        BENCHMARK("StripedStats, " + std::to_string(threads) + " threads") {
+            return LoadStoreMix(counted, threads, 20000);
+        };
+    }
+}
+
+// Run with: map_perf "[!benchmark]"
+TEST_CASE("sync.Map Range vs Snapshot among new keys", "[Map][!benchmark]") {
+    constexpr int kLarge = 1 << 16;
+    juliet::sync::Map<int, int> ranged;
+    juliet::sync::Map<int, int> viewed;
+    for (int i = 0; i < kLarge; ++i) {
+        ranged.Store(i, i);
+        viewed.Store(i, i);
+    }
+    auto first = [](const int&, const int&) { return false; };
+    ranged.Range(first);
+    viewed.Range(first);
+
+    // 每写一个新key就遍历一次：Range每次提升，下一个新key要重建dirty
+    int ranged_next = kLarge, viewed_next = kLarge;
+    BENCHMARK("new key then Range, 64K keys") {
+        for (int i = 0; i < 100; ++i) {
+            ranged.Store(ranged_next++, i);
+            ranged.Range(first);
+        }
+        return ranged.Size();
+    };
+    BENCHMARK("new key then Snapshot().Range, 64K keys") {
+        for (int i = 0; i < 100; ++i) {
+            viewed.Store(viewed_next++, i);
+            viewed.Snapshot().Range(first);
+        }
+        return viewed.Size();
+    };
+}
+
+// Run with: map_perf "[!benchmark]"
+TEST_CASE("string_view lookups: plain vs transparent hash", "[Map][!benchmark]") {
+    using juliet::sync::NoStats;
+    using juliet::sync::StdLockPolicy;
+    using juliet::sync::StringHash;
+    using Equal = std::equal_to<>;
+    // 超出SSO的键，每构造一次std::string都要分配
+    std::vector<std::string> keys;
+    for (int i = 0; i < kKeys; ++i)
+        keys.push_back(std::string(40, 'k') + std::to_string(i));
+    std::vector<std::string_view> views(keys.begin(), keys.end());
+
+    juliet::sync::Map<std::string, int> map;
+    juliet::sync::Map<std::string, int, StdLockPolicy, juliet::sync::AdaptivePromotion, NoStats, StringHash, Equal> tmap;
+    juliet::sync::HashTable<std::string, int> table;
+    juliet::sync::HashTable<std::string, int, StdLockPolicy, NoStats, StringHash, Equal> ttable;
+    juliet::sync::CachedMap<std::string, int> cached;
+    juliet::sync::CachedMap<std::string, int, StdLockPolicy, NoStats, StringHash, Equal> tcached;
+    for (int i = 0; i < kKeys; ++i) {
+        map.Store(keys[i], i);
+        tmap.Store(keys[i], i);
+        table.Put(keys[i], i);
+        ttable.Put(keys[i], i);
+        cached.Put(keys[i], i);
+        tcached.Put(keys[i], i);
+    }
+    map.Range([](const std::string&, const int&) { return true; });
+    tmap.Range([](const std::string&, const int&) { return true; });
+
+    // 普通Hash：调用方手里的string_view要先转成std::string
+    BENCHMARK("Map, string_view -> std::string, 100K") {
+        long sum = 0;
+        for (int r = 0; r < 100; ++r) {
+            for (auto view : views)
+                sum += map.Load(std::string(view));
+        }
+        return sum;
+    };
+    BENCHMARK("Map, string_view transparent, 100K") {
+        long sum = 0;
+        for (int r = 0; r < 100; ++r) {
+            for (auto view : views)
+                sum += tmap.Load(view);
+        }
+        return sum;
+    };
+    BENCHMARK("HashTable, string_view -> std::string, 100K") {
+        long sum = 0;
+        for (int r = 0; r < 100; ++r) {
+            for (auto view : views)
+                sum += table.Get(std::string(view));
+        }
+        return sum;
+    };
+    BENCHMARK("HashTable, string_view transparent, 100K") {
+        long sum = 0;
+        for (int r = 0; r < 100; ++r) {
+            for (auto view : views)
+                sum += ttable.Get(view);
+        }
+        return sum;
+    };
+    BENCHMARK("CachedMap, string_view -> std::string, 100K") {
+        long sum = 0;
+        for (int r = 0; r < 100; ++r) {
+            for (auto view : views)
+                sum += cached.Get(std::string(view));
+        }
+        return sum;
+    };
+    BENCHMARK("CachedMap, string_view transparent, 100K") {
+        long sum = 0;
+        for (int r = 0; r < 100; ++r) {
+            for (auto view : views)
+                sum += tcached.Get(view);
+        }
+        return sum;
+    };
+}
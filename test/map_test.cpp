@@ -0,0 +1,566 @@
+#define CATCH_CONFIG_MAIN
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <shared_mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/map.hpp"
+
+namespace {
+
+// Neither default-constructible nor copyable.
+struct Blob {
+    explicit Blob(int v) : value(v) {}
+    Blob(Blob&&) = default;
+    Blob& operator=(Blob&&) = default;
+    Blob(const Blob&) = delete;
+    Blob& operator=(const Blob&) = delete;
+
+    int value;
+};
+
+// Counts copies, to tell moved-out values from copied ones.
+struct Copied {
+    static int copies;
+
+    Copied(int v) : value(v) {}
+    Copied(Copied&&) = default;
+    Copied& operator=(Copied&&) = default;
+    Copied(const Copied& o) : value(o.value) { ++copies; }
+    Copied& operator=(const Copied& o) {
+        value = o.value;
+        ++copies;
+        return *this;
+    }
+
+    int value;
+};
+
+int Copied::copies = 0;
+
+// Counts how often Map::mu_ is taken.
+struct CountingMutex {
+    static std::atomic_int locks;
+
+    void lock() {
+        ++locks;
+        mu.lock();
+    }
+
+    void unlock() { mu.unlock(); }
+
+    std::mutex mu;
+};
+
+std::atomic_int CountingMutex::locks{0};
+
+using CountingLockPolicy = juliet::sync::LockPolicy<CountingMutex, std::shared_timed_mutex, std::mutex>;
+
+// A name that has no conversion to std::string: looking it up must not build
+// a Key.
+struct Name {
+    const char* text;
+};
+
+struct NameHash {
+    using is_transparent = void;
+
+    size_t operator()(std::string_view s) const { return std::hash<std::string_view>{}(s); }
+    size_t operator()(Name n) const { return (*this)(std::string_view(n.text)); }
+};
+
+struct NameEqual {
+    using is_transparent = void;
+
+    bool operator()(const std::string& a, const std::string& b) const { return a == b; }
+    bool operator()(const std::string& a, Name b) const { return a == b.text; }
+};
+
+}
+
+TEST_CASE("sync.Map store and load", "[Map]") {
+    juliet::sync::Map<std::string, std::string> m;
+    std::string v;
+    REQUIRE_FALSE(m.Load("a", &v));
+
+    m.Store("a", "1");
+    REQUIRE(m.Load("a", &v));
+    REQUIRE(v == "1");
+    REQUIRE(m.Load("a") == "1");
+
+    std::string big(1024, 'x');
+    m.Store("a", std::move(big));
+    REQUIRE(m.Load("a") == std::string(1024, 'x'));
+
+    REQUIRE(m.LoadOrStore("a", "2", &v));
+    REQUIRE(v == std::string(1024, 'x'));
+    REQUIRE_FALSE(m.LoadOrStore("b", std::string("2"), &v));
+    REQUIRE(v == "2");
+
+    REQUIRE(m.Delete("a", &v));
+    REQUIRE_FALSE(m.Load("a", &v));
+}
+
+TEST_CASE("sync.Map emplace move-only values", "[Map]") {
+    juliet::sync::Map<int, Blob> m;
+
+    auto r = m.TryEmplace(1, 10);
+    REQUIRE(r.second);
+    REQUIRE(r.first->value == 10);
+
+    r = m.TryEmplace(1, 20);
+    REQUIRE_FALSE(r.second);
+    REQUIRE(r.first->value == 10);
+
+    m.Emplace(1, 30);
+    r = m.TryEmplace(1, 40);
+    REQUIRE_FALSE(r.second);
+    REQUIRE(r.first->value == 30);
+
+    m.Store(2, Blob(5));
+    int sum = 0;
+    m.Range([&sum](const int&, const Blob& b) {
+        sum += b.value;
+        return true;
+    });
+    REQUIRE(sum == 35);
+
+    juliet::sync::Map<int, std::unique_ptr<int>> p;
+    REQUIRE(p.TryEmplace(1, new int(7)).second);
+    REQUIRE(**p.TryEmplace(1, nullptr).first == 7);
+}
+
+TEST_CASE("sync.Map load or compute", "[Map]") {
+    juliet::sync::Map<int, std::string> m;
+    int calls = 0;
+    auto factory = [&calls]() {
+        ++calls;
+        return std::string("computed");
+    };
+
+    auto r = m.LoadOrCompute(1, factory);
+    REQUIRE(r.second);
+    REQUIRE(*r.first == "computed");
+
+    for (int i = 0; i < 10; ++i) {
+        r = m.LoadOrCompute(1, factory);
+        REQUIRE_FALSE(r.second);
+        REQUIRE(*r.first == "computed");
+    }
+    REQUIRE(calls == 1);
+
+    REQUIRE_THROWS(m.LoadOrCompute(2, []() -> std::string { throw 1; }));
+    std::string v;
+    REQUIRE_FALSE(m.Load(2, &v));
+    REQUIRE(m.LoadOrCompute(2, factory).second);
+    REQUIRE(calls == 2);
+
+    // factory不在map锁内执行：在里面插入新键不会死锁，删除后重新计算的键也一样
+    auto nested = [&m](int key) {
+        return [&m, key]() {
+            m.Store(key, "nested");
+            return std::string("outer");
+        };
+    };
+    REQUIRE(m.LoadOrCompute(3, nested(100)).second);
+    m.Delete(3);
+    REQUIRE(m.LoadOrCompute(3, nested(101)).second);
+    REQUIRE(m.Load(3) == "outer");
+    REQUIRE(m.Load(100) == "nested");
+    REQUIRE(m.Load(101) == "nested");
+}
+
+namespace {
+
+// 16字节，走seqlock路径
+struct Span {
+    long begin;
+    long end;
+
+    bool operator==(const Span& o) const { return begin == o.begin && end == o.end; }
+};
+
+template<typename Value, typename Make>
+void CheckInlineOps(Make make) {
+    static_assert(juliet::sync::map::kInlineValue<Value>, "expected inline entry");
+    juliet::sync::Map<int, Value> m;
+    Value v{};
+    REQUIRE_FALSE(m.Load(1, &v));
+    REQUIRE_FALSE(m.CompareAndSwap(1, make(0), make(1)));
+
+    m.Store(1, make(1));
+    REQUIRE(m.Load(1) == make(1));
+    REQUIRE(m.CompareAndSwap(1, make(1), make(2)));
+    REQUIRE_FALSE(m.CompareAndSwap(1, make(1), make(3)));
+    REQUIRE(m.Load(1) == make(2));
+
+    REQUIRE(m.LoadOrStore(1, make(9), &v));
+    REQUIRE(v == make(2));
+    REQUIRE(*m.LoadOrCompute(2, [&]() { return make(5); }).first == make(5));
+
+    REQUIRE(m.Delete(1, &v));
+    REQUIRE(v == make(2));
+    REQUIRE_FALSE(m.Load(1, &v));
+    m.Store(1, make(7));
+    REQUIRE(m.Load(1) == make(7));
+}
+
+}
+
+TEST_CASE("sync.Map inline values", "[Map]") {
+    CheckInlineOps<int>([](int i) { return i; });
+    CheckInlineOps<long>([](int i) { return static_cast<long>(i) << 40; });
+    CheckInlineOps<Span>([](int i) { return Span{i, -i}; });
+    static_assert(!juliet::sync::map::kInlineValue<std::string>, "string is heap stored");
+}
+
+TEST_CASE("sync.Map compare and swap is atomic", "[Map]") {
+    juliet::sync::Map<int, long> m;
+    juliet::sync::Map<int, std::string> s;
+    m.Store(0, 0);
+    s.Store(0, "0");
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 2000; ++i) {
+                long cur;
+                do {
+                    m.Load(0, &cur);
+                } while (!m.CompareAndSwap(0, cur, cur + 1));
+
+                std::string str;
+                do {
+                    s.Load(0, &str);
+                } while (!s.CompareAndSwap(0, str, std::to_string(std::stol(str) + 1)));
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    REQUIRE(m.Load(0) == 8000);
+    REQUIRE(s.Load(0) == "8000");
+}
+
+TEST_CASE("sync.Map values outlive overwrite and delete", "[Map]") {
+    juliet::sync::Map<int, std::string> m;
+    // 第一个值与节点同一次分配，之后的值单独装箱
+    auto first = m.TryEmplace(1, "first").first;
+    m.Store(1, "second");
+    auto second = m.LoadOrCompute(1, []() { return std::string("x"); }).first;
+    std::string v;
+    REQUIRE(m.Delete(1, &v));
+    REQUIRE(v == "second");
+    m.Reset();
+
+    REQUIRE(*first == "first");
+    REQUIRE(*second == "second");
+}
+
+TEST_CASE("sync.Map definite misses skip the lock", "[Map]") {
+    juliet::sync::Map<int, std::string, CountingLockPolicy> m;
+    for (int i = 0; i < 100; ++i)
+        m.Store(i, std::to_string(i));
+    // 提升到read，再写入一个新key使read处于amended状态
+    m.Range([](const int&, const std::string&) { return false; });
+    m.Store(100, "100");
+
+    CountingMutex::locks = 0;
+    std::string v;
+    int found = 0;
+    for (int i = 1000; i < 11000; ++i)
+        found += m.Load(i, &v);
+    m.Delete(1000);
+    REQUIRE(found == 0);
+    // 只有布隆过滤器误判的key才会加锁
+    REQUIRE(CountingMutex::locks < 200);
+
+    // dirty里的key依然能读到，且读多了照常提升
+    for (int i = 0; i < 10; ++i) {
+        REQUIRE(m.Load(100, &v));
+        REQUIRE(v == "100");
+    }
+    REQUIRE(m.Delete(100, &v));
+    REQUIRE_FALSE(m.Load(100, &v));
+}
+
+TEST_CASE("sync.Map promotion policies", "[Map]") {
+    using juliet::sync::StdLockPolicy;
+    // 100个key都只在dirty里，读同一个key直到提升
+    auto misses_to_promote = [](auto& m) {
+        for (int i = 0; i < 100; ++i)
+            m.Store(i, i);
+        int v;
+        while (m.Promotions().promotions == 0)
+            REQUIRE(m.Load(0, &v));
+        return m.Promotions().misses;
+    };
+
+    juliet::sync::Map<int, int, StdLockPolicy, juliet::sync::GoPromotion> go;
+    REQUIRE(misses_to_promote(go) == 100);
+    juliet::sync::Map<int, int, StdLockPolicy, juliet::sync::MissRatioPromotion<1, 4>> quarter;
+    REQUIRE(misses_to_promote(quarter) == 25);
+    juliet::sync::Map<int, int, StdLockPolicy, juliet::sync::IntervalPromotion<0>> interval;
+    REQUIRE(misses_to_promote(interval) == 1);
+    juliet::sync::Map<int, int, StdLockPolicy, juliet::sync::WriteRatePromotion<2>> write_rate;
+    REQUIRE(misses_to_promote(write_rate) == 200);
+
+    auto stats = go.Promotions();
+    REQUIRE(stats.rebuilds == 1);
+    REQUIRE(stats.rebuilt_entries == 0);
+    go.Store(100, 100);
+    stats = go.Promotions();
+    REQUIRE(stats.rebuilds == 2);
+    REQUIRE(stats.rebuilt_entries == 100);
+}
+
+TEST_CASE("sync.AdaptivePromotion prices misses against rebuilds", "[Map]") {
+    using juliet::sync::AdaptivePromotion;
+    using namespace std::chrono_literals;
+
+    // 没有测量值时与Go一致
+    AdaptivePromotion policy;
+    REQUIRE(policy.Threshold(1000) == 1000);
+
+    // 复制一个entry 10ns，一次miss 100ns：付出1/10个表的miss就该提升
+    policy.OnRebuild(1000, 10us);
+    policy.OnMissSample(100ns);
+    REQUIRE(policy.Threshold(1000) == 100);
+    REQUIRE(policy.Threshold(10) == 8);
+
+    // 重建很贵时推迟提升，但最多等4倍表大小的miss
+    AdaptivePromotion slow_rebuild;
+    slow_rebuild.OnRebuild(1000, 1ms);
+    slow_rebuild.OnMissSample(100ns);
+    REQUIRE(slow_rebuild.Threshold(1000) == 4000);
+}
+
+TEST_CASE("sync.Map bulk load publishes the read snapshot", "[Map]") {
+    // 够大时分块多线程构造节点
+    constexpr int kN = 200000;
+    std::vector<std::pair<int, int>> pairs;
+    for (int i = 0; i < kN; ++i)
+        pairs.emplace_back(i, i);
+    // 重复的键以最后一次为准
+    pairs.emplace_back(5, -5);
+
+    juliet::sync::Map<int, int, juliet::sync::StdLockPolicy, juliet::sync::GoPromotion> m(pairs.begin(), pairs.end());
+    REQUIRE(m.Size() == kN);
+    REQUIRE(m.Load(5) == -5);
+    REQUIRE(m.Load(kN - 1) == kN - 1);
+    // 载入的键都在read里，读不产生miss
+    for (int i = 0; i < kN; i += 1000)
+        m.Load(i);
+    REQUIRE(m.Promotions().misses == 0);
+    REQUIRE(m.Promotions().rebuilds == 0);
+
+    // BulkLoad替换全部内容，并移走原始表里的值
+    juliet::sync::Map<int, int>::RawMap raw{{1, 1}, {2, 2}};
+    m.Reserve(16);
+    m.BulkLoad(std::move(raw));
+    REQUIRE(raw.empty());
+    REQUIRE(m.Size() == 2);
+    int v;
+    REQUIRE_FALSE(m.Load(5, &v));
+    m.Store(3, 3);
+    REQUIRE(m.Size() == 3);
+
+    juliet::sync::Map<std::string, std::unique_ptr<int>>::RawMap owned;
+    owned.emplace("a", std::make_unique<int>(1));
+    juliet::sync::Map<std::string, std::unique_ptr<int>> moved(std::move(owned));
+    auto found = moved.TryEmplace("a");
+    REQUIRE_FALSE(found.second);
+    REQUIRE(**found.first == 1);
+}
+
+TEST_CASE("sync.Map parallel Range", "[Map]") {
+    juliet::sync::Map<int, int> m;
+    for (int i = 0; i < 10000; ++i)
+        m.Store(i, i);
+    m.Delete(0);
+    m.Delete(9999);
+    juliet::sync::Executor executor(3);
+
+    std::atomic<long> sum{0};
+    m.ParallelRange(executor, [&sum](const int&, const int& v) {
+        sum += v;
+        return true;
+    });
+    REQUIRE(sum == 9998L * 9999 / 2);
+
+    auto total = m.ParallelRange(executor, 0L,
+        [](long& partial, const int&, const int& v) { partial += v; },
+        [](long& result, long&& partial) { result += partial; });
+    REQUIRE(total == 9998L * 9999 / 2);
+
+    // 返回false后不再开始新的块
+    std::atomic<int> visited{0};
+    m.ParallelRange(executor, [&visited](const int&, const int&) {
+        ++visited;
+        return false;
+    });
+    REQUIRE(visited < 9998);
+}
+
+TEST_CASE("sync.Map snapshot does not promote", "[Map]") {
+    juliet::sync::Map<int, int, juliet::sync::StdLockPolicy, juliet::sync::GoPromotion> m;
+    for (int i = 0; i < 100; ++i)
+        m.Store(i, i);
+    // 新写入的键都还在dirty里
+    auto view = m.Snapshot();
+    REQUIRE(m.Promotions().promotions == 0);
+    REQUIRE(view.KeyCount() == 100);
+    REQUIRE(view.Load(99) == 99);
+
+    // 之后的写入不改变视图的键集合，删除的键读不到
+    m.Store(100, 100);
+    m.Store(1, -1);
+    m.Delete(2);
+    int v;
+    REQUIRE_FALSE(view.Load(100, &v));
+    REQUIRE_FALSE(view.Load(2, &v));
+    REQUIRE(view.Load(1) == -1);
+    long sum = 0;
+    int count = 0;
+    view.Range([&](const int&, const int& value) {
+        sum += value;
+        ++count;
+        return true;
+    });
+    REQUIRE(count == 99);
+    REQUIRE(sum == 99 * 100 / 2 - 2 - 2);
+
+    // 删除后重新写入的键在新视图里取到新节点
+    m.Store(2, 20);
+    REQUIRE(m.Snapshot().Load(2) == 20);
+    REQUIRE(m.Snapshot().KeyCount() == 101);
+    // Range仍会提升
+    m.Range([](const int&, const int&) { return true; });
+    REQUIRE(m.Promotions().promotions == 1);
+    REQUIRE(m.Snapshot().Load(100) == 100);
+}
+
+TEST_CASE("sync.Map snapshot while writing", "[Map]") {
+    juliet::sync::Map<int, int> m;
+    for (int i = 0; i < 1000; ++i)
+        m.Store(i, i);
+    std::atomic<bool> done{false};
+    std::thread writer([&]() {
+        for (int i = 1000; i < 20000; ++i) {
+            m.Store(i, i);
+            if (i % 3 == 0)
+                m.Delete(i - 500);
+        }
+        done = true;
+    });
+    // Catch的断言不是线程安全的，只在主线程里断言
+    int bad = 0;
+    while (!done) {
+        auto view = m.Snapshot();
+        view.Range([&bad](const int& key, const int& value) {
+            if (key != value)
+                ++bad;
+            return true;
+        });
+        if (view.Load(999) != 999)
+            ++bad;
+    }
+    writer.join();
+    REQUIRE(bad == 0);
+    REQUIRE(m.Snapshot().Load(19999) == 19999);
+}
+
+TEST_CASE("sync.Map drain moves values out", "[Map]") {
+    juliet::sync::Map<int, Copied> m;
+    for (int i = 0; i < 100; ++i)
+        m.Emplace(i, i);
+    // 提升后再写新值，一半的值单独装箱
+    m.Range([](const int&, const Copied&) { return true; });
+    for (int i = 0; i < 50; ++i)
+        m.Emplace(i, i + 1000);
+    m.Emplace(100, 100);
+    // 读者仍持有的值只能复制
+    auto held = m.TryEmplace(7, 0).first;
+
+    Copied::copies = 0;
+    auto drained = m.Drain();
+    REQUIRE(m.Size() == 0);
+    Copied out(0);
+    REQUIRE_FALSE(m.Load(100, &out));
+    // 之后的写入不进入drained
+    m.Emplace(200, 200);
+
+    long sum = 0;
+    int count = 0;
+    drained.ForEach([&](const int& key, Copied&& value) {
+        sum += value.value - (key < 50 ? 1000 : 0);
+        ++count;
+    });
+    REQUIRE(count == 101);
+    REQUIRE(sum == 100 * 101 / 2);
+    REQUIRE(Copied::copies == 1);
+    REQUIRE(held->value == 1007);
+    REQUIRE_FALSE(drained.Next([](const int&, Copied&&) { FAIL(); }));
+    REQUIRE(m.Load(200, &out));
+
+    // Reset(raw)同样移出；中途放弃的drained释放剩余节点
+    juliet::sync::Map<int, Copied>::RawMap raw;
+    Copied::copies = 0;
+    m.Reset(&raw);
+    REQUIRE(raw.size() == 1);
+    REQUIRE(Copied::copies == 0);
+    for (int i = 0; i < 10; ++i)
+        m.Emplace(i, i);
+    auto partial = m.Drain();
+    REQUIRE(partial.Next([](const int&, Copied&&) {}));
+}
+
+TEST_CASE("sync.Map drain move-only and inline values", "[Map]") {
+    juliet::sync::Map<int, Blob> blobs;
+    blobs.TryEmplace(1, 1);
+    blobs.TryEmplace(2, 2);
+    int sum = 0;
+    blobs.Drain().ForEach([&sum](const int&, Blob&& blob) { sum += blob.value; });
+    REQUIRE(sum == 3);
+
+    juliet::sync::Map<int, int> ints;
+    ints.Store(1, 10);
+    ints.Store(1, 11);
+    ints.Delete(2);
+    ints.Store(3, 30);
+    ints.Delete(3);
+    auto drained = ints.Drain();
+    int key = 0, value = 0;
+    REQUIRE(drained.Next([&](const int& k, int&& v) {
+        key = k;
+        value = v;
+    }));
+    REQUIRE(key == 1);
+    REQUIRE(value == 11);
+    REQUIRE_FALSE(drained.Next([](const int&, int&&) {}));
+}
+
+TEST_CASE("sync.Map heterogeneous lookup", "[Map]") {
+    juliet::sync::Map<std::string, int, juliet::sync::StdLockPolicy, juliet::sync::GoPromotion,
+                      juliet::sync::NoStats, NameHash, NameEqual> m;
+    m.Store("read", 1);
+    m.Range([](const std::string&, const int&) { return true; });
+    // 一个在read里，一个在dirty里
+    m.Store("dirty", 2);
+    REQUIRE(m.Load(Name{"read"}) == 1);
+    REQUIRE(m.Load(Name{"dirty"}) == 2);
+    int v = 0;
+    REQUIRE_FALSE(m.Load(Name{"missing"}, &v));
+    REQUIRE(m.Snapshot().Load(Name{"dirty"}, &v));
+    REQUIRE(v == 2);
+
+    juliet::sync::Map<std::string, int, juliet::sync::StdLockPolicy, juliet::sync::AdaptivePromotion,
+                      juliet::sync::NoStats, juliet::sync::StringHash, std::equal_to<>> views;
+    views.Store("a", 1);
+    REQUIRE(views.Load(std::string_view("a")) == 1);
+    REQUIRE(views.Load("a") == 1);
+}
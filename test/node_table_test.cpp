@@ -0,0 +1,117 @@
+#define CATCH_CONFIG_MAIN
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/cached_map.hpp"
+#include "sync/map.hpp"
+#include "sync/node_table.hpp"
+
+using namespace juliet::sync;
+
+namespace {
+
+struct TestNode : RefCounted {
+    using KeyType = int;
+
+    static int alive;
+
+    explicit TestNode(int k) : k(k) { ++alive; }
+    ~TestNode() override { --alive; }
+
+    const int& key() const { return k; }
+
+    int k;
+};
+
+int TestNode::alive = 0;
+
+// 所有key落在同一个探测链上，覆盖删除时的回移
+struct CollidingHash {
+    size_t operator()(int) const { return 0; }
+};
+
+}
+
+TEST_CASE("NodeTable insert find erase", "[NodeTable]") {
+    {
+        NodeTable<TestNode> t;
+        for (int i = 0; i < 1000; ++i)
+            REQUIRE(t.Insert(MakeIntrusive<TestNode>(i)).second);
+        REQUIRE_FALSE(t.Insert(MakeIntrusive<TestNode>(7)).second);
+        REQUIRE(t.Size() == 1000);
+
+        for (int i = 0; i < 1000; i += 2)
+            REQUIRE(t.Erase(i) != nullptr);
+        REQUIRE(t.Erase(0) == nullptr);
+        for (int i = 0; i < 1000; ++i)
+            REQUIRE((t.Find(i) != nullptr) == (i % 2 == 1));
+
+        NodeTable<TestNode> copy(t);
+        t.Clear();
+        int n = 0;
+        for (auto* node : copy) {
+            REQUIRE(node->key() % 2 == 1);
+            ++n;
+        }
+        REQUIRE(n == 500);
+    }
+    REQUIRE(TestNode::alive == 0);
+}
+
+TEST_CASE("NodeTable backward shift keeps probe runs intact", "[NodeTable]") {
+    NodeTable<TestNode, CollidingHash> t;
+    for (int i = 0; i < 20; ++i)
+        t.Insert(MakeIntrusive<TestNode>(i));
+    for (int i = 0; i < 20; i += 3)
+        t.Erase(i);
+    for (int i = 0; i < 20; ++i)
+        REQUIRE((t.Find(i) != nullptr) == (i % 3 != 0));
+}
+
+TEST_CASE("values handed out keep their node alive", "[NodeTable][Map]") {
+    Map<int, std::string>::ValuePtr held;
+    {
+        Map<int, std::string> m;
+        held = m.TryEmplace(1, "embedded").first;
+        m.Store(1, "boxed");
+        REQUIRE(m.Load(1) == "boxed");
+        m.Reset();
+    }
+    REQUIRE(*held == "embedded");
+}
+
+TEST_CASE("CachedMap shares nodes between cache and write table", "[NodeTable][CachedMap]") {
+    CachedMap<int, std::string> m;
+    std::string v;
+    REQUIRE_FALSE(m.Get(1, v));
+    m.Put(1, "a");
+    REQUIRE(m.Get(1) == "a");
+    REQUIRE(m.Remove(1, v));
+    REQUIRE(v == "a");
+    REQUIRE_FALSE(m.Get(1, v));
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&m, t]() {
+            std::string out;
+            for (int i = 0; i < 500; ++i) {
+                if (t == 0)
+                    m.Put(i % 8, std::to_string(i));
+                else if (t == 1 && i % 5 == 0)
+                    m.Remove(i % 8);
+                else
+                    m.Get(i % 8, out);
+            }
+        });
+    }
+    for (auto& th : threads)
+        th.join();
+
+    // 并发结束后缓存与写表一致
+    for (int i = 0; i < 8; ++i) {
+        m.Put(i, "x");
+        REQUIRE(m.Get(i) == "x");
+    }
+}
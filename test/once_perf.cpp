@@ -0,0 +1,49 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <mutex>
+
+#include "catch2/catch.hpp"
+
+#include "sync/once.hpp"
+
+using namespace juliet::sync;
+
+TEST_CASE("sync.OnceValue smoke", "[Once]") {
+    auto value = MakeOnceValue([]() { return 42; });
+    REQUIRE(value.Get() == 42);
+}
+
+// Run with: once_perf "[!benchmark]"
+TEST_CASE("initialized fast path: Once, OnceValue, std::call_once", "[Once][!benchmark]") {
+    Once once;
+    int a = 0;
+    once.Call([&a]() { a = 1; });
+
+    auto lazy = MakeOnceValue([]() { return 1; });
+    lazy.Get();
+
+    OnceValue<int> erased([]() { return 1; });
+    erased.Get();
+
+    std::once_flag flag;
+    int b = 0;
+    std::call_once(flag, [&b]() { b = 1; });
+
+    BENCHMARK("sync::Once::Call") {
+        once.Call([&a]() { a = 2; });
+        return a;
+    };
+
+    BENCHMARK("sync::OnceValue<int, F>::Get") {
+        return lazy.Get();
+    };
+
+    BENCHMARK("sync::OnceValue<int>::Get (std::function)") {
+        return erased.Get();
+    };
+
+    BENCHMARK("std::call_once") {
+        std::call_once(flag, [&b]() { b = 2; });
+        return b;
+    };
+}
@@ -1,8 +1,73 @@
 #define CATCH_CONFIG_MAIN
+#include <atomic>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
 #include "catch2/catch.hpp"
 
 #include "sync/once.hpp"
 
+using namespace juliet::sync;
+
 TEST_CASE("sync.Once", "[Once]") {
+    Once once;
+    int calls = 0;
+    auto inc = [](int& n, int by) { n += by; };
+    once.Call(inc, std::ref(calls), 1);
+    once.Call(inc, std::ref(calls), 1);
+    REQUIRE(calls == 1);
+    REQUIRE(once.Done());
+
+    Once throwing;
+    REQUIRE_THROWS(throwing.Call([]() { throw std::runtime_error("x"); }));
+    REQUIRE(throwing.Done());
+}
+
+TEST_CASE("sync.OnceValue concurrent", "[Once]") {
+    std::atomic_int calls{0};
+    auto value = MakeOnceValue([&calls]() {
+        ++calls;
+        return std::string("value");
+    });
+
+    std::vector<std::thread> threads;
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&value]() {
+            for (int j = 0; j < 1000; ++j)
+                REQUIRE(value.Get() == "value");
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    REQUIRE(calls == 1);
+}
+
+TEST_CASE("sync.OnceValue exception policy", "[Once]") {
+    int calls = 0;
+    auto fail_first = [&calls]() {
+        if (++calls == 1)
+            throw std::runtime_error("first");
+        return calls;
+    };
+
+    OnceValue<int> cached(fail_first);
+    REQUIRE_THROWS_AS(cached.Get(), std::runtime_error);
+    REQUIRE_THROWS_AS(cached.Get(), std::runtime_error);
+    REQUIRE(calls == 1);
+
+    calls = 0;
+    OnceValue<int, OncePolicy::kRetryOnException> retry(fail_first);
+    REQUIRE_THROWS_AS(retry.Get(), std::runtime_error);
+    REQUIRE_FALSE(retry.Done());
+    REQUIRE(retry.Get() == 2);
+    REQUIRE(retry() == 2);
+    REQUIRE(calls == 2);
+}
 
+TEST_CASE("sync.OnceValues", "[Once]") {
+    OnceValues<int, std::string> values([]() { return std::make_pair(0, std::string("not found")); });
+    REQUIRE(values.Get().first == 0);
+    REQUIRE(values.Get().second == "not found");
 }
@@ -0,0 +1,131 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <map>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/ordered_map.hpp"
+
+using juliet::sync::OrderedMap;
+
+namespace {
+
+constexpr int kKeys = 100000;
+constexpr int kOpsPerThread = 20000;
+// 每kScanEvery次操作做一次长度为kScanLength的范围扫描，其余操作中1/10是写
+constexpr int kScanEvery = 100;
+constexpr int kScanLength = 100;
+
+// 对照组：全局互斥锁保护的std::map
+class LockedMap {
+public:
+    void Put(int key, long value) {
+        std::lock_guard<std::mutex> guard(mu_);
+        map_[key] = value;
+    }
+
+    bool Get(int key, long* value) const {
+        std::lock_guard<std::mutex> guard(mu_);
+        auto it = map_.find(key);
+        if (it == map_.end())
+            return false;
+        *value = it->second;
+        return true;
+    }
+
+    long Scan(int from, int length) const {
+        std::lock_guard<std::mutex> guard(mu_);
+        long sum = 0;
+        for (auto it = map_.lower_bound(from); it != map_.end() && length-- > 0; ++it)
+            sum += it->second;
+        return sum;
+    }
+
+private:
+    mutable std::mutex mu_;
+    std::map<int, long> map_;
+};
+
+class SkipListMap {
+public:
+    void Put(int key, long value) { map_.Put(key, value); }
+
+    bool Get(int key, long* value) const { return map_.Get(key, value); }
+
+    long Scan(int from, int length) const {
+        long sum = 0;
+        for (auto it = map_.LowerBound(from); it.Valid() && length-- > 0; it.Next())
+            sum += it.value();
+        return sum;
+    }
+
+private:
+    OrderedMap<int, long> map_;
+};
+
+template<typename M>
+void Fill(M& m) {
+    for (int i = 0; i < kKeys; ++i)
+        m.Put(i * 2, i);
+}
+
+template<typename M>
+long Mixed(M& m, int threads) {
+    std::vector<std::thread> workers;
+    std::vector<long> sums(threads);
+    for (int t = 0; t < threads; ++t) {
+        workers.emplace_back([&m, &sums, t]() {
+            uint32_t x = 0x9E3779B9u * (t + 1);
+            long sum = 0;
+            for (int i = 0; i < kOpsPerThread; ++i) {
+                x ^= x << 13;
+                x ^= x >> 17;
+                x ^= x << 5;
+                int key = static_cast<int>(x % (2 * kKeys));
+                long v = 0;
+                if (i % kScanEvery == 0)
+                    sum += m.Scan(key, kScanLength);
+                else if (i % 10 == 0)
+                    m.Put(key, i);
+                else if (m.Get(key, &v))
+                    sum += v;
+            }
+            sums[t] = sum;
+        });
+    }
+    for (auto& w : workers)
+        w.join();
+    long total = 0;
+    for (auto s : sums)
+        total += s;
+    return total;
+}
+
+}
+
+TEST_CASE("ordered map mixed workload smoke", "[OrderedMap]") {
+    SkipListMap m;
+    Fill(m);
+    Mixed(m, 2);
+    long v = 0;
+    REQUIRE(m.Get(2, &v));
+}
+
+// Run with: ordered_map_perf "[!benchmark]"
+TEST_CASE("ordered map vs std::map + mutex", "[OrderedMap][!benchmark]") {
+    LockedMap locked;
+    SkipListMap skip;
+    Fill(locked);
+    Fill(skip);
+    for (int threads : {1, 2, 4, 8}) {
+        BENCHMARK("std::map + mutex, " + std::to_string(threads) + " threads") {
+            return Mixed(locked, threads);
+        };
+        BENCHMARK("OrderedMap, " + std::to_string(threads) + " threads") {
+            return Mixed(skip, threads);
+        };
+    }
+}
@@ -0,0 +1,102 @@
+#define CATCH_CONFIG_MAIN
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/ordered_map.hpp"
+
+using juliet::sync::OrderedMap;
+
+TEST_CASE("sync.OrderedMap put get remove", "[OrderedMap]") {
+    OrderedMap<int, std::string> m;
+    std::string v;
+    REQUIRE_FALSE(m.Get(1, &v));
+
+    REQUIRE(m.Put(3, "c"));
+    REQUIRE(m.Put(1, "a"));
+    REQUIRE(m.Put(2, "b"));
+    REQUIRE_FALSE(m.Put(2, std::string("bb")));
+    REQUIRE(m.Get(2, &v));
+    REQUIRE(v == "bb");
+    REQUIRE(m.Size() == 3);
+
+    REQUIRE(m.Remove(1, &v));
+    REQUIRE(v == "a");
+    REQUIRE_FALSE(m.Remove(1));
+    REQUIRE_FALSE(m.Contains(1));
+    REQUIRE(m.Size() == 2);
+    REQUIRE(m.Put(1, "a2"));
+    REQUIRE(m.Get(1, &v));
+    REQUIRE(v == "a2");
+}
+
+TEST_CASE("sync.OrderedMap lower bound and range", "[OrderedMap]") {
+    OrderedMap<int, int> m;
+    for (int i = 0; i < 100; i += 10)
+        m.Put(i, i * 2);
+
+    auto it = m.LowerBound(25);
+    REQUIRE(it.Valid());
+    REQUIRE(it.key() == 30);
+    REQUIRE(it.value() == 60);
+    REQUIRE_FALSE(m.LowerBound(91).Valid());
+
+    std::vector<int> keys;
+    m.Range(20, 60, [&keys](const int& k, const int&) {
+        keys.push_back(k);
+        return true;
+    });
+    REQUIRE(keys == std::vector<int>{20, 30, 40, 50});
+
+    int n = 0;
+    for (auto b = m.Begin(); b.Valid(); b.Next())
+        ++n;
+    REQUIRE(n == 10);
+}
+
+TEST_CASE("sync.OrderedMap scans run alongside writers", "[OrderedMap]") {
+    OrderedMap<int, int> m;
+    // 偶数key始终存在，奇数key被反复插入删除
+    for (int i = 0; i < 2000; i += 2)
+        m.Put(i, i);
+
+    std::atomic_bool stop{false};
+    std::vector<std::thread> writers;
+    for (int t = 0; t < 3; ++t) {
+        writers.emplace_back([&m, &stop, t]() {
+            for (int round = 0; !stop.load(); ++round) {
+                for (int i = 1 + 2 * t; i < 2000; i += 6) {
+                    if (round % 2 == 0)
+                        m.Put(i, i);
+                    else
+                        m.Remove(i);
+                }
+                m.Put(2 * (round % 1000), 2 * (round % 1000));
+            }
+        });
+    }
+
+    for (int scan = 0; scan < 50; ++scan) {
+        int prev = -1;
+        int evens = 0;
+        m.Range(0, 2000, [&](const int& k, const int& v) {
+            REQUIRE(k > prev);
+            REQUIRE(v == k);
+            prev = k;
+            if (k % 2 == 0)
+                ++evens;
+            return true;
+        });
+        REQUIRE(evens == 1000);
+    }
+    stop = true;
+    for (auto& w : writers)
+        w.join();
+
+    int count = 0;
+    for (auto it = m.Begin(); it.Valid(); it.Next())
+        ++count;
+    REQUIRE(static_cast<size_t>(count) == m.Size());
+}
@@ -0,0 +1,78 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <random>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/overlay_map.hpp"
+
+namespace {
+
+constexpr int kBase = 1000000;
+constexpr int kInserts = 4000;
+// 每插入一个新键，读它几次，再读一批基础数据里的键
+constexpr int kReadsOfNewKey = 4;
+constexpr int kReadsPerInsert = 64;
+
+std::vector<int> Probes() {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> dist(0, kBase - 1);
+    std::vector<int> probes(kInserts * kReadsPerInsert);
+    for (auto& p : probes)
+        p = dist(rng);
+    return probes;
+}
+
+juliet::sync::FrozenMap<int, long> Base() {
+    juliet::sync::FrozenMap<int, long>::Builder builder;
+    for (int i = 0; i < kBase; ++i)
+        builder.Add(i, i);
+    return builder.Build();
+}
+
+template <typename M>
+long Updates(M& m, const std::vector<int>& probes, int round) {
+    long sum = 0, v;
+    for (int i = 0; i < kInserts; ++i) {
+        int key = kBase + round * kInserts + i;
+        m.Store(key, key);
+        for (int r = 0; r < kReadsOfNewKey; ++r)
+            if (m.Load(key, &v))
+                sum += v;
+        for (int r = 0; r < kReadsPerInsert; ++r)
+            if (m.Load(probes[i * kReadsPerInsert + r], &v))
+                sum += v;
+    }
+    return sum;
+}
+
+}
+
+TEST_CASE("overlay map perf smoke", "[OverlayMap]") {
+    juliet::sync::OverlayMap<int, long> m;
+    m.Store(1, 1);
+    REQUIRE(m.Load(1) == 1);
+}
+
+// Run with: overlay_map_perf "[!benchmark]"
+TEST_CASE("static base with a stream of new keys: Map vs OverlayMap", "[OverlayMap][!benchmark]") {
+    auto probes = Probes();
+    juliet::sync::Map<int, long> map;
+    for (int i = 0; i < kBase; ++i)
+        map.Store(i, i);
+    juliet::sync::OverlayMap<int, long> overlay(Base());
+
+    int map_round = 0;
+    BENCHMARK("Map<int, long>, 1M base, 4K new keys") {
+        return Updates(map, probes, map_round++);
+    };
+    int overlay_round = 0;
+    BENCHMARK("OverlayMap<int, long>, 1M base, 4K new keys") {
+        return Updates(overlay, probes, overlay_round++);
+    };
+    BENCHMARK("OverlayMap<int, long> Compact, 1M base") {
+        overlay.Store(-1, overlay_round);
+        overlay.Compact();
+        return overlay.DeltaSize();
+    };
+}
@@ -0,0 +1,121 @@
+#define CATCH_CONFIG_MAIN
+#include <atomic>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/overlay_map.hpp"
+
+using namespace juliet::sync;
+
+namespace {
+
+FrozenMap<int, int> Base(int n) {
+    FrozenMap<int, int>::Builder builder;
+    for (int i = 0; i < n; ++i)
+        builder.Add(i, i);
+    return builder.Build();
+}
+
+}
+
+TEST_CASE("OverlayMap reads through the delta to the base", "[OverlayMap]") {
+    OverlayMap<int, int> m(Base(100), false);
+    REQUIRE(m.Size() == 100);
+    REQUIRE(m.Load(42) == 42);
+
+    // 覆盖、删除、新增都只写delta
+    m.Store(42, -42);
+    REQUIRE(m.Delete(7));
+    REQUIRE_FALSE(m.Delete(7));
+    REQUIRE_FALSE(m.Delete(1000));
+    m.Store(1000, 1);
+    REQUIRE(m.Load(42) == -42);
+    REQUIRE_FALSE(m.Contains(7));
+    REQUIRE(m.Contains(1000));
+    REQUIRE(m.Size() == 100);
+    REQUIRE(m.DeltaSize() == 3);
+
+    // 删除后再写回
+    m.Store(7, 70);
+    REQUIRE(m.Load(7) == 70);
+    REQUIRE(m.Size() == 101);
+    REQUIRE(m.BaseMap()->Size() == 100);
+}
+
+TEST_CASE("OverlayMap compaction", "[OverlayMap]") {
+    OverlayMap<std::string, std::string> m(FrozenMap<std::string, std::string>(), false);
+    for (int i = 0; i < 1000; ++i)
+        m.Store(std::to_string(i), "v" + std::to_string(i));
+    m.Compact();
+    REQUIRE(m.DeltaSize() == 0);
+    REQUIRE(m.BaseMap()->Size() == 1000);
+
+    for (int i = 0; i < 1000; i += 2)
+        REQUIRE(m.Delete(std::to_string(i)));
+    m.Store("1", "one");
+    m.Store("new", "key");
+    REQUIRE(m.Size() == 501);
+    m.Compact();
+    REQUIRE(m.DeltaSize() == 0);
+    // 墓碑合并后消失
+    REQUIRE(m.BaseMap()->Size() == 501);
+    REQUIRE(m.Size() == 501);
+    REQUIRE(m.Load("1") == "one");
+    REQUIRE(m.Load("3") == "v3");
+    REQUIRE(m.Load("new") == "key");
+    REQUIRE_FALSE(m.Contains("2"));
+
+    // 空delta时什么也不做
+    auto base = m.BaseMap();
+    m.Compact();
+    REQUIRE(m.BaseMap() == base);
+}
+
+TEST_CASE("OverlayMap under concurrent writers and compaction", "[OverlayMap]") {
+    constexpr int kBase = 20000;
+    constexpr int kWriters = 4;
+    constexpr int kPerWriter = 10000;
+    OverlayMap<int, int> m(Base(kBase));
+    std::atomic<bool> stop{false};
+    std::atomic<int> wrong{0};
+
+    // 基础数据里的键始终可见且值不变
+    std::thread reader([&]() {
+        int i = 0;
+        while (!stop.load()) {
+            int key = i++ % kBase;
+            int v;
+            if (!m.Load(key, &v) || v != key)
+                ++wrong;
+        }
+    });
+    std::vector<std::thread> writers;
+    for (int w = 0; w < kWriters; ++w) {
+        writers.emplace_back([&m, w]() {
+            for (int i = 0; i < kPerWriter; ++i) {
+                int key = kBase + w * kPerWriter + i;
+                m.Store(key, key);
+                if (i % 2 == 1)
+                    m.Delete(key - 1);
+            }
+        });
+    }
+    for (auto& t : writers)
+        t.join();
+    stop = true;
+    reader.join();
+    REQUIRE(wrong == 0);
+
+    m.Compact();
+    REQUIRE(m.DeltaSize() == 0);
+    REQUIRE(m.Size() == kBase + kWriters * kPerWriter / 2);
+    for (int w = 0; w < kWriters; ++w) {
+        for (int i = 0; i < kPerWriter; ++i) {
+            int key = kBase + w * kPerWriter + i;
+            REQUIRE(m.Contains(key) == (i % 2 == 1));
+        }
+    }
+}
@@ -0,0 +1,96 @@
+#define CATCH_CONFIG_MAIN
+#include <atomic>
+#include <cstdint>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/cached_map.hpp"
+#include "sync/map.hpp"
+#include "sync/parking_lot.hpp"
+
+using namespace juliet::sync;
+
+TEST_CASE("ParkingLot unpark wakes parked thread", "[ParkingLot]") {
+    int word = 0;
+    std::atomic_bool parked{false};
+    std::thread waiter([&]() {
+        parked = true;
+        REQUIRE(ParkingLot::Park(&word, []() { return true; }));
+    });
+    while (!parked)
+        std::this_thread::yield();
+
+    bool woke = false;
+    while (!woke) {
+        ParkingLot::UnparkOne(&word, [&woke](bool did, bool more) {
+            woke = did;
+            REQUIRE_FALSE(more);
+        });
+        std::this_thread::yield();
+    }
+    waiter.join();
+
+    REQUIRE_FALSE(ParkingLot::Park(&word, []() { return false; }));
+}
+
+TEST_CASE("BitLock keeps the owner's bits", "[ParkingLot]") {
+    using Bits = BitLock<uint32_t, 1u << 30, 1u << 31>;
+    std::atomic<uint32_t> word{0};
+    long counter = 0;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&]() {
+            for (int i = 0; i < 5000; ++i) {
+                Bits::Lock(word);
+                ++counter;
+                // 持锁期间修改低位，模拟把锁嵌在状态字里
+                word.fetch_add(1);
+                Bits::Unlock(word);
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+
+    REQUIRE(counter == 20000);
+    REQUIRE((word.load() & ~Bits::kMask) == 20000);
+    REQUIRE((word.load() & Bits::kMask) == 0);
+}
+
+TEST_CASE("compact map entries", "[ParkingLot][Map]") {
+    using StdEntry = map::Entry<std::string, std::mutex>;
+    using CompactEntry = map::Entry<std::string, ByteLock>;
+    using StdCached = cached::Node<std::string, std::string, std::shared_timed_mutex>;
+    using CompactCached = cached::Node<std::string, std::string, ByteLock>;
+
+    std::cout << "map::Entry bytes: std::mutex " << sizeof(StdEntry)
+              << ", ByteLock " << sizeof(CompactEntry) << std::endl;
+    std::cout << "cached::Node bytes: shared_timed_mutex " << sizeof(StdCached)
+              << ", ByteLock " << sizeof(CompactCached) << std::endl;
+    // 状态字节和锁一起塞进引用计数后面的空隙
+    REQUIRE(sizeof(CompactEntry) == sizeof(RefCounted) + sizeof(ValueRef<std::string>) + sizeof(EmbeddedValue<std::string>));
+    REQUIRE(sizeof(CompactCached) < sizeof(StdCached));
+
+    Map<int, int, CompactLockPolicy> m;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&m, t]() {
+            for (int i = 0; i < 2000; ++i) {
+                m.Store(i % 16, t);
+                int v;
+                m.Load(i % 16, &v);
+                if (i % 7 == 0)
+                    m.Delete(i % 16);
+            }
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    m.Store(1, 42);
+    REQUIRE(m.Load(1) == 42);
+}
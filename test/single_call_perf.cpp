@@ -0,0 +1,71 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+
+#include "sync/single_call.hpp"
+
+using namespace juliet::sync;
+
+namespace {
+
+constexpr int kThreads = 1000;
+constexpr int kKeys = 10;
+constexpr int kCallsPerThread = 10;
+
+std::atomic_long backend_calls{0};
+
+int Backend(int key) {
+    ++backend_calls;
+    std::this_thread::sleep_for(std::chrono::microseconds(200));
+    return key * 2;
+}
+
+template<typename Fetch>
+long Hammer(Fetch&& fetch) {
+    std::atomic_long sum{0};
+    std::vector<std::thread> threads;
+    threads.reserve(kThreads);
+    for (int t = 0; t < kThreads; ++t) {
+        threads.emplace_back([&, t]() {
+            long local = 0;
+            for (int i = 0; i < kCallsPerThread; ++i)
+                local += fetch((t + i) % kKeys);
+            sum += local;
+        });
+    }
+    for (auto& t : threads)
+        t.join();
+    return sum;
+}
+
+}
+
+TEST_CASE("sync.Group smoke", "[Group]") {
+    Group<int, int> group;
+    REQUIRE(group.Do(1, []() { return Backend(1); }) == 2);
+}
+
+// Run with: single_call_perf "[!benchmark]"
+TEST_CASE("sync.Group 1000 threads on 10 keys", "[Group][!benchmark]") {
+    Group<int, int> group;
+
+    backend_calls = 0;
+    BENCHMARK("direct backend calls") {
+        return Hammer([](int key) { return Backend(key); });
+    };
+    std::cout << "direct backend calls: " << backend_calls << std::endl;
+
+    backend_calls = 0;
+    BENCHMARK("Group::Do") {
+        return Hammer([&group](int key) {
+            return group.Do(key, [key]() { return Backend(key); });
+        });
+    };
+    std::cout << "Group::Do backend calls: " << backend_calls << std::endl;
+}
@@ -0,0 +1,61 @@
+#define CATCH_CONFIG_MAIN
+#include <atomic>
+#include <chrono>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+
+#include "sync/single_call.hpp"
+
+using namespace juliet::sync;
+
+TEST_CASE("SingleCall", "[SingleCall]") {
+    std::atomic_bool doing{false};
+    int calls = 0;
+    REQUIRE(SingleCall(doing, [&calls]() { ++calls; }));
+    REQUIRE_FALSE(doing);
+    REQUIRE(calls == 1);
+}
+
+TEST_CASE("sync.Group shares one in-flight call", "[Group]") {
+    Group<std::string, int> group;
+    std::atomic_int calls{0};
+    std::atomic_bool release{false};
+
+    std::vector<std::thread> threads;
+    std::vector<int> results(8, 0);
+    for (int i = 0; i < 8; ++i) {
+        threads.emplace_back([&, i]() {
+            results[i] = group.Do("key", [&]() {
+                ++calls;
+                while (!release)
+                    std::this_thread::yield();
+                return 42;
+            });
+        });
+    }
+    // 等所有线程都进入Do之后再放行leader
+    std::this_thread::sleep_for(std::chrono::milliseconds(50));
+    release = true;
+    for (auto& t : threads)
+        t.join();
+
+    for (int r : results)
+        REQUIRE(r == 42);
+    REQUIRE(calls >= 1);
+    REQUIRE(calls < 8);
+
+    // 调用结束后会重新执行
+    REQUIRE(group.Do("key", [&]() { return ++calls; }) == calls);
+}
+
+TEST_CASE("sync.Group propagates exceptions", "[Group]") {
+    Group<int, void> group;
+    REQUIRE_THROWS_AS(group.Do(1, []() { throw std::runtime_error("backend"); }), std::runtime_error);
+    int calls = 0;
+    group.Do(1, [&calls]() { ++calls; });
+    REQUIRE(calls == 1);
+}
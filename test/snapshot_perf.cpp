@@ -0,0 +1,70 @@
+#define CATCH_CONFIG_MAIN
+#define CATCH_CONFIG_ENABLE_BENCHMARKING
+#include <cstdio>
+#include <string>
+
+#include "catch2/catch.hpp"
+#include "sync/hash_table.hpp"
+#include "sync/map.hpp"
+
+namespace {
+
+constexpr int kEntries = 1000000;
+const char* kPath = "juliet_snapshot_perf";
+
+std::string Key(int i) {
+    return "user:" + std::to_string(i);
+}
+
+}
+
+TEST_CASE("snapshot perf smoke", "[Snapshot]") {
+    juliet::sync::Map<int, long> m;
+    m.Store(1, 1);
+    REQUIRE(m.SaveSnapshot(kPath));
+    juliet::sync::Map<int, long> loaded;
+    REQUIRE(loaded.LoadSnapshot(kPath));
+    REQUIRE(loaded.Load(1) == 1);
+    std::remove(kPath);
+}
+
+// Run with: snapshot_perf "[!benchmark]"
+TEST_CASE("warm start: replay Store vs LoadSnapshot", "[Snapshot][!benchmark]") {
+    {
+        juliet::sync::Map<int, long> source;
+        for (int i = 0; i < kEntries; ++i)
+            source.Store(i, i);
+        BENCHMARK("Map<int, long> SaveSnapshot, 1M") {
+            return source.SaveSnapshot(kPath);
+        };
+        BENCHMARK("Map<int, long> replay Store, 1M") {
+            juliet::sync::Map<int, long> m;
+            for (int i = 0; i < kEntries; ++i)
+                m.Store(i, i);
+            return m.Size();
+        };
+        BENCHMARK("Map<int, long> LoadSnapshot, 1M") {
+            juliet::sync::Map<int, long> m;
+            m.LoadSnapshot(kPath);
+            return m.Size();
+        };
+    }
+    {
+        juliet::sync::HashTable<std::string, std::string> source;
+        for (int i = 0; i < kEntries; ++i)
+            source.Put(Key(i), std::to_string(i));
+        source.SaveSnapshot(kPath);
+        BENCHMARK("HashTable<string, string> replay Put, 1M") {
+            juliet::sync::HashTable<std::string, std::string> t;
+            for (int i = 0; i < kEntries; ++i)
+                t.Put(Key(i), std::to_string(i));
+            return t.Size();
+        };
+        BENCHMARK("HashTable<string, string> LoadSnapshot, 1M") {
+            juliet::sync::HashTable<std::string, std::string> t;
+            t.LoadSnapshot(kPath);
+            return t.Size();
+        };
+    }
+    std::remove(kPath);
+}
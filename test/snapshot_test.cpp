@@ -0,0 +1,149 @@
+#define CATCH_CONFIG_MAIN
+#include <cstdio>
+#include <fstream>
+#include <string>
+#include <unordered_map>
+
+#include "catch2/catch.hpp"
+#include "sync/hash_table.hpp"
+#include "sync/map.hpp"
+#include "sync/snapshot.hpp"
+
+using namespace juliet::sync;
+
+namespace {
+
+struct Point {
+    std::string name;
+    int x = 0;
+};
+
+}
+
+// 非平凡类型需要自定义Codec
+template<>
+struct juliet::sync::Codec<Point> {
+    static constexpr size_t kFixedSize = 0;
+
+    static void Encode(const Point& p, std::string* out) {
+        Codec<std::string>::Encode(p.name, out);
+        Codec<int>::Encode(p.x, out);
+    }
+
+    static bool Decode(const char** p, const char* end, Point* point) {
+        return Codec<std::string>::Decode(p, end, &point->name) && Codec<int>::Decode(p, end, &point->x);
+    }
+};
+
+namespace {
+
+std::string TempPath(const char* name) {
+    return std::string("juliet_snapshot_") + name;
+}
+
+}
+
+TEST_CASE("Map snapshot round trip", "[Snapshot][Map]") {
+    auto path = TempPath("map_int");
+    Map<int, double> m;
+    for (int i = 0; i < 1000; ++i)
+        m.Store(i, i * 0.5);
+    m.Delete(7);
+    REQUIRE(m.SaveSnapshot(path));
+
+    Map<int, double> loaded;
+    loaded.Store(-1, 1);
+    REQUIRE(loaded.LoadSnapshot(path));
+    REQUIRE(loaded.Size() == 999);
+    double v;
+    REQUIRE_FALSE(loaded.Load(-1, &v));
+    REQUIRE_FALSE(loaded.Load(7, &v));
+    REQUIRE(loaded.Load(500, &v));
+    REQUIRE(v == 250);
+    // 载入后的表可以照常写
+    loaded.Store(2000, 1);
+    REQUIRE(loaded.Load(2000, &v));
+    REQUIRE(loaded.Size() == 1000);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Map snapshot of strings and user codecs", "[Snapshot][Map]") {
+    auto path = TempPath("map_point");
+    Map<std::string, Point> m;
+    m.Store("a", Point{"origin", 0});
+    m.Store("b", Point{std::string(1000, 'p'), 42});
+    REQUIRE(m.SaveSnapshot(path));
+
+    Map<std::string, Point> loaded;
+    REQUIRE(loaded.LoadSnapshot(path));
+    Point p;
+    REQUIRE(loaded.Load("b", &p));
+    REQUIRE(p.name.size() == 1000);
+    REQUIRE(p.x == 42);
+    REQUIRE(loaded.Size() == 2);
+    std::remove(path.c_str());
+}
+
+TEST_CASE("HashTable snapshot round trip", "[Snapshot][HashTable]") {
+    auto path = TempPath("table");
+    HashTable<std::string, std::string> t;
+    for (int i = 0; i < 100; ++i)
+        t.Put(std::to_string(i), std::string(i, 'x'));
+    REQUIRE(t.SaveSnapshot(path));
+
+    HashTable<std::string, std::string> loaded;
+    loaded.Put("stale", "1");
+    REQUIRE(loaded.LoadSnapshot(path));
+    REQUIRE(loaded.Size() == 100);
+    std::string v;
+    REQUIRE_FALSE(loaded.Get("stale", v));
+    REQUIRE(loaded.Get("99", v));
+    REQUIRE(v == std::string(99, 'x'));
+    std::remove(path.c_str());
+}
+
+TEST_CASE("Snapshot loaders reject bad files", "[Snapshot]") {
+    auto path = TempPath("bad");
+    Map<int, int> m;
+    REQUIRE_FALSE(m.LoadSnapshot(path + ".missing"));
+
+    for (int i = 0; i < 100; ++i)
+        m.Store(i, i);
+    REQUIRE(m.SaveSnapshot(path));
+
+    // 类型不符
+    HashTable<int, std::string> other;
+    REQUIRE_FALSE(other.LoadSnapshot(path));
+
+    // 截断
+    std::string bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream out(path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size() - 4));
+    }
+    Map<int, int> loaded;
+    loaded.Store(1, 1);
+    REQUIRE_FALSE(loaded.LoadSnapshot(path));
+    REQUIRE(loaded.Load(1) == 1);
+
+    HashTable<std::string, std::string> strings;
+    strings.Put("k", "v");
+    auto string_path = TempPath("bad_strings");
+    REQUIRE(strings.SaveSnapshot(string_path));
+    {
+        std::ifstream in(string_path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    {
+        std::ofstream out(string_path, std::ios::binary | std::ios::trunc);
+        out.write(bytes.data(), static_cast<std::streamsize>(bytes.size() - 1));
+    }
+    REQUIRE_FALSE(strings.LoadSnapshot(string_path));
+    REQUIRE(strings.Get("k") == "v");
+    std::remove(path.c_str());
+    std::remove(string_path.c_str());
+}
@@ -0,0 +1,107 @@
+#define CATCH_CONFIG_MAIN
+#include <chrono>
+#include <list>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/cached_map.hpp"
+#include "sync/hash_table.hpp"
+#include "sync/list.hpp"
+#include "sync/map.hpp"
+#include "sync/stats_policy.hpp"
+
+using namespace juliet::sync;
+
+TEST_CASE("StripedStats sums per-thread cells", "[Stats]") {
+    StripedStats stats;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&stats]() {
+            for (int i = 0; i < 1000; ++i) {
+                stats.Count(kFastPath);
+                stats.Record(kLockWait, std::chrono::nanoseconds(i));
+            }
+        });
+    }
+    for (auto& th : threads)
+        th.join();
+
+    auto snapshot = stats.Stats();
+    REQUIRE(snapshot[kFastPath] == 4000);
+    REQUIRE(snapshot[kSlowPath] == 0);
+    const auto& wait = snapshot[kLockWait];
+    REQUIRE(wait.count == 4000);
+    REQUIRE(wait.buckets[0] == 4);
+    // [512, 1024)ns落在第10个桶
+    REQUIRE(wait.buckets[10] == 4 * 488);
+    REQUIRE(wait.Mean() == std::chrono::nanoseconds(499));
+    REQUIRE(wait.Percentile(0.5) == std::chrono::nanoseconds(512));
+    REQUIRE(wait.Percentile(1) == std::chrono::nanoseconds(1024));
+}
+
+TEST_CASE("NoStats containers report nothing", "[Stats]") {
+    Map<int, int> m;
+    m.Store(1, 1);
+    REQUIRE(m.Load(1) == 1);
+    REQUIRE(m.Stats()[kSlowPath] == 0);
+    REQUIRE(m.Stats()[kLockHold].count == 0);
+}
+
+TEST_CASE("Map stats split fast and slow paths", "[Stats][Map]") {
+    Map<int, int, StdLockPolicy, GoPromotion, StripedStats> m;
+    for (int i = 0; i < 10; ++i)
+        m.Store(i, i);
+    auto stats = m.Stats();
+    REQUIRE(stats[kSlowPath] == 10);
+    REQUIRE(stats[kRebuilds] == 1);
+    REQUIRE(stats[kRebuildTime].count == 1);
+    REQUIRE(stats[kLockHold].count == 10);
+
+    // 10次miss后提升，之后的读都走快路径
+    int v;
+    for (int i = 0; i < 20; ++i)
+        REQUIRE(m.Load(i % 10, &v));
+    stats = m.Stats();
+    REQUIRE(stats[kPromotions] == 1);
+    REQUIRE(stats[kSlowPath] == 20);
+    REQUIRE(stats[kFastPath] == 10);
+    REQUIRE(stats[kLockWait].count == stats[kLockHold].count);
+}
+
+TEST_CASE("HashTable, List and CachedMap time their locks", "[Stats]") {
+    HashTable<int, int, StdLockPolicy, StripedStats> t;
+    std::vector<std::thread> writers;
+    for (int w = 0; w < 4; ++w) {
+        writers.emplace_back([&t, w]() {
+            for (int i = 0; i < 100; ++i)
+                t.Put(w * 100 + i, i);
+        });
+    }
+    for (auto& th : writers)
+        th.join();
+    int v;
+    REQUIRE(t.Get(1, v));
+    REQUIRE(t.Stats()[kLockWait].count == 400);
+    REQUIRE(t.Stats()[kSharedLockHold].count == 1);
+
+    List<int, StdLockPolicy, StripedStats> l{std::list<int>{1, 2}};
+    l.Add(3);
+    l.ForEach([](const int&) { std::this_thread::sleep_for(std::chrono::microseconds(100)); });
+    auto list_stats = l.Stats();
+    REQUIRE(list_stats[kLockHold].count == 2);
+    REQUIRE(list_stats[kSharedLockHold].count == 1);
+    REQUIRE(list_stats[kSharedLockHold].total >= std::chrono::microseconds(300));
+
+    CachedMap<int, std::string, StdLockPolicy, StripedStats> c;
+    c.Put(1, "a");
+    std::string s;
+    REQUIRE(c.Get(1, s));
+    REQUIRE(c.Get(1, s));
+    REQUIRE_FALSE(c.Get(2, s));
+    auto cached_stats = c.Stats();
+    REQUIRE(cached_stats[kFastPath] == 1);
+    REQUIRE(cached_stats[kSlowPath] == 2);
+    REQUIRE(cached_stats[kSharedLockWait].count == 2);
+}
@@ -0,0 +1,106 @@
+#define CATCH_CONFIG_MAIN
+#include <list>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "catch2/catch.hpp"
+#include "sync/cached_map.hpp"
+#include "sync/hash_table.hpp"
+#include "sync/list.hpp"
+#include "sync/map.hpp"
+#include "sync/striped_counter.hpp"
+
+using namespace juliet::sync;
+
+TEST_CASE("StripedCounter sums concurrent adds", "[StripedCounter]") {
+    StripedCounter counter;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; ++t) {
+        threads.emplace_back([&counter]() {
+            for (int i = 0; i < 10000; ++i) {
+                counter.Increment();
+                if (i % 4 == 0)
+                    counter.Decrement();
+            }
+        });
+    }
+    for (auto& th : threads)
+        th.join();
+    REQUIRE(counter.Sum() == 8 * 7500);
+
+    counter.Reset();
+    REQUIRE(counter.Sum() == 0);
+    counter.Add(-3);
+    REQUIRE(counter.Sum() == -3);
+}
+
+TEST_CASE("Map Size tracks live values", "[StripedCounter][Map]") {
+    Map<int, std::string> m;
+    REQUIRE(m.Size() == 0);
+    m.Store(1, "a");
+    m.Store(1, "b");
+    m.Store(2, "c");
+    REQUIRE(m.Size() == 2);
+    REQUIRE_FALSE(m.TryEmplace(1, "x").second);
+    REQUIRE(m.TryEmplace(3, "x").second);
+    m.LoadOrCompute(4, []() { return "y"; });
+    REQUIRE(m.Size() == 4);
+    m.Delete(1);
+    m.Delete(1);
+    REQUIRE(m.Size() == 3);
+    // 删除后再写回同一个key（entry从kNull/kExpunged回到kValue）
+    m.Range([](const int&, const std::string&) { return true; });
+    m.Store(1, "d");
+    REQUIRE(m.Size() == 4);
+    m.Reset();
+    REQUIRE(m.Size() == 0);
+
+    Map<int, int> inline_values;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 4; ++t) {
+        threads.emplace_back([&inline_values, t]() {
+            for (int i = 0; i < 1000; ++i) {
+                inline_values.Store(t * 1000 + i, i);
+                if (i % 2 == 0)
+                    inline_values.Delete(t * 1000 + i);
+            }
+        });
+    }
+    for (auto& th : threads)
+        th.join();
+    REQUIRE(inline_values.Size() == 2000);
+}
+
+TEST_CASE("HashTable, CachedMap and List Size", "[StripedCounter]") {
+    HashTable<int, int> t;
+    t.Put(1, 1);
+    t.Put(1, 2);
+    t.TryPut(2, 2);
+    t.Emplace(3, 3);
+    t.TryEmplace(3, 4);
+    REQUIRE(t.Size() == 3);
+    t.Remove(1);
+    t.Remove(1);
+    REQUIRE(t.Size() == 2);
+    t.Clear();
+    REQUIRE(t.Size() == 0);
+
+    CachedMap<int, int> c;
+    c.Put(1, 1);
+    c.Put(1, 2);
+    c.TryPut(2, 2);
+    int v;
+    c.Get(3, v);
+    REQUIRE(c.Size() == 2);
+    c.Remove(1);
+    REQUIRE(c.Size() == 1);
+    c.Clear();
+    REQUIRE(c.Size() == 0);
+
+    List<int> l{std::list<int>{1, 2, 3}};
+    l.Add(4);
+    REQUIRE(l.Size() == 4);
+    l.ForEachRemove([](const int& x) { return x % 2 == 0; });
+    REQUIRE(l.Size() == 2);
+}